@@ -0,0 +1,137 @@
+#include "base/prerequisites.h"
+#include "wasmtime_async_call.h"
+#include "core/logger/logger.h"
+
+namespace Arieo
+{
+    namespace
+    {
+        thread_local WasmtimeAsyncCall* t_current_async_call = nullptr;
+    }
+
+    WasmtimeGuestFiber::WasmtimeGuestFiber()
+        : m_thread(&WasmtimeGuestFiber::fiberMain, this)
+    {
+    }
+
+    WasmtimeGuestFiber::~WasmtimeGuestFiber()
+    {
+        m_is_stopping = true;
+        m_resume_signal.release();
+        m_thread.join();
+    }
+
+    void WasmtimeGuestFiber::start(std::function<void()>&& entry)
+    {
+        m_entry = std::move(entry);
+        resume();
+    }
+
+    void WasmtimeGuestFiber::resume()
+    {
+        m_resume_signal.release();
+        m_yield_signal.acquire();
+    }
+
+    void WasmtimeGuestFiber::suspend()
+    {
+        m_yield_signal.release();
+        m_resume_signal.acquire();
+    }
+
+    void WasmtimeGuestFiber::fiberMain()
+    {
+        while(true)
+        {
+            m_resume_signal.acquire();
+            if(m_is_stopping)
+            {
+                return;
+            }
+            m_entry();
+            m_entry = nullptr;
+            m_yield_signal.release();
+        }
+    }
+
+    bool WasmtimeAsyncCall::awaitOnTick(std::function<bool()>&& is_ready)
+    {
+        WasmtimeAsyncCall* current_call = t_current_async_call;
+        if(current_call == nullptr || current_call->m_is_cancelled)
+        {
+            return false;
+        }
+
+        current_call->m_awaited_condition = std::move(is_ready);
+        current_call->m_state = State::Suspended;
+        current_call->m_fiber->suspend();
+        current_call->m_state = State::Running;
+        return current_call->m_is_cancelled == false;
+    }
+
+    WasmtimeAsyncCall* WasmtimeAsyncCall::getCurrent()
+    {
+        return t_current_async_call;
+    }
+
+    void WasmtimeAsyncCall::start(WasmtimeGuestFiber& fiber)
+    {
+        m_fiber = &fiber;
+        m_state = State::Running;
+        m_fiber->start([this]()
+        {
+            t_current_async_call = this;
+            wasmtime::Result<WasmtimeCallResult> call_result = m_instance.castToInstance<WasmtimeInstance>()->callFunctionWithResult(m_function);
+            if(call_result)
+            {
+                m_result = call_result.unwrap();
+            }
+            else
+            {
+                m_error_message = call_result.err().message();
+                Core::Logger::error("Error in async script call: {}", m_error_message);
+            }
+            t_current_async_call = nullptr;
+            m_state = State::Completed;
+        });
+    }
+
+    bool WasmtimeAsyncCall::tryResume()
+    {
+        if(m_state != State::Suspended || m_awaited_condition() == false)
+        {
+            return false;
+        }
+        m_awaited_condition = nullptr;
+        m_fiber->resume();
+        return true;
+    }
+
+    void WasmtimeAsyncCall::cancel()
+    {
+        if(isDone())
+        {
+            return;
+        }
+        m_is_cancelled = true;
+        if(m_state == State::Pending)
+        {
+            m_state = State::Completed;
+            return;
+        }
+        // Every later awaitOnTick fails right away, so the guest cannot park again on its way out.
+        // The store is destroyed right after this returns, so keep handing control back until the
+        // fiber has left the guest for good, it must never hold frames in a freed store.
+        m_awaited_condition = nullptr;
+        m_fiber->resume();
+        while(isDone() == false)
+        {
+            Core::Logger::error("Cancelled async script call suspended again on its way out, resuming it until it unwinds");
+            m_fiber->resume();
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "interface/script/script.h"
+#include "../instance/wasmtime_instance.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Arieo
+{
+    class WasmtimeAsyncCall;
+    class WasmtimeContext;
+
+    /**
+     * @brief Dedicated stack a guest call runs on so it can be suspended mid-call
+     *
+     * Wasmtime's own async support relies on Rust futures that the C API does not expose for
+     * component functions. Each fiber is therefore a parked thread with strict hand-off: the tick
+     * thread blocks while the fiber runs and vice versa, so the store is never entered concurrently
+     * and the guest observes plain coroutine semantics.
+     */
+    class WasmtimeGuestFiber final
+    {
+    public:
+        WasmtimeGuestFiber();
+        ~WasmtimeGuestFiber();
+
+        // Tick thread: starts entry on the fiber and blocks until it finishes or suspends
+        void start(std::function<void()>&& entry);
+        // Tick thread: continues a suspended fiber and blocks until it finishes or suspends again
+        void resume();
+        // Fiber thread: hands control back to the tick thread until resume() is called
+        void suspend();
+    private:
+        void fiberMain();
+
+        std::function<void()> m_entry;
+        std::binary_semaphore m_resume_signal{0};
+        std::binary_semaphore m_yield_signal{0};
+        bool m_is_stopping = false;
+        std::thread m_thread;
+    };
+
+    /**
+     * @brief Coroutine-style handle of a guest call that may suspend inside host imports
+     *
+     * Host imports running inside an async call can call awaitOnTick() to park the guest until a
+     * condition holds; WasmtimeEngine::pumpAsyncCalls re-checks the condition every tick and
+     * resumes the guest on the tick thread once it is ready.
+     *
+     * A parked guest still has live frames in its store, so the context stays busy until the call
+     * completes: other calls into it are rejected, later async calls on it wait their turn, and
+     * destroying the instance or context cancels the call first.
+     */
+    class WasmtimeAsyncCall final
+    {
+    public:
+        enum class State
+        {
+            // Waiting for a free fiber
+            Pending,
+            Running,
+            Suspended,
+            Completed
+        };
+
+        WasmtimeAsyncCall(Base::Interop::RawRef<Interface::Script::IInstance> instance, WasmtimeContext* context, void* function)
+            : m_instance(instance), m_context(context), m_function(function)
+        {
+        }
+
+        State getState() const { return m_state; }
+        bool isDone() const { return m_state == State::Completed; }
+        // Cancelled before completing, the guest was unwound by a trap or never started
+        bool isCancelled() const { return m_is_cancelled; }
+
+        // Outcome of the guest call, only meaningful once isDone(). A call cancelled before it started has
+        // neither a result nor an error.
+        bool isFailed() const { return m_error_message.empty() == false; }
+        const std::string& getErrorMessage() const { return m_error_message; }
+        // Empty for exports without a result and for failed calls, owned by the handle
+        const WasmtimeCallResult& getResult() const { return m_result; }
+
+        // Host import side: suspends the calling guest until is_ready returns true on the tick thread.
+        // Returns false when not called from inside an async call, the caller must then block or fail.
+        // Also returns false once the call is cancelled, the caller must then fail so the guest unwinds.
+        static bool awaitOnTick(std::function<bool()>&& is_ready);
+
+        // The async call the current thread is executing, nullptr outside of guest fibers
+        static WasmtimeAsyncCall* getCurrent();
+    private:
+        friend class WasmtimeEngine;
+
+        void start(WasmtimeGuestFiber& fiber);
+        // Resumes the guest if it is suspended and its awaited condition is ready
+        bool tryResume();
+        // Tick thread: a suspended guest is resumed with awaitOnTick returning false and runs until it unwinds,
+        // a pending call completes without running. Returns only once the call is done.
+        void cancel();
+
+        Base::Interop::RawRef<Interface::Script::IInstance> m_instance;
+        WasmtimeContext* m_context = nullptr;
+        void* m_function;
+        State m_state = State::Pending;
+        WasmtimeGuestFiber* m_fiber = nullptr;
+        std::function<bool()> m_awaited_condition;
+        // Destroyed by its owner before completing, deleted by the engine once the guest returns
+        bool m_is_abandoned = false;
+        bool m_is_cancelled = false;
+        WasmtimeCallResult m_result;
+        std::string m_error_message;
+    };
+}
+
+
+
+
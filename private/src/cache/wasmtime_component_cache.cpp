@@ -0,0 +1,264 @@
+#include "base/prerequisites.h"
+#include "wasmtime_component_cache.h"
+#include "core/logger/logger.h"
+
+#include <fstream>
+#include <format>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+namespace Arieo
+{
+    namespace
+    {
+        constexpr const char* CACHE_ENTRY_EXTENSION = ".cwasm";
+        constexpr const char* CACHE_TEMP_EXTENSION = ".tmp";
+
+        std::string getVersionDirName()
+        {
+            return std::format("v{}-wasmtime-{}", WasmtimeComponentCache::CACHE_FORMAT_VERSION, WASMTIME_VERSION);
+        }
+    }
+
+    void WasmtimeComponentCache::initialize(const std::filesystem::path& cache_dir, std::uint64_t max_size, std::uint64_t config_fingerprint)
+    {
+        std::error_code ec;
+        m_cache_dir = cache_dir / getVersionDirName();
+        m_max_size = max_size;
+        m_config_fingerprint = config_fingerprint;
+        m_temp_token = (std::uint64_t(std::random_device()()) << 32) | std::random_device()();
+
+        std::filesystem::create_directories(m_cache_dir, ec);
+        if(ec)
+        {
+            Core::Logger::error("Failed to create component cache directory {}: {}", m_cache_dir.string(), ec.message());
+            m_is_enabled = false;
+            return;
+        }
+
+        removeStaleVersions(cache_dir);
+
+        // Account what is already on disk, dropping half written entries from a previous crash
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_total_size = 0;
+        for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_cache_dir, ec))
+        {
+            if(entry.is_regular_file() == false)
+            {
+                continue;
+            }
+            if(entry.path().extension() == CACHE_TEMP_EXTENSION)
+            {
+                std::filesystem::remove(entry.path(), ec);
+                continue;
+            }
+            m_total_size += entry.file_size(ec);
+        }
+        evictLocked();
+
+        m_is_enabled = true;
+        Core::Logger::info("Component cache enabled at {} ({} / {} bytes used)", m_cache_dir.string(), m_total_size, m_max_size);
+    }
+
+    void WasmtimeComponentCache::shutdown()
+    {
+        if(m_is_enabled)
+        {
+            Statistics statistics = getStatistics();
+            Core::Logger::info("Component cache shut down: {} hits, {} misses, {} stores, {} evictions, {} invalid entries",
+                statistics.hit_count,
+                statistics.miss_count,
+                statistics.store_count,
+                statistics.eviction_count,
+                statistics.invalid_count);
+        }
+        m_is_enabled = false;
+    }
+
+    std::optional<wasmtime::component::Component> WasmtimeComponentCache::load(wasmtime::Engine& engine, const WasmtimeSha256::Digest& content_digest, size_t content_size)
+    {
+        if(m_is_enabled == false)
+        {
+            return std::nullopt;
+        }
+
+        std::filesystem::path entry_path = getEntryPath(content_digest, content_size);
+        std::error_code ec;
+        if(std::filesystem::exists(entry_path, ec) == false)
+        {
+            m_miss_count++;
+            return std::nullopt;
+        }
+
+        wasmtime::Result<wasmtime::component::Component> deserialize_result = wasmtime::component::Component::deserialize_file(
+            engine,
+            entry_path.string()
+        );
+
+        if(!deserialize_result)
+        {
+            // Incompatible or corrupted artifact, drop it so the next store replaces it
+            Core::Logger::error("Invalid component cache entry {}: {}", entry_path.string(), deserialize_result.err().message());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::uint64_t entry_size = std::filesystem::file_size(entry_path, ec);
+            if(std::filesystem::remove(entry_path, ec))
+            {
+                m_total_size -= std::min(m_total_size, entry_size);
+            }
+            m_invalid_count++;
+            m_miss_count++;
+            return std::nullopt;
+        }
+
+        // Touch the entry so eviction is least recently used rather than least recently stored
+        std::filesystem::last_write_time(entry_path, std::filesystem::file_time_type::clock::now(), ec);
+        m_hit_count++;
+        return deserialize_result.unwrap();
+    }
+
+    void WasmtimeComponentCache::store(const wasmtime::component::Component& component, const WasmtimeSha256::Digest& content_digest, size_t content_size)
+    {
+        if(m_is_enabled == false)
+        {
+            return;
+        }
+
+        wasmtime::Result<std::vector<uint8_t>> serialize_result = component.serialize();
+        if(!serialize_result)
+        {
+            Core::Logger::error("Failed to serialize component for cache: {}", serialize_result.err().message());
+            return;
+        }
+        std::vector<uint8_t> serialized = serialize_result.unwrap();
+
+        if(serialized.size() > m_max_size)
+        {
+            Core::Logger::trace("Serialized component ({} bytes) exceeds cache size limit, not cached", serialized.size());
+            return;
+        }
+
+        std::filesystem::path entry_path = getEntryPath(content_digest, content_size);
+        std::filesystem::path temp_path = entry_path;
+        temp_path += std::format(".{:016x}-{}{}", m_temp_token, m_temp_counter++, CACHE_TEMP_EXTENSION);
+
+        // Write to a temporary file first so a concurrent reader never maps a partial artifact, and rename
+        // it into place. Concurrent writers of the same entry each rename a complete file, the last one wins.
+        {
+            std::ofstream temp_file(temp_path, std::ios::binary | std::ios::trunc);
+            if(temp_file.is_open() == false)
+            {
+                Core::Logger::error("Failed to open component cache entry for writing: {}", temp_path.string());
+                return;
+            }
+            temp_file.write(reinterpret_cast<const char*>(serialized.data()), static_cast<std::streamsize>(serialized.size()));
+            if(temp_file.good() == false)
+            {
+                Core::Logger::error("Failed to write component cache entry: {}", temp_path.string());
+                temp_file.close();
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::error_code ec;
+        std::uint64_t replaced_size = std::filesystem::exists(entry_path, ec) ? std::filesystem::file_size(entry_path, ec) : 0;
+        std::filesystem::rename(temp_path, entry_path, ec);
+        if(ec)
+        {
+            Core::Logger::error("Failed to commit component cache entry {}: {}", entry_path.string(), ec.message());
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+
+        m_total_size -= std::min(m_total_size, replaced_size);
+        m_total_size += serialized.size();
+        m_store_count++;
+        evictLocked();
+    }
+
+    WasmtimeComponentCache::Statistics WasmtimeComponentCache::getStatistics() const
+    {
+        Statistics statistics;
+        statistics.hit_count = m_hit_count;
+        statistics.miss_count = m_miss_count;
+        statistics.store_count = m_store_count;
+        statistics.eviction_count = m_eviction_count;
+        statistics.invalid_count = m_invalid_count;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            statistics.total_size = m_total_size;
+        }
+        return statistics;
+    }
+
+    std::filesystem::path WasmtimeComponentCache::getEntryPath(const WasmtimeSha256::Digest& content_digest, size_t content_size) const
+    {
+        return m_cache_dir / std::format("{}-{:016x}-{}{}", WasmtimeSha256::toHexString(content_digest), m_config_fingerprint, content_size, CACHE_ENTRY_EXTENSION);
+    }
+
+    void WasmtimeComponentCache::removeStaleVersions(const std::filesystem::path& cache_root)
+    {
+        std::error_code ec;
+        std::string current_version = getVersionDirName();
+        for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(cache_root, ec))
+        {
+            std::string dir_name = entry.path().filename().string();
+            if(entry.is_directory() && dir_name.starts_with("v") && dir_name.find("-wasmtime-") != std::string::npos && dir_name != current_version)
+            {
+                Core::Logger::info("Removing stale component cache version: {}", dir_name);
+                std::filesystem::remove_all(entry.path(), ec);
+            }
+        }
+    }
+
+    void WasmtimeComponentCache::evictLocked()
+    {
+        if(m_total_size <= m_max_size)
+        {
+            return;
+        }
+
+        struct CacheEntry
+        {
+            std::filesystem::path path;
+            std::filesystem::file_time_type last_used;
+            std::uint64_t size;
+        };
+
+        std::error_code ec;
+        std::vector<CacheEntry> entries;
+        for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_cache_dir, ec))
+        {
+            if(entry.is_regular_file() && entry.path().extension() == CACHE_ENTRY_EXTENSION)
+            {
+                entries.push_back({entry.path(), entry.last_write_time(ec), entry.file_size(ec)});
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const CacheEntry& lhs, const CacheEntry& rhs)
+        {
+            return lhs.last_used < rhs.last_used;
+        });
+
+        for(const CacheEntry& entry : entries)
+        {
+            if(m_total_size <= m_max_size)
+            {
+                break;
+            }
+            if(std::filesystem::remove(entry.path, ec))
+            {
+                m_total_size -= std::min(m_total_size, entry.size);
+                m_eviction_count++;
+                Core::Logger::trace("Evicted component cache entry {}", entry.path.string());
+            }
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "../utility/wasmtime_sha256.h"
+#include <wasmtime.hh>
+#include <wasmtime/component.hh>
+#include <filesystem>
+#include <optional>
+#include <atomic>
+#include <mutex>
+
+namespace Arieo
+{
+    /**
+     * @brief On-disk cache of serialized components keyed by content digest and engine config fingerprint
+     *
+     * Entries hold native code that is run once deserialized, so they are keyed by the SHA-256 of
+     * the source binary rather than a fast hash a crafted or unlucky binary could collide with.
+     * Entries live in a versioned sub directory so that a wasmtime upgrade or a cache
+     * format change never picks up stale artifacts. Entries are loaded through
+     * Component::deserialize_file, which maps the artifact instead of reading it into a heap buffer.
+     */
+    class WasmtimeComponentCache final
+    {
+    public:
+        // Bump when the layout of the cache directory or entry naming changes
+        static constexpr std::uint32_t CACHE_FORMAT_VERSION = 2;
+
+        struct Statistics
+        {
+            std::uint64_t hit_count = 0;
+            std::uint64_t miss_count = 0;
+            std::uint64_t store_count = 0;
+            std::uint64_t eviction_count = 0;
+            std::uint64_t invalid_count = 0;
+            std::uint64_t total_size = 0;
+        };
+
+        void initialize(const std::filesystem::path& cache_dir, std::uint64_t max_size, std::uint64_t config_fingerprint);
+        void shutdown();
+
+        bool isEnabled() const { return m_is_enabled; }
+
+        std::optional<wasmtime::component::Component> load(wasmtime::Engine& engine, const WasmtimeSha256::Digest& content_digest, size_t content_size);
+        // Safe to call from several threads and processes for the same entry, each writer stages its own temporary file
+        void store(const wasmtime::component::Component& component, const WasmtimeSha256::Digest& content_digest, size_t content_size);
+
+        Statistics getStatistics() const;
+    private:
+        std::filesystem::path getEntryPath(const WasmtimeSha256::Digest& content_digest, size_t content_size) const;
+        void removeStaleVersions(const std::filesystem::path& cache_root);
+        void evictLocked();
+
+        bool m_is_enabled = false;
+        std::filesystem::path m_cache_dir;
+        std::uint64_t m_max_size = 0;
+        std::uint64_t m_config_fingerprint = 0;
+        // Makes temporary file names unique across processes sharing the cache directory, the counter within one
+        std::uint64_t m_temp_token = 0;
+        std::atomic<std::uint64_t> m_temp_counter = 0;
+
+        mutable std::mutex m_mutex;
+        std::uint64_t m_total_size = 0;
+
+        std::atomic<std::uint64_t> m_hit_count = 0;
+        std::atomic<std::uint64_t> m_miss_count = 0;
+        std::atomic<std::uint64_t> m_store_count = 0;
+        std::atomic<std::uint64_t> m_eviction_count = 0;
+        std::atomic<std::uint64_t> m_invalid_count = 0;
+    };
+}
+
+
+
+
@@ -2,10 +2,302 @@
 #include "wasmtime_context.h"
 #include "../instance/wasmtime_instance.h"
 #include "../module/wasmtime_module.h"
+#include "../async/wasmtime_async_call.h"
 #include "core/logger/logger.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace Arieo
 {
+    namespace
+    {
+        wasmtime_error_t* onStoreEpochDeadline(wasmtime_context_t* context, void* data, uint64_t* epoch_deadline_delta, wasmtime_update_deadline_kind_t* update_kind)
+        {
+            WasmtimeContext* wasmtime_context = static_cast<WasmtimeContext*>(data);
+            std::uint64_t deadline_delta = 0;
+            wasmtime_error_t* error = wasmtime_context->onEpochDeadline(deadline_delta);
+            *epoch_deadline_delta = deadline_delta;
+            *update_kind = WASMTIME_UPDATE_DEADLINE_CONTINUE;
+            return error;
+        }
+    }
+
+    WasmtimeContext::WasmtimeContext(wasmtime::Engine& engine, bool is_epoch_interruption, const WasmtimeContextLimits& limits,
+        WasmtimeGuestProfiler* guest_profiler, WasmtimeGuestLogStream* log_stream, std::shared_ptr<WasmtimeArchiveFilesystem> archive_filesystem)
+        : m_store(engine), m_guest_profiler(guest_profiler), m_log_stream(log_stream), m_archive_filesystem(std::move(archive_filesystem)),
+          m_fuel_config(limits.fuel_metering)
+    {
+        // Configure WASI and store it within our `wasmtime_store_t`
+        wasmtime::WasiConfig wasi;
+        wasi.inherit_argv();
+        wasi.inherit_env();
+        wasi.inherit_stdin();
+        // Captured stdio is written to files the log pipeline forwards. A guest printing no longer waits on the
+        // host console but still on the file write, see WasmtimeGuestLogConfig::is_capturing_stdio
+        bool is_stdio_captured = m_log_stream != nullptr && m_log_stream->getStdoutPath().empty() == false
+            && wasi.stdout_file(m_log_stream->getStdoutPath().string())
+            && wasi.stderr_file(m_log_stream->getStderrPath().string());
+        if(is_stdio_captured == false)
+        {
+            if(m_log_stream != nullptr && m_log_stream->getStdoutPath().empty() == false)
+            {
+                Core::Logger::error("Failed to capture guest stdio into {}, inheriting the host's", m_log_stream->getStdoutPath().parent_path().string());
+            }
+            wasi.inherit_stdout();
+            wasi.inherit_stderr();
+        }
+        if(m_archive_filesystem != nullptr)
+        {
+            m_archive_filesystem->configureWasi(wasi);
+        }
+        m_store.context().set_wasi(std::move(wasi)).unwrap();
+
+        // Host functions only receive the store context, this lets them reach the owning WasmtimeContext
+        m_store.context().set_data(this);
+
+        // Negative values keep wasmtime's defaults, which are unlimited for memory and tables
+        auto toLimit = [](std::uint64_t value) -> int64_t { return value == 0 ? -1 : static_cast<int64_t>(value); };
+        m_store.limiter(toLimit(limits.max_memory_bytes), toLimit(limits.max_table_elements), toLimit(limits.max_instances), -1, -1);
+        m_memory_account.setLimit(limits.max_memory_bytes);
+
+        // Metered stores only run capped inside metered calls, instantiation and state handoff are never stopped
+        std::uint64_t initial_fuel = m_fuel_config.is_enabled ? UNBOUNDED_FUEL : limits.fuel;
+        if(initial_fuel != 0)
+        {
+            wasmtime::Result<std::monostate> fuel_result = m_store.context().set_fuel(initial_fuel);
+            if(!fuel_result)
+            {
+                Core::Logger::error("Failed to set context fuel, is consume_fuel enabled on the engine: {}", fuel_result.err().message());
+            }
+        }
+
+        if(is_epoch_interruption)
+        {
+            // A fresh store has a deadline of zero, which would interrupt the first guest instruction
+            clearEpochBudget();
+            wasmtime_store_epoch_deadline_callback(m_store.capi(), &onStoreEpochDeadline, this, nullptr);
+        }
+    }
+
+    WasmtimeContext::~WasmtimeContext()
+    {
+        for(const WasmtimeArchiveFilesystem::ResidentFile* resident_file : m_archive_files)
+        {
+            m_archive_filesystem->close(resident_file);
+        }
+        m_archive_files.clear();
+
+        if(m_guest_profiler != nullptr)
+        {
+            Base::deleteT(m_guest_profiler);
+            m_guest_profiler = nullptr;
+        }
+    }
+
+    void WasmtimeContext::setScriptName(std::string_view script_name)
+    {
+        if(m_log_stream != nullptr)
+        {
+            m_log_stream->setScriptName(script_name);
+        }
+    }
+
+    std::uint32_t WasmtimeContext::openArchiveFile(std::string_view guest_path)
+    {
+        if(m_archive_filesystem == nullptr || m_archive_filesystem->getConfig().mode != WasmtimeArchiveFilesystem::Mode::Archive)
+        {
+            return 0;
+        }
+        const WasmtimeArchiveFilesystem::ResidentFile* resident_file = m_archive_filesystem->open(guest_path);
+        if(resident_file == nullptr)
+        {
+            return 0;
+        }
+
+        auto free_iter = std::find(m_archive_files.begin(), m_archive_files.end(), nullptr);
+        if(free_iter != m_archive_files.end())
+        {
+            *free_iter = resident_file;
+            return static_cast<std::uint32_t>(free_iter - m_archive_files.begin()) + 1;
+        }
+        m_archive_files.push_back(resident_file);
+        return static_cast<std::uint32_t>(m_archive_files.size());
+    }
+
+    void WasmtimeContext::closeArchiveFile(std::uint32_t file_handle)
+    {
+        if(file_handle == 0 || file_handle > m_archive_files.size() || m_archive_files[file_handle - 1] == nullptr)
+        {
+            return;
+        }
+        m_archive_filesystem->close(m_archive_files[file_handle - 1]);
+        m_archive_files[file_handle - 1] = nullptr;
+    }
+
+    std::span<const std::byte> WasmtimeContext::getArchiveFileBytes(std::uint32_t file_handle) const
+    {
+        if(file_handle == 0 || file_handle > m_archive_files.size() || m_archive_files[file_handle - 1] == nullptr)
+        {
+            return std::span<const std::byte>();
+        }
+        return m_archive_files[file_handle - 1]->bytes;
+    }
+
+    void WasmtimeContext::onDeadlineMissed()
+    {
+        m_deadline_miss_count++;
+        Core::Logger::error("Script deadline missed ({} misses in this context), trapping guest", m_deadline_miss_count);
+    }
+
+    bool WasmtimeContext::isEnterable() const
+    {
+        return m_active_async_call == nullptr || m_active_async_call == WasmtimeAsyncCall::getCurrent();
+    }
+
+    bool WasmtimeContext::isWokenEveryEpoch() const
+    {
+        return m_guest_profiler != nullptr
+            || (m_fuel_config.is_enabled && m_fuel_config.allowance != 0 && m_fuel_config.on_exhausted == WasmtimeFuelConfig::OnExhausted::Yield);
+    }
+
+    void WasmtimeContext::setEpochBudget(std::uint64_t budget_ticks)
+    {
+        budget_ticks = std::max<std::uint64_t>(1, budget_ticks);
+        if(isWokenEveryEpoch())
+        {
+            // Woken every epoch, the budget is counted down in the callback
+            m_budget_ticks_remaining = budget_ticks;
+            m_store.context().set_epoch_deadline(1);
+        }
+        else
+        {
+            // Only woken when the budget is used up
+            m_budget_ticks_remaining = 1;
+            m_store.context().set_epoch_deadline(budget_ticks);
+        }
+    }
+
+    void WasmtimeContext::clearEpochBudget()
+    {
+        m_budget_ticks_remaining = 0;
+        m_store.context().set_epoch_deadline(isWokenEveryEpoch() ? 1 : UNBOUNDED_EPOCH_DEADLINE);
+    }
+
+    wasmtime_error_t* WasmtimeContext::onEpochDeadline(std::uint64_t& epoch_deadline_delta)
+    {
+        if(m_guest_profiler != nullptr)
+        {
+            m_guest_profiler->sample(m_store.capi());
+        }
+        if(m_is_fuel_yielding && yieldOnFuelExhausted() == false)
+        {
+            epoch_deadline_delta = 0;
+            const char message[] = "script call cancelled while parked for fuel";
+            return wasmtime_error_new(message);
+        }
+
+        if(m_budget_ticks_remaining > 0 && --m_budget_ticks_remaining == 0)
+        {
+            onDeadlineMissed();
+            // Without async support a guest cannot be suspended, so an over-budget guest traps
+            epoch_deadline_delta = 0;
+            const char message[] = "script exceeded its tick budget";
+            return wasmtime_error_new(message);
+        }
+
+        epoch_deadline_delta = isWokenEveryEpoch() ? 1 : UNBOUNDED_EPOCH_DEADLINE;
+        return nullptr;
+    }
+
+    void WasmtimeContext::beginFuelMeter()
+    {
+        if(m_fuel_config.is_enabled == false)
+        {
+            return;
+        }
+
+        std::uint64_t current_tick = m_fuel_tick != nullptr ? m_fuel_tick->load(std::memory_order_relaxed) : 0;
+        if(m_fuel_config.refill == WasmtimeFuelConfig::Refill::PerCall || m_fuel_refill_tick != current_tick)
+        {
+            m_fuel_allowance_remaining = m_fuel_config.allowance;
+            m_fuel_refill_tick = current_tick;
+        }
+
+        bool is_capped = m_fuel_config.allowance != 0;
+        // Parking happens on the guest fiber, a synchronous call has nowhere to go and traps at its cap
+        m_is_fuel_yielding = is_capped && m_fuel_config.on_exhausted == WasmtimeFuelConfig::OnExhausted::Yield
+            && WasmtimeAsyncCall::getCurrent() != nullptr;
+        std::uint64_t fuel = is_capped && m_is_fuel_yielding == false ? m_fuel_allowance_remaining : UNBOUNDED_FUEL;
+
+        wasmtime::Result<std::monostate> fuel_result = m_store.context().set_fuel(fuel);
+        if(!fuel_result)
+        {
+            Core::Logger::error("Failed to set metered fuel, is consume_fuel enabled on the engine: {}", fuel_result.err().message());
+            m_is_fuel_yielding = false;
+            return;
+        }
+        m_fuel_meter_start = fuel;
+        m_fuel_slice_start = fuel;
+        m_is_fuel_metering = true;
+    }
+
+    WasmtimeContext::FuelMeterResult WasmtimeContext::endFuelMeter(bool is_call_failed)
+    {
+        FuelMeterResult result;
+        if(m_is_fuel_metering == false)
+        {
+            return result;
+        }
+        m_is_fuel_metering = false;
+        m_is_fuel_yielding = false;
+
+        wasmtime::Result<std::uint64_t> fuel_result = m_store.context().get_fuel();
+        std::uint64_t fuel_remaining = fuel_result ? fuel_result.unwrap() : 0;
+        result.is_metered = true;
+        result.fuel_consumed = m_fuel_meter_start - fuel_remaining;
+        // Component calls report traps as plain errors, the C API does not hand out their trap code. The out of
+        // fuel trap is the one failure that leaves the store with no fuel, a call that used up exactly its
+        // allowance and returned is healthy.
+        result.is_exhausted = is_call_failed && m_fuel_config.allowance != 0 && fuel_remaining == 0;
+
+        std::uint64_t slice_consumed = m_fuel_slice_start - fuel_remaining;
+        m_fuel_allowance_remaining -= std::min(m_fuel_allowance_remaining, slice_consumed);
+
+        // Back to unbounded so unmetered calls into this store are not stopped by what the last call left over
+        m_store.context().set_fuel(UNBOUNDED_FUEL).unwrap();
+        return result;
+    }
+
+    bool WasmtimeContext::yieldOnFuelExhausted()
+    {
+        wasmtime::Result<std::uint64_t> fuel_result = m_store.context().get_fuel();
+        if(!fuel_result || m_fuel_slice_start - fuel_result.unwrap() < m_fuel_allowance_remaining)
+        {
+            return true;
+        }
+
+        // Checked once per epoch, so a slice overshoots the allowance by at most one epoch worth of work.
+        // Where the guest parks depends on timing, the fuel it burns in total does not.
+        m_fuel_yield_count++;
+        std::uint64_t yield_tick = m_fuel_tick != nullptr ? m_fuel_tick->load(std::memory_order_relaxed) : 0;
+        const std::atomic<std::uint64_t>* fuel_tick = m_fuel_tick;
+        bool is_resumed = WasmtimeAsyncCall::awaitOnTick([fuel_tick, yield_tick]()
+        {
+            return fuel_tick == nullptr || fuel_tick->load(std::memory_order_relaxed) != yield_tick;
+        });
+        if(is_resumed == false)
+        {
+            return false;
+        }
+
+        m_fuel_allowance_remaining = m_fuel_config.allowance;
+        m_fuel_refill_tick = m_fuel_tick != nullptr ? m_fuel_tick->load(std::memory_order_relaxed) : 0;
+        fuel_result = m_store.context().get_fuel();
+        m_fuel_slice_start = fuel_result ? fuel_result.unwrap() : m_fuel_slice_start;
+        return true;
+    }
+
     void WasmtimeContext::addHostFunction(
         const std::string& module_name,
         const std::string& function_name,
@@ -20,6 +312,90 @@ namespace Arieo
 
         m_host_externs.push_back(std::move(host_function));
     }
+
+    WasmtimeContext::MemoryStatistics WasmtimeContext::getMemoryStatistics() const
+    {
+        MemoryStatistics statistics;
+        statistics.current_bytes = m_memory_account.getCurrentBytes();
+        statistics.peak_bytes = m_memory_account.getPeakBytes();
+        statistics.limit_bytes = m_memory_account.getLimitBytes();
+        statistics.memory_count = m_memory_account.getMemoryCount();
+        statistics.failed_grow_count = m_memory_account.getFailedGrowCount();
+        return statistics;
+    }
+
+    std::uint32_t WasmtimeContext::createSharedRegion(const std::string& name, size_t size)
+    {
+        std::unique_ptr<std::byte[]> owned_memory = std::make_unique<std::byte[]>(size);
+        std::uint32_t region_id = registerSharedRegion(name, std::span<std::byte>(owned_memory.get(), size));
+        if(region_id != 0)
+        {
+            m_shared_regions[region_id - 1].owned_memory = std::move(owned_memory);
+        }
+        return region_id;
+    }
+
+    std::uint32_t WasmtimeContext::registerSharedRegion(const std::string& name, std::span<std::byte> memory)
+    {
+        if(name.empty() || findSharedRegion(name) != 0)
+        {
+            Core::Logger::error("Shared region name '{}' is empty or already registered", name);
+            return 0;
+        }
+
+        m_shared_regions.push_back(SharedRegion{name, memory, nullptr});
+        return static_cast<std::uint32_t>(m_shared_regions.size());
+    }
+
+    void WasmtimeContext::removeSharedRegion(std::uint32_t region_id)
+    {
+        if(region_id == 0 || region_id > m_shared_regions.size())
+        {
+            return;
+        }
+        // Keep the slot so ids already handed to guests never alias a newer region
+        m_shared_regions[region_id - 1] = SharedRegion();
+    }
+
+    std::uint32_t WasmtimeContext::findSharedRegion(std::string_view name) const
+    {
+        for(size_t i = 0; i < m_shared_regions.size(); ++i)
+        {
+            if(m_shared_regions[i].name.empty() == false && m_shared_regions[i].name == name)
+            {
+                return static_cast<std::uint32_t>(i + 1);
+            }
+        }
+        return 0;
+    }
+
+    bool WasmtimeContext::isSharedRegionValid(std::uint32_t region_id) const
+    {
+        return region_id != 0 && region_id <= m_shared_regions.size() && m_shared_regions[region_id - 1].name.empty() == false;
+    }
+
+    size_t WasmtimeContext::getSharedRegionSize(std::uint32_t region_id) const
+    {
+        if(region_id == 0 || region_id > m_shared_regions.size())
+        {
+            return 0;
+        }
+        return m_shared_regions[region_id - 1].memory.size();
+    }
+
+    std::span<std::byte> WasmtimeContext::getSharedRegionBytes(std::uint32_t region_id, size_t offset, size_t size)
+    {
+        if(region_id == 0 || region_id > m_shared_regions.size())
+        {
+            return std::span<std::byte>();
+        }
+        std::span<std::byte> memory = m_shared_regions[region_id - 1].memory;
+        if(offset > memory.size() || size > memory.size() - offset)
+        {
+            return std::span<std::byte>();
+        }
+        return memory.subspan(offset, size);
+    }
 }
 
 
@@ -2,9 +2,74 @@
 
 #include "interface/script/script.h"
 #include <wasmtime.hh>
+#include "../engine/wasmtime_interface_table.h"
+#include "wasmtime_memory_accounting.h"
+#include "../profiling/wasmtime_guest_profiler.h"
+#include "../logging/wasmtime_guest_log.h"
+#include "../filesystem/wasmtime_archive_filesystem.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace Arieo
 {
+    class WasmtimeAsyncCall;
+
+    /**
+     * @brief Deterministic fuel metering of guest calls, read from script_engine.fuel
+     *
+     * Fuel counts executed wasm operations, so the cost of a call is the same on every machine
+     * and build. Metered calls are the tick calls of WasmtimeEngine::callFunctionWithBudget and
+     * every WasmtimeInstance::callFunction, async calls included.
+     */
+    struct WasmtimeFuelConfig
+    {
+        enum class Refill
+        {
+            // Every metered call starts with the full allowance
+            PerCall,
+            // Calls share the allowance until WasmtimeEngine::pumpAsyncCalls starts the next tick
+            PerTick,
+        };
+
+        enum class OnExhausted
+        {
+            // The guest traps, its instance has to be recreated
+            Trap,
+            // Async calls are parked until the next tick and continue with a fresh allowance,
+            // synchronous calls cannot be suspended and trap instead
+            Yield,
+        };
+
+        bool is_enabled = false;
+        // 0 only measures, guests are never stopped
+        std::uint64_t allowance = 0;
+        Refill refill = Refill::PerCall;
+        OnExhausted on_exhausted = OnExhausted::Trap;
+        // Epoch period used to check yielding calls when no tick budget or guest profiler drives the epoch
+        std::chrono::microseconds yield_check_interval = std::chrono::microseconds(1000);
+    };
+
+    /**
+     * @brief Per-context resource limits read from script_engine.context_limits, 0 leaves a resource unlimited
+     */
+    struct WasmtimeContextLimits
+    {
+        // Total linear memory of every instance in the context, also the size limit of each single memory
+        std::uint64_t max_memory_bytes = 0;
+        std::uint64_t max_table_elements = 0;
+        std::uint64_t max_instances = 0;
+        // Requires an engine created with consume_fuel, a guest trapping on empty fuel is not refilled.
+        // Ignored when fuel metering is enabled, which refills the store itself.
+        std::uint64_t fuel = 0;
+        WasmtimeFuelConfig fuel_metering;
+    };
+
     /**
      * @brief Wasmtime-based script context implementation
      */
@@ -12,29 +77,158 @@ namespace Arieo
         : public Interface::Script::IContext
     {
     public:
-        WasmtimeContext(wasmtime::Engine& engine)
-            : m_store(engine)
-        {
-            // Configure WASI and store it within our `wasmtime_store_t`
-            wasmtime::WasiConfig wasi;
-            wasi.inherit_argv();
-            wasi.inherit_env();
-            wasi.inherit_stdin();
-            wasi.inherit_stdout();
-            wasi.inherit_stderr();
-            m_store.context().set_wasi(std::move(wasi)).unwrap();
-        }
+        // Deadline used outside of budgeted calls, far enough away to never be reached
+        static constexpr std::uint64_t UNBOUNDED_EPOCH_DEADLINE = std::uint64_t(1) << 62;
+        // Store fuel outside of capped calls, far more than any guest burns
+        static constexpr std::uint64_t UNBOUNDED_FUEL = std::uint64_t(1) << 62;
+
+        // Takes ownership of guest_profiler, which may be null. log_stream is owned by the engine's log pipeline
+        // and null while it is disabled, in which case guest logs and WASI stdio go straight to the host.
+        // archive_filesystem is shared by every context of the engine and null unless script_engine.filesystem is set,
+        // the context keeps it alive until it is destroyed.
+        WasmtimeContext(wasmtime::Engine& engine, bool is_epoch_interruption, const WasmtimeContextLimits& limits,
+            WasmtimeGuestProfiler* guest_profiler = nullptr, WasmtimeGuestLogStream* log_stream = nullptr,
+            std::shared_ptr<WasmtimeArchiveFilesystem> archive_filesystem = nullptr);
+        ~WasmtimeContext();
 
         void addHostFunction(
             const std::string& module_name,
             const std::string& function_name,
             const std::function<void()>& function
         ) override;
+
+        void onDeadlineMissed();
+
+        // False while an async call of this context is parked or running on a fiber other than the calling thread's.
+        // The parked guest still has frames in the store, nothing else may enter it until that call completes.
+        bool isEnterable() const;
+
+        // Guests trap once budget_ticks epochs pass, until the budget is cleared again
+        void setEpochBudget(std::uint64_t budget_ticks);
+        void clearEpochBudget();
+        wasmtime_error_t* onEpochDeadline(std::uint64_t& epoch_deadline_delta);
+
+        struct FuelMeterResult
+        {
+            bool is_metered = false;
+            std::uint64_t fuel_consumed = 0;
+            // The call ran out of its allowance and trapped
+            bool is_exhausted = false;
+        };
+        // Brackets one guest call while fuel metering is enabled, no-ops otherwise. Not reentrant,
+        // host imports calling back into the same store are counted towards the outer call.
+        // is_call_failed tells whether the bracketed call returned an error, only a failed call can be exhausted.
+        void beginFuelMeter();
+        FuelMeterResult endFuelMeter(bool is_call_failed);
+        // Times async calls of this context were parked for running out of fuel
+        std::uint64_t getFuelYieldCount() const { return m_fuel_yield_count; }
+
+        // Largest list one guest read lowers. The component C API stages every byte as a component value,
+        // so a guest controlled length must not size a host allocation unchecked.
+        static constexpr size_t MAX_GUEST_READ_SIZE = 1024 * 1024;
+
+        // Shared regions are host memory that host systems read and write in place through span views.
+        // Guests reach them through arieo:application/shared-buffer, which copies through component
+        // values on both write and read, the C API gives the host no view of a component's linear memory.
+        // Ids start at 1, 0 is never a valid region.
+        std::uint32_t createSharedRegion(const std::string& name, size_t size);
+        // Exposes memory owned by the caller, it must outlive the region or be removed first
+        std::uint32_t registerSharedRegion(const std::string& name, std::span<std::byte> memory);
+        void removeSharedRegion(std::uint32_t region_id);
+        std::uint32_t findSharedRegion(std::string_view name) const;
+        size_t getSharedRegionSize(std::uint32_t region_id) const;
+        // False for 0, removed and never created ids
+        bool isSharedRegionValid(std::uint32_t region_id) const;
+
+        // Bounds checked view of count elements at byte offset, empty if the range does not fit the region
+        template<typename T>
+        std::span<T> getSharedRegionView(std::uint32_t region_id, size_t offset, size_t count)
+        {
+            std::span<std::byte> bytes = getSharedRegionBytes(region_id, offset, count * sizeof(T));
+            if(bytes.empty() || reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(T) != 0)
+            {
+                return std::span<T>();
+            }
+            return std::span<T>(reinterpret_cast<T*>(bytes.data()), count);
+        }
+        std::span<std::byte> getSharedRegionBytes(std::uint32_t region_id, size_t offset, size_t size);
+
+        // Archive entries opened by guests through arieo:application/archive-fs. Handles start at 1, 0 is never valid.
+        std::uint32_t openArchiveFile(std::string_view guest_path);
+        void closeArchiveFile(std::uint32_t file_handle);
+        // Resident bytes of the whole entry, empty for an invalid handle
+        std::span<const std::byte> getArchiveFileBytes(std::uint32_t file_handle) const;
+
+        struct MemoryStatistics
+        {
+            std::uint64_t current_bytes = 0;
+            std::uint64_t peak_bytes = 0;
+            std::uint64_t limit_bytes = 0;
+            std::uint64_t memory_count = 0;
+            std::uint64_t failed_grow_count = 0;
+        };
+        // Only counts memories created while host memory accounting is installed, see WasmtimeMemoryAccounting
+        MemoryStatistics getMemoryStatistics() const;
+        WasmtimeMemoryAccount& getMemoryAccount() { return m_memory_account; }
+        // Interface handles get-interface answers without asking ModuleManager
+        WasmtimeInterfaceHandleCache& getInterfaceHandleCache() { return m_interface_handle_cache; }
+
+        // Shown with every guest log line of this context, defaults to the engine's context name
+        void setScriptName(std::string_view script_name);
+        WasmtimeGuestLogStream* getLogStream() { return m_log_stream; }
     private:
+        struct SharedRegion
+        {
+            std::string name;
+            std::span<std::byte> memory;
+            std::unique_ptr<std::byte[]> owned_memory;
+        };
+
+        // Profiling and yielding fuel metering need the callback on every epoch, not only once the budget runs out
+        bool isWokenEveryEpoch() const;
+        // Parks the running async call until the next tick once its slice burned the allowance,
+        // false when the call was cancelled while parked
+        bool yieldOnFuelExhausted();
+
         friend class WasmtimeEngine;
         friend class WasmtimeInstance;
+        // Declared before m_store, guest memories release their bytes into it while the store is dropped
+        WasmtimeMemoryAccount m_memory_account;
         wasmtime::Store m_store;
         std::vector<wasmtime::Extern> m_host_externs;
+        // Instances created in this store, released together with it
+        std::uint64_t m_instance_count = 0;
+        // Interface handles already handed to guests of this store
+        WasmtimeInterfaceHandleCache m_interface_handle_cache;
+        // Indexed by region id - 1, removed regions leave an empty name behind
+        std::vector<SharedRegion> m_shared_regions;
+        // Started and not yet completed, set and cleared by the engine on the tick thread
+        WasmtimeAsyncCall* m_active_async_call = nullptr;
+        // Async calls created on this context and not completed yet, pending ones included
+        std::uint32_t m_async_call_count = 0;
+        // Incremented by the epoch deadline callback each time a guest runs past its budget
+        std::uint64_t m_deadline_miss_count = 0;
+        // Epoch callbacks left before the running budgeted call traps, 0 outside of budgeted calls
+        std::uint64_t m_budget_ticks_remaining = 0;
+        // Sampled on every epoch tick, which makes the callback fire each epoch instead of once per budget
+        WasmtimeGuestProfiler* m_guest_profiler = nullptr;
+        WasmtimeGuestLogStream* m_log_stream = nullptr;
+        std::shared_ptr<WasmtimeArchiveFilesystem> m_archive_filesystem;
+        // Indexed by file handle - 1, closed handles leave null behind
+        std::vector<const WasmtimeArchiveFilesystem::ResidentFile*> m_archive_files;
+
+        WasmtimeFuelConfig m_fuel_config;
+        // Advanced by the engine once per tick, null while fuel metering is disabled
+        const std::atomic<std::uint64_t>* m_fuel_tick = nullptr;
+        std::uint64_t m_fuel_refill_tick = 0;
+        std::uint64_t m_fuel_allowance_remaining = 0;
+        // Store fuel when the running metered call started, and when its current slice between yields started
+        std::uint64_t m_fuel_meter_start = 0;
+        std::uint64_t m_fuel_slice_start = 0;
+        bool m_is_fuel_metering = false;
+        // The running call is async and parks instead of trapping
+        bool m_is_fuel_yielding = false;
+        std::uint64_t m_fuel_yield_count = 0;
     };
 }
 
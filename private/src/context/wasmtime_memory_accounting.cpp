@@ -0,0 +1,244 @@
+#include "base/prerequisites.h"
+#include "wasmtime_memory_accounting.h"
+#include "core/logger/logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Arieo
+{
+    namespace
+    {
+        thread_local WasmtimeMemoryAccount* s_current_account = nullptr;
+
+        // A memory with minimum 0 and neither reservation nor guard would ask for an empty mapping, which the
+        // system rejects. One wasm page is a multiple of every host page size.
+        constexpr size_t MIN_REGION_SIZE = 64 * 1024;
+
+        // Address space only, nothing is readable until committed
+        void* reserveRegion(size_t size)
+        {
+            size = std::max(size, MIN_REGION_SIZE);
+#if defined(_WIN32)
+            return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+            void* address = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            return address == MAP_FAILED ? nullptr : address;
+#endif
+        }
+
+        // Wasm page sizes are multiples of every host page size, so sizes here are always page aligned
+        bool commitRegion(void* address, size_t size)
+        {
+            if(size == 0)
+            {
+                return true;
+            }
+#if defined(_WIN32)
+            return VirtualAlloc(address, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+            return mprotect(address, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+        }
+
+        void releaseRegion(void* address, size_t size)
+        {
+            size = std::max(size, MIN_REGION_SIZE);
+#if defined(_WIN32)
+            VirtualFree(address, 0, MEM_RELEASE);
+#else
+            munmap(address, size);
+#endif
+        }
+    }
+
+    struct WasmtimeMemoryAccounting::LinearMemory
+    {
+        WasmtimeMemoryAccount* account = nullptr;
+        std::uint8_t* base = nullptr;
+        size_t byte_size = 0;
+        // Usable bytes before the guard region
+        size_t capacity = 0;
+        size_t maximum = 0;
+        size_t guard_size = 0;
+        // Memories without a static reservation may move when they outgrow their mapping
+        bool is_movable = false;
+    };
+
+    bool WasmtimeMemoryAccount::charge(std::uint64_t bytes)
+    {
+        std::uint64_t limit_bytes = m_limit_bytes;
+        std::uint64_t current_bytes = m_current_bytes.load();
+        do
+        {
+            if(limit_bytes != 0 && current_bytes + bytes > limit_bytes)
+            {
+                m_failed_grow_count++;
+                return false;
+            }
+        } while(m_current_bytes.compare_exchange_weak(current_bytes, current_bytes + bytes) == false);
+
+        std::uint64_t new_bytes = current_bytes + bytes;
+        std::uint64_t peak_bytes = m_peak_bytes.load();
+        while(peak_bytes < new_bytes && m_peak_bytes.compare_exchange_weak(peak_bytes, new_bytes) == false)
+        {
+        }
+        return true;
+    }
+
+    void WasmtimeMemoryAccount::release(std::uint64_t bytes)
+    {
+        m_current_bytes -= std::min<std::uint64_t>(bytes, m_current_bytes);
+    }
+
+    void WasmtimeMemoryAccounting::install(wasmtime::Config& config)
+    {
+        // Stateless, the creator only needs to outlive the engine
+        static wasmtime_memory_creator_t memory_creator = {nullptr, &WasmtimeMemoryAccounting::newMemory, nullptr};
+        wasmtime_config_host_memory_creator_set(config.capi(), &memory_creator);
+    }
+
+    WasmtimeMemoryAccounting::Scope::Scope(WasmtimeMemoryAccount& account)
+        : m_previous_account(s_current_account)
+    {
+        s_current_account = &account;
+    }
+
+    WasmtimeMemoryAccounting::Scope::~Scope()
+    {
+        s_current_account = m_previous_account;
+    }
+
+    wasmtime_error_t* WasmtimeMemoryAccounting::newMemory(void* env, const wasm_memorytype_t* memory_type, size_t minimum, size_t maximum,
+        size_t reserved_size_in_bytes, size_t guard_size_in_bytes, wasmtime_linear_memory_t* memory_ret)
+    {
+        WasmtimeMemoryAccount* account = s_current_account;
+        if(account != nullptr && account->charge(minimum) == false)
+        {
+            return wasmtime_error_new("script context memory limit exceeded");
+        }
+
+        LinearMemory* linear_memory = Base::newT<LinearMemory>();
+        linear_memory->account = account;
+        linear_memory->byte_size = minimum;
+        linear_memory->maximum = maximum;
+        linear_memory->guard_size = guard_size_in_bytes;
+        linear_memory->is_movable = reserved_size_in_bytes == 0;
+        linear_memory->capacity = linear_memory->is_movable ? minimum : std::max(reserved_size_in_bytes, minimum);
+
+        linear_memory->base = static_cast<std::uint8_t*>(reserveRegion(linear_memory->capacity + guard_size_in_bytes));
+        if(linear_memory->base == nullptr || commitRegion(linear_memory->base, minimum) == false)
+        {
+            if(linear_memory->base != nullptr)
+            {
+                releaseRegion(linear_memory->base, linear_memory->capacity + guard_size_in_bytes);
+            }
+            if(account != nullptr)
+            {
+                account->release(minimum);
+            }
+            Base::deleteT(linear_memory);
+            return wasmtime_error_new("failed to reserve guest linear memory");
+        }
+
+        if(account != nullptr)
+        {
+            account->m_memory_count++;
+        }
+
+        memory_ret->env = linear_memory;
+        memory_ret->get_memory = &WasmtimeMemoryAccounting::getMemory;
+        memory_ret->grow_memory = &WasmtimeMemoryAccounting::growMemory;
+        memory_ret->finalizer = &WasmtimeMemoryAccounting::finalizeMemory;
+        return nullptr;
+    }
+
+    uint8_t* WasmtimeMemoryAccounting::getMemory(void* env, size_t* byte_size, size_t* byte_capacity)
+    {
+        LinearMemory* linear_memory = static_cast<LinearMemory*>(env);
+        *byte_size = linear_memory->byte_size;
+        *byte_capacity = linear_memory->capacity;
+        return linear_memory->base;
+    }
+
+    wasmtime_error_t* WasmtimeMemoryAccounting::growMemory(void* env, size_t new_size)
+    {
+        LinearMemory* linear_memory = static_cast<LinearMemory*>(env);
+        if(new_size <= linear_memory->byte_size)
+        {
+            return nullptr;
+        }
+
+        size_t delta = new_size - linear_memory->byte_size;
+        if(linear_memory->account != nullptr && linear_memory->account->charge(delta) == false)
+        {
+            return wasmtime_error_new("script context memory limit exceeded");
+        }
+
+        if(new_size > linear_memory->capacity)
+        {
+            if(linear_memory->is_movable == false)
+            {
+                if(linear_memory->account != nullptr)
+                {
+                    linear_memory->account->release(delta);
+                }
+                return wasmtime_error_new("guest linear memory outgrew its reservation");
+            }
+
+            // Double the mapping so a guest growing one page at a time does not copy on every grow
+            size_t new_capacity = std::max(new_size, std::min(linear_memory->maximum, linear_memory->capacity * 2));
+            std::uint8_t* new_base = static_cast<std::uint8_t*>(reserveRegion(new_capacity + linear_memory->guard_size));
+            if(new_base == nullptr || commitRegion(new_base, new_size) == false)
+            {
+                if(new_base != nullptr)
+                {
+                    releaseRegion(new_base, new_capacity + linear_memory->guard_size);
+                }
+                if(linear_memory->account != nullptr)
+                {
+                    linear_memory->account->release(delta);
+                }
+                return wasmtime_error_new("failed to grow guest linear memory");
+            }
+
+            std::memcpy(new_base, linear_memory->base, linear_memory->byte_size);
+            releaseRegion(linear_memory->base, linear_memory->capacity + linear_memory->guard_size);
+            linear_memory->base = new_base;
+            linear_memory->capacity = new_capacity;
+        }
+        else if(commitRegion(linear_memory->base + linear_memory->byte_size, delta) == false)
+        {
+            if(linear_memory->account != nullptr)
+            {
+                linear_memory->account->release(delta);
+            }
+            return wasmtime_error_new("failed to grow guest linear memory");
+        }
+
+        linear_memory->byte_size = new_size;
+        return nullptr;
+    }
+
+    void WasmtimeMemoryAccounting::finalizeMemory(void* env)
+    {
+        LinearMemory* linear_memory = static_cast<LinearMemory*>(env);
+        releaseRegion(linear_memory->base, linear_memory->capacity + linear_memory->guard_size);
+        if(linear_memory->account != nullptr)
+        {
+            linear_memory->account->release(linear_memory->byte_size);
+            linear_memory->account->m_memory_count--;
+        }
+        Base::deleteT(linear_memory);
+    }
+}
+
+
+
+
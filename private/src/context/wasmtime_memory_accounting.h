@@ -0,0 +1,79 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include <wasmtime.hh>
+#include <atomic>
+#include <cstdint>
+
+namespace Arieo
+{
+    /**
+     * @brief Live linear memory usage of one context, charged by the host memory creator
+     *
+     * Memories keep a pointer to the account they were created under, so the account must outlive
+     * the store that owns them.
+     */
+    class WasmtimeMemoryAccount final
+    {
+    public:
+        // 0 leaves the context unlimited, per memory limits are still applied by the store limiter
+        void setLimit(std::uint64_t max_bytes) { m_limit_bytes = max_bytes; }
+
+        // Fails without charging anything when the context would exceed its limit
+        bool charge(std::uint64_t bytes);
+        void release(std::uint64_t bytes);
+
+        std::uint64_t getCurrentBytes() const { return m_current_bytes; }
+        std::uint64_t getPeakBytes() const { return m_peak_bytes; }
+        std::uint64_t getLimitBytes() const { return m_limit_bytes; }
+        std::uint64_t getMemoryCount() const { return m_memory_count; }
+        std::uint64_t getFailedGrowCount() const { return m_failed_grow_count; }
+    private:
+        friend class WasmtimeMemoryAccounting;
+
+        std::atomic<std::uint64_t> m_current_bytes = 0;
+        std::atomic<std::uint64_t> m_peak_bytes = 0;
+        std::atomic<std::uint64_t> m_limit_bytes = 0;
+        std::atomic<std::uint64_t> m_memory_count = 0;
+        std::atomic<std::uint64_t> m_failed_grow_count = 0;
+    };
+
+    /**
+     * @brief Host memory creator that allocates guest linear memories and charges them to a context
+     *
+     * Wasmtime does not say which store a memory is created for, so instantiation runs inside a Scope
+     * naming the account. Growth is charged to the account captured at creation and may happen on any thread.
+     * The pooling allocator never calls a host memory creator, so accounting is off while pooling is enabled.
+     * Installing the creator also turns off wasmtime's copy-on-write memory initialization: every instantiation
+     * copies the data segments into fresh memory, so accounting is only installed when context_limits ask for it.
+     */
+    class WasmtimeMemoryAccounting final
+    {
+    public:
+        static void install(wasmtime::Config& config);
+
+        class Scope final
+        {
+        public:
+            explicit Scope(WasmtimeMemoryAccount& account);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        private:
+            WasmtimeMemoryAccount* m_previous_account = nullptr;
+        };
+    private:
+        struct LinearMemory;
+
+        static wasmtime_error_t* newMemory(void* env, const wasm_memorytype_t* memory_type, size_t minimum, size_t maximum,
+            size_t reserved_size_in_bytes, size_t guard_size_in_bytes, wasmtime_linear_memory_t* memory_ret);
+        static uint8_t* getMemory(void* env, size_t* byte_size, size_t* byte_capacity);
+        static wasmtime_error_t* growMemory(void* env, size_t new_size);
+        static void finalizeMemory(void* env);
+    };
+}
+
+
+
+
@@ -2,9 +2,11 @@
 #include "core/logger/logger.h"
 
 #include "wasmtime_engine.h"
+#include "wasmtime_engine_config.h"
 #include "../context/wasmtime_context.h"
 #include "../module/wasmtime_module.h"
 #include "../instance/wasmtime_instance.h"
+#include "../utility/wasmtime_sha256.h"
 
 #include "lib/wasmtime_linker/interface_wasmtime_linker.h"
 
@@ -16,6 +18,9 @@
 #include <fstream>
 #include <algorithm>
 #include <vector>
+#include <chrono>
+#include <any>
+#include <format>
 
 namespace Arieo
 {
@@ -24,28 +29,120 @@ namespace Arieo
         Core::Logger::info("WasmtimeEngine test_function called");
     }
 
-    void WasmtimeEngine::initialize()
+    void WasmtimeEngine::initialize(const Core::ConfigNode& system_node)
     {
-        // Create engine configuration
-        wasmtime::Config config;
-        config.debug_info(true); // Equivalent to: -D debug-info=y
-        config.cranelift_opt_level(wasmtime::OptLevel::None); // Equivalent to: -O opt-level=0
-        config.wasm_component_model(true); // Enable component model support
-        
-        // Enable native unwinding for debugger integration
-        // On Windows, this enables debugging without needing Linux-specific profiling
-        config.native_unwind_info(true); // Enables native debugger support (LLDB/GDB)
-
-        // config.native_unwind_info(true); // Enable native stack unwinding for debuggers
-        // config.cranelift_debug_verifier(false); // Disable verifier that may interfere with debugging
-        // config.consume_fuel(false); // Disable fuel consumption
-        // config.epoch_interruption(false); // Disable epoch interruption
-        // config.macos_use_mach_ports(false); // Use standard GDB JIT interface on all platforms
-        
+        m_profile = parseEngineProfile(system_node);
+        m_tick_budget = parseTickBudget(system_node);
+        if(m_tick_budget.has_value())
+        {
+            m_profile.epoch_interruption = true;
+        }
+        parseContextLimits(system_node);
+        m_context_limits.fuel_metering = parseFuelConfig(system_node);
+        if(m_context_limits.fuel != 0 || m_context_limits.fuel_metering.is_enabled)
+        {
+            m_profile.consume_fuel = true;
+        }
+        bool is_fuel_yield = m_context_limits.fuel_metering.is_enabled && m_context_limits.fuel_metering.allowance != 0
+            && m_context_limits.fuel_metering.on_exhausted == WasmtimeFuelConfig::OnExhausted::Yield;
+        if(is_fuel_yield)
+        {
+            // Yielding calls check their fuel from the epoch callback
+            m_profile.epoch_interruption = true;
+        }
+        m_profiling_config = parseProfilingConfig(system_node);
+        if(m_profiling_config.mode == ProfilingMode::Guest)
+        {
+            // The guest profiler samples from the epoch callback
+            m_profile.epoch_interruption = true;
+        }
+        Core::Logger::info("Wasmtime engine profile '{}': {}", m_profile.name, WasmtimeEngineConfig::describe(m_profile));
+
+        // script_engine:
+        //   async:
+        //     max_fibers: <guest calls that can be suspended at the same time>
+        if(system_node["script_engine"].IsDefined() && system_node["script_engine"]["async"].IsDefined()
+            && system_node["script_engine"]["async"]["max_fibers"].IsDefined())
+        {
+            m_max_fiber_count = system_node["script_engine"]["async"]["max_fibers"].as<size_t>();
+        }
+
+        // script_engine:
+        //   load_workers: <threads compiling modules loaded through the async load functions, 0 loads inline>
+        size_t load_worker_count = 2;
+        if(system_node["script_engine"].IsDefined() && system_node["script_engine"]["load_workers"].IsDefined())
+        {
+            load_worker_count = system_node["script_engine"]["load_workers"].as<size_t>();
+        }
+
+        m_pooling_config = parsePoolingConfig(system_node);
+        if(m_pooling_config.has_value())
+        {
+            Core::Logger::info("Wasmtime pooling allocator enabled: {}", WasmtimeEngineConfig::describe(m_pooling_config.value()));
+        }
 
         // Create engine and store with this config
+        wasmtime::Config config = WasmtimeEngineConfig::createConfig(m_profile, m_pooling_config);
+        if(m_is_memory_accounting)
+        {
+            if(m_pooling_config.has_value())
+            {
+                // Pooled memories never reach a host memory creator, the pool's own limits apply instead
+                Core::Logger::error("Script memory accounting is not available with the pooling allocator, disabled");
+                m_is_memory_accounting = false;
+            }
+            else
+            {
+                WasmtimeMemoryAccounting::install(config);
+            }
+        }
+        switch(m_profiling_config.mode)
+        {
+        case ProfilingMode::PerfMap:
+            config.profiler(wasmtime::ProfilingStrategy::Perfmap);
+            break;
+        case ProfilingMode::JitDump:
+            config.profiler(wasmtime::ProfilingStrategy::Jitdump);
+            break;
+        case ProfilingMode::VTune:
+            config.profiler(wasmtime::ProfilingStrategy::Vtune);
+            break;
+        case ProfilingMode::Guest:
+#if defined(__linux__)
+            // The guest profile cannot name component frames, the perf map lets perf name them
+            config.profiler(wasmtime::ProfilingStrategy::Perfmap);
+#endif
+            break;
+        default:
+            break;
+        }
         m_engine = Base::newT<wasmtime::Engine>(std::move(config));
 
+        initComponentCache(system_node, WasmtimeEngineConfig::getFingerprint(m_profile));
+        m_module_loader.start(load_worker_count);
+
+        if(m_tick_budget.has_value())
+        {
+            m_epoch_ticker.start(*m_engine, m_tick_budget->epoch_period);
+        }
+        else if(m_profiling_config.mode == ProfilingMode::Guest)
+        {
+            m_epoch_ticker.start(*m_engine, m_profiling_config.guest_interval);
+        }
+        else if(is_fuel_yield)
+        {
+            m_epoch_ticker.start(*m_engine, m_context_limits.fuel_metering.yield_check_interval);
+        }
+
+        initMetrics(system_node);
+
+        WasmtimeGuestLogConfig guest_log_config = parseGuestLogConfig(system_node);
+        if(guest_log_config.is_enabled)
+        {
+            m_guest_log_pipeline.start(guest_log_config);
+        }
+        initArchiveFilesystem(system_node);
+
         m_linker = Base::newT<wasmtime::component::Linker>(*m_engine);
         m_linker->add_wasip2().unwrap();
         Core::Logger::info("Wasmtime scripting engine initialized");
@@ -57,13 +154,21 @@ namespace Arieo
             auto host_instance = m_linker->root().add_instance("arieo:application/host").unwrap();
             host_instance.add_func(
                 "log",
-                [](wasmtime::Store::Context store_ctx, 
+                [this](wasmtime::Store::Context store_ctx, 
                 const wasmtime::component::FuncType& func_type,
                 wasmtime::Span<wasmtime::component::Val> args,
                 wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate> {
+                    WasmtimeMetrics::ScopedTimer host_timer(m_metrics, m_host_metric_ids.host);
                     // Extract string from args[0]
                     if (args.size() > 0 && args[0].is_string() == true) {
                         auto message = args[0].get_string();
+                        // Queued for the log pipeline's thread, the guest does not wait on logger I/O
+                        WasmtimeGuestLogStream* log_stream = std::any_cast<WasmtimeContext*>(store_ctx.get_data())->getLogStream();
+                        if(log_stream != nullptr)
+                        {
+                            log_stream->push(message);
+                            return wasmtime::Result<std::monostate>(std::monostate{});
+                        }
                         Core::Logger::info("[WASM Guest] {}", message);
                     }
                     test_function();
@@ -81,66 +186,331 @@ namespace Arieo
                 wasmtime::Span<wasmtime::component::Val> args,
                 wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate> 
                 {
+                    WasmtimeMetrics::ScopedTimer host_timer(m_metrics, m_host_metric_ids.module_manager);
                     // Extract pointer and length from args
                     if (args.size() >= 3) 
                     {
                         uint64_t interface_id = args[0].get_u64();
                         uint64_t interface_checksum = args[1].get_u64();
-                        std::string_view instance_name = args[2].get_string(); // unused for now
-                        
-                        Core::Logger::info("[Host] GetInstance called with interface_id {}, interface_checksum {}, interface_name {}", interface_id, interface_checksum, instance_name);
-                        
-                        std::uint64_t instance_handle = 0;
-
-                        // search for interface in map
-                        auto found_export_interface_info_iter = m_interface_export_map.find(interface_id);
-                        if(found_export_interface_info_iter == m_interface_export_map.end())
+                        std::string_view instance_name = args[2].get_string();
+
+                        std::uint64_t instance_handle = getInterfaceHandle(store_ctx, interface_id, interface_checksum, instance_name);
+
+                        // Return instance handle
+                        if (results.size() > 0) {
+                            results[0] = wasmtime::component::Val(instance_handle);
+                        }
+                    }
+
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+
+            // Host owned regions registered on the context, see WasmtimeContext::createSharedRegion.
+            // Guest data is copied through component values, only the host side works in place.
+            // For the WIT interface: interface shared-buffer {
+            //     find: func(name: string) -> u32;
+            //     size: func(id: u32) -> u64;
+            //     write: func(id: u32, offset: u64, data: list<u8>) -> bool;
+            //     read: func(id: u32, offset: u64, len: u32) -> list<u8>; }
+            auto shared_buffer_instance = m_linker->root().add_instance("arieo:application/shared-buffer").unwrap();
+            shared_buffer_instance.add_func(
+                "find",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 1 && results.size() > 0 && args[0].is_string())
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        results[0] = wasmtime::component::Val(wasmtime_context->findSharedRegion(args[0].get_string()));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            shared_buffer_instance.add_func(
+                "size",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 1 && results.size() > 0)
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        results[0] = wasmtime::component::Val(static_cast<std::uint64_t>(wasmtime_context->getSharedRegionSize(args[0].get_u32())));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            shared_buffer_instance.add_func(
+                "write",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 3 && results.size() > 0 && args[2].is_list())
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        std::uint32_t region_id = args[0].get_u32();
+                        const wasmtime::component::List& data = args[2].get_list();
+                        std::span<std::byte> destination = wasmtime_context->getSharedRegionBytes(
+                            region_id,
+                            static_cast<size_t>(args[1].get_u64()),
+                            data.size()
+                        );
+                        bool is_written = wasmtime_context->isSharedRegionValid(region_id) && destination.size() == data.size();
+                        if(is_written)
                         {
-                            Core::Logger::error("Interface ID {} not found in registered interface map", interface_id);
-                            // Return null instance handle
-                            if (results.size() > 0) {
-                                results[0] = wasmtime::component::Val(0);
+                            size_t index = 0;
+                            for(const wasmtime::component::Val& value : data)
+                            {
+                                if(value.is_u8() == false)
+                                {
+                                    return wasmtime::Error(wasmtime_error_new("shared-buffer.write data must be a list<u8>"));
+                                }
+                                destination[index++] = static_cast<std::byte>(value.get_u8());
                             }
-                            return wasmtime::Result<std::monostate>(std::monostate{});
                         }
+                        results[0] = wasmtime::component::Val(is_written);
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            shared_buffer_instance.add_func(
+                "read",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 3 && results.size() > 0)
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        std::uint32_t region_id = args[0].get_u32();
+                        std::uint64_t offset = args[1].get_u64();
+                        size_t region_size = wasmtime_context->getSharedRegionSize(region_id);
+                        // Short reads past the end of the region or above MAX_GUEST_READ_SIZE, the guest loops for more
+                        size_t read_size = offset < region_size
+                            ? std::min<size_t>({static_cast<size_t>(args[2].get_u32()), region_size - static_cast<size_t>(offset), WasmtimeContext::MAX_GUEST_READ_SIZE})
+                            : 0;
+                        std::span<std::byte> source = wasmtime_context->getSharedRegionBytes(region_id, static_cast<size_t>(offset), read_size);
 
-                        // check the checksum
-                        if(found_export_interface_info_iter->second->m_interface_checksum != interface_checksum)
+                        std::vector<wasmtime::component::Val> values;
+                        values.reserve(source.size());
+                        for(std::byte value : source)
                         {
-                            Core::Logger::error("Interface ID {} checksum mismatch: expected {}, got {}", 
-                                interface_id,
-                                found_export_interface_info_iter->second->m_interface_checksum,
-                                interface_checksum);
-                            // Return null instance handle
-                            if (results.size() > 0) {
-
-                                results[0] = wasmtime::component::Val(0);
-                            }
-                            return wasmtime::Result<std::monostate>(std::monostate{});
+                            values.emplace_back(static_cast<std::uint8_t>(value));
                         }
+                        results[0] = wasmtime::component::Val(wasmtime::component::List(std::move(values)));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
 
-                        // Call the interface create function callback to create the instance
-                        Core::Logger::trace("Creating interface instance for ID {}", interface_id);
+            // Read-only archive entries for guests, see WasmtimeArchiveFilesystem
+            // For the WIT interface: interface archive-fs {
+            //     open: func(path: string) -> u32;
+            //     size: func(file: u32) -> u64;
+            //     read: func(file: u32, offset: u64, len: u32) -> list<u8>;
+            //     close: func(file: u32); }
+            auto archive_fs_instance = m_linker->root().add_instance("arieo:application/archive-fs").unwrap();
+            archive_fs_instance.add_func(
+                "open",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 1 && results.size() > 0 && args[0].is_string())
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        results[0] = wasmtime::component::Val(wasmtime_context->openArchiveFile(args[0].get_string()));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            archive_fs_instance.add_func(
+                "size",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 1 && results.size() > 0)
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        results[0] = wasmtime::component::Val(static_cast<std::uint64_t>(wasmtime_context->getArchiveFileBytes(args[0].get_u32()).size()));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            archive_fs_instance.add_func(
+                "read",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 3 && results.size() > 0)
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        std::span<const std::byte> file_bytes = wasmtime_context->getArchiveFileBytes(args[0].get_u32());
+                        std::uint64_t offset = std::min<std::uint64_t>(args[1].get_u64(), file_bytes.size());
+                        // The list is staged as one component value per byte before it is lowered, so reads are
+                        // capped at MAX_GUEST_READ_SIZE and the guest loops for the rest
+                        size_t read_size = static_cast<size_t>(std::min<std::uint64_t>(
+                            {static_cast<std::uint64_t>(args[2].get_u32()), file_bytes.size() - offset, static_cast<std::uint64_t>(WasmtimeContext::MAX_GUEST_READ_SIZE)}));
+                        std::vector<wasmtime::component::Val> values;
+                        values.reserve(read_size);
+                        for(std::byte value : file_bytes.subspan(static_cast<size_t>(offset), read_size))
+                        {
+                            values.emplace_back(static_cast<std::uint8_t>(value));
+                        }
+                        results[0] = wasmtime::component::Val(wasmtime::component::List(std::move(values)));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            archive_fs_instance.add_func(
+                "close",
+                [](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 1)
+                    {
+                        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+                        wasmtime_context->closeArchiveFile(args[0].get_u32());
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
 
-                        instance_handle = reinterpret_cast<uint64_t>(::Core::ModuleManager::getInterfaceRaw(
-                            found_export_interface_info_iter->second->m_interface_type_hash,
-                            std::string(instance_name)
-                        ));
-                        
-                        // Return instance handle
-                        if (results.size() > 0) {
-                            results[0] = wasmtime::component::Val(instance_handle);
+            // Many small interface calls recorded by the guest and replayed in one transition, see WasmtimeHostCallBatch.
+            // Commands travel as 64-bit words, a batch lifts one value per argument instead of one guest to host
+            // transition per call.
+            // For the WIT interface: interface host-batch {
+            //     function-id: func(interface-name: string, function-name: string) -> u32;
+            //     submit: func(commands: list<u64>) -> list<u64>; }
+            auto host_batch_instance = m_linker->root().add_instance("arieo:application/host-batch").unwrap();
+            host_batch_instance.add_func(
+                "function-id",
+                [this](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    if(args.size() >= 2 && results.size() > 0 && args[0].is_string() && args[1].is_string())
+                    {
+                        results[0] = wasmtime::component::Val(m_host_call_batch.findFunctionId(args[0].get_string(), args[1].get_string()));
+                    }
+                    return wasmtime::Result<std::monostate>(std::monostate{});
+                }
+            ).unwrap();
+            host_batch_instance.add_func(
+                "submit",
+                [this](wasmtime::Store::Context store_ctx,
+                const wasmtime::component::FuncType& func_type,
+                wasmtime::Span<wasmtime::component::Val> args,
+                wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                {
+                    WasmtimeMetrics::ScopedTimer host_timer(m_metrics, m_host_metric_ids.host_batch);
+                    if(args.size() < 1 || results.size() == 0 || args[0].is_list() == false)
+                    {
+                        return wasmtime::Result<std::monostate>(std::monostate{});
+                    }
+
+                    thread_local std::vector<std::uint64_t> commands;
+                    thread_local std::vector<std::uint64_t> output;
+                    const wasmtime::component::List& command_list = args[0].get_list();
+                    commands.clear();
+                    commands.reserve(command_list.size());
+                    for(const wasmtime::component::Val& value : command_list)
+                    {
+                        if(value.is_u64() == false)
+                        {
+                            return wasmtime::Error(wasmtime_error_new("host-batch commands must be a list<u64>"));
                         }
+                        commands.push_back(value.get_u64());
                     }
 
+                    // Executed count first, the guest reads its results after it
+                    output.clear();
+                    output.push_back(0);
+                    WasmtimeHostCallBatch::ReplayResult replay_result = m_host_call_batch.replay(store_ctx, commands, output);
+                    output[0] = replay_result.executed_count;
+
+                    // The command and output words reuse thread local buffers, but the returned list is handed to
+                    // wasmtime together with its values, so each submit still allocates one list of output.size() values
+                    std::vector<wasmtime::component::Val> output_values;
+                    output_values.reserve(output.size());
+                    for(std::uint64_t word : output)
+                    {
+                        output_values.emplace_back(word);
+                    }
+                    results[0] = wasmtime::component::Val(wasmtime::component::List(std::move(output_values)));
                     return wasmtime::Result<std::monostate>(std::monostate{});
                 }
             ).unwrap();
         }
     }
 
+    std::uint64_t WasmtimeEngine::getInterfaceHandle(wasmtime::Store::Context store_ctx, std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name)
+    {
+        // Repeat lookups from the same store are answered from its memo without touching ModuleManager
+        WasmtimeContext* wasmtime_context = std::any_cast<WasmtimeContext*>(store_ctx.get_data());
+        std::uint64_t instance_handle = 0;
+        if(wasmtime_context->m_interface_handle_cache.find(interface_id, interface_checksum, instance_name, instance_handle))
+        {
+            return instance_handle;
+        }
+
+        Core::Logger::trace("[Host] GetInstance called with interface_id {}, interface_checksum {}, interface_name {}", interface_id, interface_checksum, instance_name);
+
+        const Lib::WasmtimeLinker::InterfaceExportInfo* interface_export_info = m_interface_table.find(interface_id);
+        if(interface_export_info == nullptr)
+        {
+            Core::Logger::error("Interface ID {} not found in registered interface map", interface_id);
+            return 0;
+        }
+
+        // check the checksum
+        if(interface_export_info->m_interface_checksum != interface_checksum)
+        {
+            Core::Logger::error("Interface ID {} checksum mismatch: expected {}, got {}", 
+                interface_id,
+                interface_export_info->m_interface_checksum,
+                interface_checksum);
+            return 0;
+        }
+
+        // Call the interface create function callback to create the instance
+        Core::Logger::trace("Creating interface instance for ID {}", interface_id);
+
+        instance_handle = reinterpret_cast<uint64_t>(::Core::ModuleManager::getInterfaceRaw(
+            interface_export_info->m_interface_type_hash,
+            std::string(instance_name)
+        ));
+
+        if(instance_handle != 0)
+        {
+            wasmtime_context->m_interface_handle_cache.insert(interface_id, interface_checksum, instance_name, instance_handle);
+        }
+        return instance_handle;
+    }
+
     void WasmtimeEngine::initInterfaceLinkers(const std::filesystem::path& linker_lib_path)
     {
+        if(m_is_linker_frozen.load(std::memory_order_acquire))
+        {
+            Core::Logger::error("Interface linker {} loaded after the first instantiation, linkers must be loaded at startup", linker_lib_path);
+            return;
+        }
+
         // const char* version = wasmtime_version_str();
 
         // Load the dynamic library
@@ -191,123 +561,1118 @@ namespace Arieo
                 interface_export_info->m_interface_checksum,
                 interface_export_info->m_member_function_count);
 
+            WasmtimeMetrics::MetricId interface_metric_id = m_metrics != nullptr
+                ? m_metrics->registerMetric(std::format("host/{}", interface_export_info->m_interface_name), WasmtimeMetrics::Kind::Histogram)
+                : WasmtimeMetrics::INVALID_METRIC;
+
             // Register each function in the interface
             for(size_t k = 0; k < interface_export_info->m_member_function_count; ++k)
             {
                 Lib::WasmtimeLinker::InterfaceFunctionExportInfo& function_export_info = interface_export_info->m_member_function_array[k];
-                instance.add_func(
+                if(m_metrics != nullptr)
+                {
+                    // Only wrapped while metrics are enabled, otherwise the linker callback is registered as is
+                    auto host_callback = function_export_info.m_host_callback;
+                    instance.add_func(
+                        function_export_info.m_function_name,
+                        [host_callback, metrics = m_metrics, metric_id = interface_metric_id](wasmtime::Store::Context store_ctx,
+                        const wasmtime::component::FuncType& func_type,
+                        wasmtime::Span<wasmtime::component::Val> args,
+                        wasmtime::Span<wasmtime::component::Val> results) -> wasmtime::Result<std::monostate>
+                        {
+                            WasmtimeMetrics::ScopedTimer host_timer(metrics, metric_id);
+                            return host_callback(store_ctx, func_type, args, results);
+                        }
+                    ).unwrap();
+                }
+                else
+                {
+                    instance.add_func(
+                        function_export_info.m_function_name,
+                        function_export_info.m_host_callback
+                    ).unwrap();
+                }
+                m_host_call_batch.registerFunction(
+                    interface_export_info->m_interface_name,
                     function_export_info.m_function_name,
                     function_export_info.m_host_callback
-                ).unwrap();
+                );
             }
         }
+
+        // Linkers are only registered during startup, get-interface reads the flat table afterwards
+        m_interface_table.build(m_interface_export_map);
+
+        // Modules pre-linked before this point must resolve their imports again
+        m_linker_generation.fetch_add(1, std::memory_order_release);
     }
 
-    void WasmtimeEngine::shutdown()
+    void WasmtimeEngine::registerInterfaceExport(Lib::WasmtimeLinker::InterfaceExportInfo* interface_export_info)
     {
-        if(m_linker != nullptr)
+        m_interface_export_map.emplace(interface_export_info->m_interaface_id, interface_export_info);
+        m_interface_table.build(m_interface_export_map);
+    }
+
+    WasmtimeEngineProfile WasmtimeEngine::parseEngineProfile(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   profile: debug | release | size
+        //   profile_overrides:
+        //     opt_level: none | speed | speed_and_size
+        //     debug_info / native_unwind_info / parallel_compilation / simd / relaxed_simd / consume_fuel: <bool>
+        //     memory_reservation / memory_guard_size / memory_reservation_for_growth: <bytes>
+        WasmtimeEngineProfile profile = WasmtimeEngineConfig::getProfile(WasmtimeEngineConfig::DEFAULT_PROFILE).value();
+        if(system_node["script_engine"].IsDefined() == false)
         {
-            Base::deleteT(m_linker);
-            m_linker = nullptr;
+            return profile;
         }
 
-        if (m_engine != nullptr)
+        Core::ConfigNode engine_node = system_node["script_engine"];
+        if(engine_node["profile"].IsDefined())
         {
-            Base::deleteT(m_engine);
-            m_engine = nullptr;
-            Core::Logger::info("Wasmtime scripting engine shut down");
+            std::string profile_name = engine_node["profile"].as<std::string>();
+            std::optional<WasmtimeEngineProfile> named_profile = WasmtimeEngineConfig::getProfile(profile_name);
+            if(named_profile.has_value())
+            {
+                profile = named_profile.value();
+            }
+            else
+            {
+                Core::Logger::error("Unknown engine profile '{}', falling back to '{}'", profile_name, profile.name);
+            }
         }
-    }
-
-    Base::Interop::RawRef<Interface::Script::IContext> WasmtimeEngine::createContext()
-    {
-        Core::Logger::info("Creating Wasmtime script context");
-        return Base::newT<WasmtimeContext>(*m_engine);
-    }
 
-    void WasmtimeEngine::destroyContext(Base::Interop::RawRef<Interface::Script::IContext> context)
-    {
-        WasmtimeContext* wasmtime_context = context.castToInstance<WasmtimeContext>();
-        Base::deleteT(wasmtime_context);
-        Core::Logger::info("Destroying Wasmtime script context");
-    }
+        if(engine_node["profile_overrides"].IsDefined())
+        {
+            Core::ConfigNode overrides_node = engine_node["profile_overrides"];
+            if(overrides_node["opt_level"].IsDefined())
+            {
+                std::string opt_level_name = overrides_node["opt_level"].as<std::string>();
+                std::optional<wasmtime::OptLevel> opt_level = WasmtimeEngineConfig::parseOptLevel(opt_level_name);
+                if(opt_level.has_value())
+                {
+                    profile.opt_level = opt_level.value();
+                }
+                else
+                {
+                    Core::Logger::error("Unknown opt_level '{}' in 'script_engine.profile_overrides'", opt_level_name);
+                }
+            }
 
-    Base::Interop::RawRef<Interface::Script::IModule> WasmtimeEngine::loadModuleFromWatString(const std::string& wat_string)
-    {   
-        return nullptr;
+            auto override_value = [&overrides_node]<typename T>(const char* key, T& value)
+            {
+                if(overrides_node[key].IsDefined())
+                {
+                    value = overrides_node[key].as<T>();
+                }
+            };
+            override_value("debug_info", profile.debug_info);
+            override_value("native_unwind_info", profile.native_unwind_info);
+            override_value("parallel_compilation", profile.parallel_compilation);
+            override_value("simd", profile.simd);
+            override_value("relaxed_simd", profile.relaxed_simd);
+            override_value("epoch_interruption", profile.epoch_interruption);
+            override_value("consume_fuel", profile.consume_fuel);
+            override_value("memory_reservation", profile.memory_reservation);
+            override_value("memory_guard_size", profile.memory_guard_size);
+            override_value("memory_reservation_for_growth", profile.memory_reservation_for_growth);
+        }
+        return profile;
     }
 
-    Base::Interop::RawRef<Interface::Script::IModule> WasmtimeEngine::loadModuleFromCompiledBinary(void* binary_data, size_t data_size)
+    std::optional<WasmtimeEngine::TickBudget> WasmtimeEngine::parseTickBudget(const Core::ConfigNode& system_node)
     {
-        if (!binary_data || data_size == 0)
+        // script_engine:
+        //   tick_budget:
+        //     budget_us: <guest time allowed per frame>
+        //     epoch_period_us: <interrupt resolution, defaults to a tenth of the budget>
+        //     entry_budget_us: <guest time allowed to the wasi:cli/run entry, unbounded unless set>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["tick_budget"].IsDefined() == false)
         {
-            Core::Logger::error("Invalid binary data or size for WASM module");
-            return nullptr;
+            return std::nullopt;
         }
-        
-        wasmtime::Result<wasmtime::component::Component> compile_result = wasmtime::component::Component::compile(
-            *m_engine,
-            wasmtime::Span<uint8_t>(static_cast<uint8_t*>(binary_data), data_size)
-        ).unwrap();
 
-        if(!compile_result)
+        Core::ConfigNode budget_node = system_node["script_engine"]["tick_budget"];
+        if(budget_node["budget_us"].IsDefined() == false)
         {
-            Core::Logger::error("Failed to compile WASM module from binary data: " + compile_result.err().message());
-            return nullptr;
+            Core::Logger::error("'script_engine.tick_budget.budget_us' is required to enable per-tick script budgets");
+            return std::nullopt;
         }
-        return Base::newT<WasmtimeModule>(compile_result.unwrap());
-    }
 
-    void WasmtimeEngine::unloadModule(Base::Interop::RawRef<Interface::Script::IModule> module)
-    {
-        Core::Logger::info("Unloading Wasmtime script module");
-        WasmtimeModule* wasmtime_module = module.castToInstance<WasmtimeModule>();
-        Base::deleteT(wasmtime_module);
+        TickBudget tick_budget;
+        tick_budget.frame_budget = std::chrono::microseconds(budget_node["budget_us"].as<std::int64_t>());
+        tick_budget.epoch_period = budget_node["epoch_period_us"].IsDefined()
+            ? std::chrono::microseconds(budget_node["epoch_period_us"].as<std::int64_t>())
+            : tick_budget.frame_budget / 10;
+        tick_budget.epoch_period = std::max(tick_budget.epoch_period, std::chrono::microseconds(10));
+        if(budget_node["entry_budget_us"].IsDefined())
+        {
+            tick_budget.entry_budget = std::chrono::microseconds(budget_node["entry_budget_us"].as<std::int64_t>());
+        }
+
+        Core::Logger::info("Script tick budget {} us, entry budget {}, epoch period {} us",
+            tick_budget.frame_budget.count(),
+            tick_budget.entry_budget.has_value() ? std::format("{} us", tick_budget.entry_budget->count()) : std::string("unbounded"),
+            tick_budget.epoch_period.count());
+        return tick_budget;
     }
 
-    Base::Interop::RawRef<Interface::Script::IInstance> WasmtimeEngine::createInstance(Base::Interop::RawRef<Interface::Script::IContext> context, Base::Interop::RawRef<Interface::Script::IModule> module)
+    void WasmtimeEngine::parseContextLimits(const Core::ConfigNode& system_node)
     {
-        Core::Logger::info("Creating Wasmtime script instance");
-        WasmtimeContext* wasmtime_context = context.castToInstance<WasmtimeContext>();
-        WasmtimeModule* wasmtime_module = module.castToInstance<WasmtimeModule>();
-
-        // Instantiate the component and verify it exports the guest interface
-        wasmtime::component::Instance instance = m_linker->instantiate(wasmtime_context->m_store.context(), wasmtime_module->m_component).unwrap();
-
-        // Create the instance wrapper
-        WasmtimeInstance* wasmtime_instance = Base::newT<WasmtimeInstance>(std::move(instance), wasmtime_context->m_store);
-
-        // Query the guest interface and function index from the instance wrapper
-        void* iface = wasmtime_instance->queryInterface("arieo:application/guest");
-        if (iface == nullptr)
+        // script_engine:
+        //   context_limits:
+        //     max_memory_mb: <linear memory of all instances in one context>
+        //     max_table_elements: <elements per table>
+        //     max_instances: <core instances per context>
+        //     fuel: <fuel granted once to each context, enables consume_fuel, see script_engine.fuel for metering>
+        //     memory_accounting: <track current and peak memory per context, implied by max_memory_mb.
+        //                         Replaces copy-on-write memory initialization with copying the data segments>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["context_limits"].IsDefined() == false)
         {
-            Core::Logger::error("Failed to query interface 'arieo:application/guest' on instance");
-            Base::deleteT(wasmtime_instance);
-            return nullptr;
+            return;
         }
 
-        void* func = wasmtime_instance->queryFunction(iface, "greeting");
-        if (func == nullptr)
+        Core::ConfigNode limits_node = system_node["script_engine"]["context_limits"];
+        if(limits_node["max_memory_mb"].IsDefined())
         {
-            Core::Logger::error("Failed to query function 'greeting' on interface 'arieo:greeter/guest'");
-            Base::deleteT(wasmtime_instance);
-            return nullptr;
+            m_context_limits.max_memory_bytes = limits_node["max_memory_mb"].as<std::uint64_t>() * 1024 * 1024;
+            m_is_memory_accounting = true;
+        }
+        if(limits_node["max_table_elements"].IsDefined())
+        {
+            m_context_limits.max_table_elements = limits_node["max_table_elements"].as<std::uint64_t>();
+        }
+        if(limits_node["max_instances"].IsDefined())
+        {
+            m_context_limits.max_instances = limits_node["max_instances"].as<std::uint64_t>();
+        }
+        if(limits_node["fuel"].IsDefined())
+        {
+            m_context_limits.fuel = limits_node["fuel"].as<std::uint64_t>();
+        }
+        if(limits_node["memory_accounting"].IsDefined())
+        {
+            m_is_memory_accounting = m_is_memory_accounting || limits_node["memory_accounting"].as<bool>();
         }
 
-        // Call the greeting function (no arguments, one result)
-        Core::Logger::info("Calling function 'greeting' on interface 'arieo:greeter/guest'");
-        wasmtime_instance->callFunction(func);
-        Core::Logger::info("Called function 'greeting' on interface 'arieo:greeter/guest'");
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(100000)); // Give some time for async logging to complete
+        Core::Logger::info("Script context limits: max_memory={} max_table_elements={} max_instances={} fuel={} memory_accounting={}",
+            m_context_limits.max_memory_bytes,
+            m_context_limits.max_table_elements,
+            m_context_limits.max_instances,
+            m_context_limits.fuel,
+            m_is_memory_accounting);
+    }
 
-        return wasmtime_instance;
+    WasmtimeFuelConfig WasmtimeEngine::parseFuelConfig(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   fuel:
+        //     allowance: <fuel a guest may burn before on_exhausted applies, 0 or unset only measures>
+        //     refill: call | tick
+        //     on_exhausted: trap | yield
+        //     yield_check_us: <how often yielding async calls check their fuel, unless a tick budget or guest profiler sets the epoch>
+        WasmtimeFuelConfig fuel_config;
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["fuel"].IsDefined() == false)
+        {
+            return fuel_config;
+        }
+
+        Core::ConfigNode fuel_node = system_node["script_engine"]["fuel"];
+        fuel_config.is_enabled = true;
+        if(fuel_node["allowance"].IsDefined())
+        {
+            fuel_config.allowance = fuel_node["allowance"].as<std::uint64_t>();
+        }
+        if(fuel_node["refill"].IsDefined())
+        {
+            std::string refill = fuel_node["refill"].as<std::string>();
+            if(refill == "tick")
+            {
+                fuel_config.refill = WasmtimeFuelConfig::Refill::PerTick;
+            }
+            else if(refill != "call")
+            {
+                Core::Logger::error("Unknown script_engine.fuel.refill '{}', refilling per call", refill);
+            }
+        }
+        if(fuel_node["on_exhausted"].IsDefined())
+        {
+            std::string on_exhausted = fuel_node["on_exhausted"].as<std::string>();
+            if(on_exhausted == "yield")
+            {
+                fuel_config.on_exhausted = WasmtimeFuelConfig::OnExhausted::Yield;
+            }
+            else if(on_exhausted != "trap")
+            {
+                Core::Logger::error("Unknown script_engine.fuel.on_exhausted '{}', trapping", on_exhausted);
+            }
+        }
+        if(fuel_node["yield_check_us"].IsDefined())
+        {
+            fuel_config.yield_check_interval = std::max(std::chrono::microseconds(10), std::chrono::microseconds(fuel_node["yield_check_us"].as<std::int64_t>()));
+        }
+
+        if(m_context_limits.fuel != 0)
+        {
+            Core::Logger::error("script_engine.context_limits.fuel is ignored while script_engine.fuel meters guest calls");
+        }
+        Core::Logger::info("Script fuel metering: allowance={} refill={} on_exhausted={}",
+            fuel_config.allowance,
+            fuel_config.refill == WasmtimeFuelConfig::Refill::PerTick ? "tick" : "call",
+            fuel_config.on_exhausted == WasmtimeFuelConfig::OnExhausted::Yield ? "yield" : "trap");
+        return fuel_config;
+    }
+
+    void WasmtimeEngine::initMetrics(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   metrics:
+        //     enabled: <bool>
+        //     dump_interval_frames: <frames between metric dumps from ScriptManager, 0 never dumps>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["metrics"].IsDefined() == false)
+        {
+            return;
+        }
+
+        Core::ConfigNode metrics_node = system_node["script_engine"]["metrics"];
+        if(metrics_node["enabled"].IsDefined() == false || metrics_node["enabled"].as<bool>() == false)
+        {
+            return;
+        }
+        if(metrics_node["dump_interval_frames"].IsDefined())
+        {
+            m_metrics_dump_interval_frames = metrics_node["dump_interval_frames"].as<size_t>();
+        }
+
+        m_metrics = Base::newT<WasmtimeMetrics>();
+        m_host_metric_ids.host = m_metrics->registerMetric("host/arieo:application/host", WasmtimeMetrics::Kind::Histogram);
+        m_host_metric_ids.module_manager = m_metrics->registerMetric("host/arieo:module/module-manager", WasmtimeMetrics::Kind::Histogram);
+        m_host_metric_ids.host_batch = m_metrics->registerMetric("host/arieo:application/host-batch", WasmtimeMetrics::Kind::Histogram);
+        Core::Logger::info("Script engine metrics enabled, dumped every {} frames", m_metrics_dump_interval_frames);
+    }
+
+    WasmtimeGuestLogConfig WasmtimeEngine::parseGuestLogConfig(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   guest_log:
+        //     enabled: <bool>
+        //     ring_capacity: <records buffered per context>
+        //     overflow: drop | block
+        //     max_block_us: <longest a guest waits for ring space with the block policy>
+        //     rate_limit: <messages per second per context, 0 is unlimited>
+        //     rate_burst: <messages allowed above the rate at once, defaults to rate_limit>
+        //     drain_interval_ms: <period of the drain thread>
+        //     capture_stdio: <bool, default false. Forwards WASI stdout/stderr through the pipeline by way of
+        //                     per-context files, each guest print stays a blocking file write and the files are
+        //                     never truncated while the context lives>
+        //     capture_dir: <directory of the per-context stdio capture files>
+        WasmtimeGuestLogConfig guest_log_config;
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["guest_log"].IsDefined() == false)
+        {
+            return guest_log_config;
+        }
+
+        Core::ConfigNode guest_log_node = system_node["script_engine"]["guest_log"];
+        guest_log_config.is_enabled = guest_log_node["enabled"].IsDefined() && guest_log_node["enabled"].as<bool>();
+        if(guest_log_node["ring_capacity"].IsDefined())
+        {
+            guest_log_config.ring_capacity = guest_log_node["ring_capacity"].as<size_t>();
+        }
+        if(guest_log_node["overflow"].IsDefined())
+        {
+            std::string overflow = guest_log_node["overflow"].as<std::string>();
+            if(overflow == "block")
+            {
+                guest_log_config.overflow_policy = WasmtimeGuestLogConfig::OverflowPolicy::Block;
+            }
+            else if(overflow != "drop")
+            {
+                Core::Logger::error("Unknown overflow policy '{}' in 'script_engine.guest_log', dropping instead", overflow);
+            }
+        }
+        if(guest_log_node["max_block_us"].IsDefined())
+        {
+            guest_log_config.max_block_time = std::chrono::microseconds(guest_log_node["max_block_us"].as<std::int64_t>());
+        }
+        if(guest_log_node["rate_limit"].IsDefined())
+        {
+            guest_log_config.rate_limit = guest_log_node["rate_limit"].as<std::uint32_t>();
+        }
+        if(guest_log_node["rate_burst"].IsDefined())
+        {
+            guest_log_config.rate_burst = guest_log_node["rate_burst"].as<std::uint32_t>();
+        }
+        if(guest_log_node["drain_interval_ms"].IsDefined())
+        {
+            guest_log_config.drain_interval = std::max(std::chrono::milliseconds(1), std::chrono::milliseconds(guest_log_node["drain_interval_ms"].as<std::int64_t>()));
+        }
+        if(guest_log_node["capture_stdio"].IsDefined())
+        {
+            guest_log_config.is_capturing_stdio = guest_log_node["capture_stdio"].as<bool>();
+        }
+        if(guest_log_node["capture_dir"].IsDefined())
+        {
+            guest_log_config.capture_dir = Core::SystemUtility::FileSystem::getFormalizedPath(guest_log_node["capture_dir"].as<std::string>());
+        }
+        return guest_log_config;
+    }
+
+    void WasmtimeEngine::initArchiveFilesystem(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   filesystem:
+        //     mode: archive | preopen
+        //     archive_root: <archive directory guest paths resolve under, archive mode>
+        //     host_dir: <directory holding the archive already unpacked, preopen mode. Nothing in the
+        //                engine unpacks it, the build or installer has to stage it on disk>
+        //     guest_path: <where guests see host_dir, preopen mode>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["filesystem"].IsDefined() == false)
+        {
+            return;
+        }
+
+        Core::ConfigNode filesystem_node = system_node["script_engine"]["filesystem"];
+        WasmtimeArchiveFilesystem::Config filesystem_config;
+        std::string mode = filesystem_node["mode"].IsDefined() ? filesystem_node["mode"].as<std::string>() : std::string("archive");
+        if(mode == "preopen")
+        {
+            filesystem_config.mode = WasmtimeArchiveFilesystem::Mode::Preopen;
+        }
+        else if(mode != "archive")
+        {
+            Core::Logger::error("Unknown filesystem mode '{}' in 'script_engine.filesystem', guests get no archive access", mode);
+            return;
+        }
+        if(filesystem_node["archive_root"].IsDefined())
+        {
+            filesystem_config.archive_root = filesystem_node["archive_root"].as<std::string>();
+        }
+        if(filesystem_node["host_dir"].IsDefined())
+        {
+            filesystem_config.host_dir = Core::SystemUtility::FileSystem::getFormalizedPath(filesystem_node["host_dir"].as<std::string>());
+        }
+        if(filesystem_node["guest_path"].IsDefined())
+        {
+            filesystem_config.guest_path = filesystem_node["guest_path"].as<std::string>();
+        }
+
+        if(filesystem_config.mode == WasmtimeArchiveFilesystem::Mode::Preopen && filesystem_config.host_dir.empty())
+        {
+            Core::Logger::error("'script_engine.filesystem' preopen mode needs host_dir, guests get no archive access");
+            return;
+        }
+
+        m_archive_filesystem = std::shared_ptr<WasmtimeArchiveFilesystem>(
+            Base::newT<WasmtimeArchiveFilesystem>(filesystem_config),
+            [](WasmtimeArchiveFilesystem* archive_filesystem) { Base::deleteT(archive_filesystem); }
+        );
+        if(filesystem_config.mode == WasmtimeArchiveFilesystem::Mode::Preopen)
+        {
+            Core::Logger::info("Guests see {} read-only at {}", filesystem_config.host_dir.string(), filesystem_config.guest_path);
+        }
+        else
+        {
+            Core::Logger::info("Guests read archive entries under '{}' through arieo:application/archive-fs", filesystem_config.archive_root);
+        }
+    }
+
+    void WasmtimeEngine::recordLoadTime(WasmtimeMetrics::MetricId metric_id, std::chrono::steady_clock::time_point start_time)
+    {
+        if(m_metrics != nullptr)
+        {
+            m_metrics->record(metric_id, std::chrono::steady_clock::now() - start_time);
+        }
+    }
+
+    std::vector<WasmtimeMetrics::Snapshot> WasmtimeEngine::collectMetrics()
+    {
+        if(m_metrics == nullptr)
+        {
+            return {};
+        }
+
+        // Store memory is a gauge summed over live contexts when collected, not tracked on the allocation path
+        std::uint64_t store_memory_bytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_live_context_mutex);
+            for(WasmtimeContext* wasmtime_context : m_live_contexts)
+            {
+                store_memory_bytes += wasmtime_context->getMemoryStatistics().current_bytes;
+            }
+        }
+        m_metrics->setGauge(WasmtimeMetrics::STORE_MEMORY_BYTES, store_memory_bytes);
+        return m_metrics->collect();
+    }
+
+    WasmtimeEngine::ProfilingConfig WasmtimeEngine::parseProfilingConfig(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   profiling:
+        //     mode: none | perfmap | jitdump | vtune | guest (samples per context, frames of components stay unnamed)
+        //     guest_interval_us: <sampling interval, the tick budget epoch period wins when both are set>
+        //     output_dir: <directory guest profiles are written to>
+        ProfilingConfig profiling_config;
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["profiling"].IsDefined() == false)
+        {
+            return profiling_config;
+        }
+
+        Core::ConfigNode profiling_node = system_node["script_engine"]["profiling"];
+        std::string mode = profiling_node["mode"].IsDefined() ? profiling_node["mode"].as<std::string>() : std::string("none");
+        if(mode == "perfmap")
+        {
+            profiling_config.mode = ProfilingMode::PerfMap;
+        }
+        else if(mode == "jitdump")
+        {
+            profiling_config.mode = ProfilingMode::JitDump;
+        }
+        else if(mode == "vtune")
+        {
+            profiling_config.mode = ProfilingMode::VTune;
+        }
+        else if(mode == "guest")
+        {
+            profiling_config.mode = ProfilingMode::Guest;
+            Core::Logger::info("Guest profiles record sample timing only, component frames cannot be symbolized. Use perf with the perf map or the jitdump mode to name hot guest functions");
+        }
+        else if(mode != "none")
+        {
+            Core::Logger::error("Unknown profiling mode '{}' in 'script_engine.profiling', profiling disabled", mode);
+        }
+
+        if(profiling_node["guest_interval_us"].IsDefined())
+        {
+            profiling_config.guest_interval = std::max(std::chrono::microseconds(10), std::chrono::microseconds(profiling_node["guest_interval_us"].as<std::int64_t>()));
+        }
+        if(profiling_node["output_dir"].IsDefined())
+        {
+            profiling_config.output_dir = profiling_node["output_dir"].as<std::string>();
+        }
+
+        if(profiling_config.mode != ProfilingMode::None)
+        {
+            Core::Logger::info("Script profiling mode '{}'{}", mode,
+                profiling_config.mode == ProfilingMode::Guest ? ", guest profiles are written to " + profiling_config.output_dir.string() : std::string());
+        }
+        return profiling_config;
+    }
+
+    template<typename CallFn>
+    WasmtimeEngine::BudgetedCallResult WasmtimeEngine::runBudgetedCall(WasmtimeContext* wasmtime_context, WasmtimeInstance* wasmtime_instance, void* function,
+        std::chrono::microseconds budget, CallFn&& call)
+    {
+        if(wasmtime_context->isEnterable() == false)
+        {
+            Core::Logger::error("Script context is busy with a suspended async call, budgeted call rejected");
+            BudgetedCallResult result;
+            result.is_rejected = true;
+            return result;
+        }
+
+        bool is_bounded = m_tick_budget.has_value() && budget != std::chrono::microseconds::max();
+        if(is_bounded)
+        {
+            // Round up so a budget smaller than one epoch period still lets the guest run
+            std::int64_t epoch_period = m_tick_budget->epoch_period.count();
+            std::uint64_t deadline_ticks = std::max<std::int64_t>(1, budget.count() / epoch_period + (budget.count() % epoch_period != 0 ? 1 : 0));
+            wasmtime_context->setEpochBudget(deadline_ticks);
+        }
+
+        std::uint64_t deadline_miss_count = wasmtime_context->m_deadline_miss_count;
+        wasmtime_context->beginFuelMeter();
+        auto start_time = std::chrono::steady_clock::now();
+        auto call_result = call();
+        auto end_time = std::chrono::steady_clock::now();
+        WasmtimeContext::FuelMeterResult fuel_result = wasmtime_context->endFuelMeter(!call_result);
+        if(!call_result)
+        {
+            Core::Logger::error("Error calling budgeted function in WASM module: {}", call_result.err().message());
+        }
+
+        BudgetedCallResult result;
+        result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
+        result.is_deadline_missed = wasmtime_context->m_deadline_miss_count != deadline_miss_count;
+        if(fuel_result.is_metered)
+        {
+            result.fuel_consumed = fuel_result.fuel_consumed;
+            result.is_fuel_exhausted = fuel_result.is_exhausted;
+            wasmtime_instance->recordFuel(function, fuel_result.fuel_consumed, fuel_result.is_exhausted);
+        }
+
+        if(is_bounded)
+        {
+            // Calls outside of a tick budget must not inherit the remaining deadline
+            wasmtime_context->clearEpochBudget();
+        }
+        return result;
+    }
+
+    WasmtimeEngine::BudgetedCallResult WasmtimeEngine::callFunctionWithBudget(
+        Base::Interop::RawRef<Interface::Script::IContext> context,
+        Base::Interop::RawRef<Interface::Script::IInstance> instance,
+        void* function,
+        const WasmtimeTypedFunction<void()>& typed_function,
+        std::chrono::microseconds budget)
+    {
+        return runBudgetedCall(context.castToInstance<WasmtimeContext>(), instance.castToInstance<WasmtimeInstance>(), function, budget,
+            [&typed_function]() { return typed_function(); });
+    }
+
+    WasmtimeEngine::BudgetedCallResult WasmtimeEngine::callEntryWithBudget(
+        Base::Interop::RawRef<Interface::Script::IContext> context,
+        Base::Interop::RawRef<Interface::Script::IInstance> instance,
+        void* function,
+        std::chrono::microseconds budget)
+    {
+        WasmtimeInstance* wasmtime_instance = instance.castToInstance<WasmtimeInstance>();
+        return runBudgetedCall(context.castToInstance<WasmtimeContext>(), wasmtime_instance, function, budget,
+            [wasmtime_instance, function]() { return wasmtime_instance->invokeFunction(function); });
+    }
+
+    WasmtimeAsyncCall* WasmtimeEngine::callFunctionAsync(Base::Interop::RawRef<Interface::Script::IInstance> instance, void* function)
+    {
+        WasmtimeContext* wasmtime_context = instance.castToInstance<WasmtimeInstance>()->getContext();
+        WasmtimeAsyncCall* async_call = Base::newT<WasmtimeAsyncCall>(instance, wasmtime_context, function);
+        wasmtime_context->m_async_call_count++;
+        m_async_calls.emplace_back(async_call);
+        startAsyncCall(async_call);
+        return async_call;
+    }
+
+    void WasmtimeEngine::cancelAsyncCalls(WasmtimeContext* wasmtime_context, WasmtimeInstance* wasmtime_instance)
+    {
+        if(wasmtime_context->m_async_call_count == 0)
+        {
+            return;
+        }
+        std::vector<WasmtimeAsyncCall*> async_calls = m_async_calls;
+        for(WasmtimeAsyncCall* async_call : async_calls)
+        {
+            if(async_call->isDone() || async_call->m_context != wasmtime_context
+                || (wasmtime_instance != nullptr && async_call->m_instance.castToInstance<WasmtimeInstance>() != wasmtime_instance))
+            {
+                continue;
+            }
+            async_call->cancel();
+            onAsyncCallProgressed(async_call);
+        }
+    }
+
+    void WasmtimeEngine::destroyAsyncCall(WasmtimeAsyncCall* async_call)
+    {
+        if(async_call->isDone() == false)
+        {
+            // The guest is parked in the middle of a call, it has to unwind before its fiber can be reused
+            async_call->m_is_abandoned = true;
+            return;
+        }
+        std::erase(m_async_calls, async_call);
+        Base::deleteT(async_call);
+    }
+
+    void WasmtimeEngine::pumpAsyncCalls()
+    {
+        // Guests parked for fuel wait for this, per-tick allowances refill on their next call
+        m_fuel_tick.fetch_add(1, std::memory_order_relaxed);
+
+        // Iterate over a snapshot, resumed guests may start new async calls through host imports
+        std::vector<WasmtimeAsyncCall*> async_calls = m_async_calls;
+        for(WasmtimeAsyncCall* async_call : async_calls)
+        {
+            if(async_call->getState() == WasmtimeAsyncCall::State::Pending)
+            {
+                startAsyncCall(async_call);
+            }
+            else if(async_call->tryResume())
+            {
+                onAsyncCallProgressed(async_call);
+            }
+        }
+    }
+
+    void WasmtimeEngine::startAsyncCall(WasmtimeAsyncCall* async_call)
+    {
+        if(async_call->m_context->m_active_async_call != nullptr)
+        {
+            // One call per store at a time, this one starts once the parked call completes
+            Core::Logger::trace("Script context busy with another async call, async call stays pending");
+            return;
+        }
+
+        WasmtimeGuestFiber* fiber = nullptr;
+        if(m_idle_fibers.empty() == false)
+        {
+            fiber = m_idle_fibers.back();
+            m_idle_fibers.pop_back();
+        }
+        else if(m_fiber_count < m_max_fiber_count)
+        {
+            fiber = Base::newT<WasmtimeGuestFiber>();
+            m_fiber_count++;
+        }
+        else
+        {
+            // Every fiber is parked in a suspended guest, retry on the next pump
+            Core::Logger::trace("No free guest fiber, async call stays pending");
+            return;
+        }
+
+        async_call->m_context->m_active_async_call = async_call;
+        async_call->start(*fiber);
+        onAsyncCallProgressed(async_call);
+    }
+
+    void WasmtimeEngine::onAsyncCallProgressed(WasmtimeAsyncCall* async_call)
+    {
+        if(async_call->isDone() == false)
+        {
+            return;
+        }
+
+        WasmtimeContext* wasmtime_context = async_call->m_context;
+        wasmtime_context->m_async_call_count--;
+        if(wasmtime_context->m_active_async_call == async_call)
+        {
+            wasmtime_context->m_active_async_call = nullptr;
+        }
+        // Cancelled before it started, it never had a fiber
+        if(async_call->m_fiber != nullptr)
+        {
+            m_idle_fibers.emplace_back(async_call->m_fiber);
+            async_call->m_fiber = nullptr;
+        }
+        if(async_call->m_is_abandoned)
+        {
+            std::erase(m_async_calls, async_call);
+            Base::deleteT(async_call);
+        }
+    }
+
+    std::optional<WasmtimePoolingConfig> WasmtimeEngine::parsePoolingConfig(const Core::ConfigNode& system_node)
+    {
+        // script_engine:
+        //   pooling:
+        //     instance_slots: <component instances alive at once>
+        //     core_instances_per_slot / memories_per_slot / tables_per_slot: <per component limits>
+        //     stack_slots: <async fiber stacks>
+        //     max_memory_mb: <linear memory per instance>
+        //     table_elements: <elements per table>
+        //     max_unused_warm_slots: <slots kept warm for reuse>
+        //     memory_keep_resident_kb / table_keep_resident_kb: <bytes kept resident per freed slot>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["pooling"].IsDefined() == false)
+        {
+            return std::nullopt;
+        }
+
+        Core::ConfigNode pooling_node = system_node["script_engine"]["pooling"];
+        WasmtimePoolingConfig pooling_config;
+        auto read_value = [&pooling_node]<typename T>(const char* key, T& value, T scale = 1)
+        {
+            if(pooling_node[key].IsDefined())
+            {
+                value = pooling_node[key].as<T>() * scale;
+            }
+        };
+        read_value("instance_slots", pooling_config.instance_slots);
+        read_value("core_instances_per_slot", pooling_config.core_instances_per_slot);
+        read_value("memories_per_slot", pooling_config.memories_per_slot);
+        read_value("tables_per_slot", pooling_config.tables_per_slot);
+        read_value("stack_slots", pooling_config.stack_slots);
+        read_value("max_memory_mb", pooling_config.max_memory_size, std::uint64_t(1024 * 1024));
+        read_value("table_elements", pooling_config.table_elements);
+        read_value("max_unused_warm_slots", pooling_config.max_unused_warm_slots);
+        read_value("memory_keep_resident_kb", pooling_config.linear_memory_keep_resident, std::uint64_t(1024));
+        read_value("table_keep_resident_kb", pooling_config.table_keep_resident, std::uint64_t(1024));
+
+        if(pooling_config.instance_slots == 0)
+        {
+            Core::Logger::error("'script_engine.pooling.instance_slots' must be greater than zero, pooling allocator disabled");
+            return std::nullopt;
+        }
+        return pooling_config;
+    }
+
+    WasmtimeEngine::PoolingStatistics WasmtimeEngine::getPoolingStatistics() const
+    {
+        PoolingStatistics statistics;
+        statistics.is_enabled = m_pooling_config.has_value();
+        statistics.instance_slots = m_pooling_config.has_value() ? m_pooling_config->instance_slots : 0;
+        statistics.live_instance_count = m_live_instance_count;
+        statistics.peak_instance_count = m_peak_instance_count;
+        statistics.failed_instantiation_count = m_failed_instantiation_count;
+        return statistics;
+    }
+
+    void WasmtimeEngine::initComponentCache(const Core::ConfigNode& system_node, std::uint64_t config_fingerprint)
+    {
+        // script_engine:
+        //   cache:
+        //     path: <directory>
+        //     max_size_mb: <size cap, least recently used entries are evicted first>
+        if(system_node["script_engine"].IsDefined() == false || system_node["script_engine"]["cache"].IsDefined() == false)
+        {
+            Core::Logger::info("No component cache defined in manifest, components are compiled on every load");
+            return;
+        }
+
+        Core::ConfigNode cache_node = system_node["script_engine"]["cache"];
+        if(cache_node["path"].IsDefined() == false)
+        {
+            Core::Logger::error("'script_engine.cache.path' is required to enable the component cache");
+            return;
+        }
+
+        std::uint64_t max_size_mb = cache_node["max_size_mb"].IsDefined() ? cache_node["max_size_mb"].as<std::uint64_t>() : 512;
+        m_component_cache.initialize(
+            Core::SystemUtility::FileSystem::getFormalizedPath(cache_node["path"].as<std::string>()),
+            max_size_mb * 1024 * 1024,
+            config_fingerprint
+        );
+    }
+
+    void WasmtimeEngine::shutdown()
+    {
+        if(m_async_calls.empty() == false)
+        {
+            Core::Logger::error("{} async script calls still alive at shutdown, cancelling them", m_async_calls.size());
+        }
+        // Unwinds parked guests so their fibers are idle again, every fiber thread is then joined below
+        std::vector<WasmtimeAsyncCall*> async_calls = m_async_calls;
+        for(WasmtimeAsyncCall* async_call : async_calls)
+        {
+            if(async_call->isDone() == false)
+            {
+                async_call->cancel();
+                onAsyncCallProgressed(async_call);
+            }
+        }
+        if(m_idle_fibers.size() != m_fiber_count)
+        {
+            Core::Logger::error("{} guest fibers did not unwind at shutdown", m_fiber_count - m_idle_fibers.size());
+        }
+        for(WasmtimeGuestFiber* fiber : m_idle_fibers)
+        {
+            Base::deleteT(fiber);
+        }
+        m_idle_fibers.clear();
+
+        // Loads still queued write to the component cache, finish them before it shuts down
+        m_module_loader.stop();
+        m_epoch_ticker.stop();
+        m_component_cache.shutdown();
+        m_guest_log_pipeline.stop();
+
+        if(m_pooling_config.has_value())
+        {
+            PoolingStatistics statistics = getPoolingStatistics();
+            Core::Logger::info("Wasmtime pooling allocator shut down: peak {} of {} instance slots, {} failed instantiations",
+                statistics.peak_instance_count,
+                statistics.instance_slots,
+                statistics.failed_instantiation_count);
+        }
+
+        // Components must go before the engine that compiled them
+        size_t leaked_module_count = m_module_registry.clear();
+        if(leaked_module_count > 0)
+        {
+            Core::Logger::error("{} script modules were still loaded at shutdown", leaked_module_count);
+        }
+
+        if(m_linker != nullptr)
+        {
+            Base::deleteT(m_linker);
+            m_linker = nullptr;
+        }
+
+        if(m_metrics != nullptr)
+        {
+            Base::deleteT(m_metrics);
+            m_metrics = nullptr;
+        }
+
+        // Contexts still alive keep their own reference and release the filesystem when they go
+        m_archive_filesystem.reset();
+
+        if (m_engine != nullptr)
+        {
+            Base::deleteT(m_engine);
+            m_engine = nullptr;
+            Core::Logger::info("Wasmtime scripting engine shut down");
+        }
+    }
+
+    Base::Interop::RawRef<Interface::Script::IContext> WasmtimeEngine::createContext()
+    {
+        Core::Logger::info("Creating Wasmtime script context");
+        WasmtimeGuestProfiler* guest_profiler = nullptr;
+        if(m_profiling_config.mode == ProfilingMode::Guest)
+        {
+            std::uint64_t profile_index = m_profiled_context_count++;
+            std::chrono::microseconds interval = m_tick_budget.has_value() ? m_tick_budget->epoch_period : m_profiling_config.guest_interval;
+            guest_profiler = Base::newT<WasmtimeGuestProfiler>(
+                *m_engine,
+                std::format("script-context-{}", profile_index),
+                interval,
+                m_profiling_config.output_dir / std::format("script-context-{}.json", profile_index)
+            );
+        }
+        WasmtimeGuestLogStream* log_stream = m_guest_log_pipeline.openStream(std::format("script-context-{}", m_created_context_count++));
+        WasmtimeContext* wasmtime_context = Base::newT<WasmtimeContext>(*m_engine, m_profile.epoch_interruption, m_context_limits, guest_profiler, log_stream, m_archive_filesystem);
+        if(m_context_limits.fuel_metering.is_enabled)
+        {
+            wasmtime_context->m_fuel_tick = &m_fuel_tick;
+        }
+        if(m_metrics != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(m_live_context_mutex);
+            m_live_contexts.push_back(wasmtime_context);
+        }
+        return wasmtime_context;
+    }
+
+    void WasmtimeEngine::destroyContext(Base::Interop::RawRef<Interface::Script::IContext> context)
+    {
+        WasmtimeContext* wasmtime_context = context.castToInstance<WasmtimeContext>();
+        cancelAsyncCalls(wasmtime_context, nullptr);
+        if(wasmtime_context->m_async_call_count != 0)
+        {
+            // A fiber would still hold frames in the store, leaking the context is the only safe choice
+            Core::Logger::error("Script context still has {} async calls after cancelling them, not destroying it", wasmtime_context->m_async_call_count);
+            return;
+        }
+        // Instance slots belong to the store and are only returned to the pool when it is dropped
+        m_live_instance_count -= wasmtime_context->m_instance_count;
+        if(m_metrics != nullptr)
+        {
+            std::lock_guard<std::mutex> lock(m_live_context_mutex);
+            std::erase(m_live_contexts, wasmtime_context);
+        }
+        WasmtimeGuestLogStream* log_stream = wasmtime_context->getLogStream();
+        Base::deleteT(wasmtime_context);
+        // The store has released the capture files, what is left in the stream is flushed on the drain thread
+        m_guest_log_pipeline.closeStream(log_stream);
+        Core::Logger::info("Destroying Wasmtime script context");
+    }
+
+    Base::Interop::RawRef<Interface::Script::IModule> WasmtimeEngine::loadModuleFromWatString(const std::string& wat_string)
+    {   
+        return nullptr;
+    }
+
+    Base::Interop::RawRef<Interface::Script::IModule> WasmtimeEngine::loadModuleFromCompiledBinary(void* binary_data, size_t data_size)
+    {
+        if (!binary_data || data_size == 0)
+        {
+            Core::Logger::error("Invalid binary data or size for WASM module");
+            return nullptr;
+        }
+        
+        auto start_time = std::chrono::steady_clock::now();
+
+        // Contexts loading the same bytes share one compiled component. The digest also keys the component cache.
+        WasmtimeSha256::Digest content_digest = WasmtimeSha256::hashBytes(binary_data, data_size);
+        std::string registry_key = WasmtimeModuleRegistry::getBinaryKey(content_digest, data_size);
+        if(WasmtimeModule* registered_module = m_module_registry.acquire(registry_key))
+        {
+            Core::Logger::info("Reusing already loaded WASM component ({} bytes)", data_size);
+            return registered_module;
+        }
+
+        // Artifacts written by arieo_wasmtime_precompile skip compilation entirely
+        if(WasmtimeEngineConfig::isPrecompiledArtifact(binary_data, data_size))
+        {
+            wasmtime::Result<wasmtime::component::Component> deserialize_result = wasmtime::component::Component::deserialize(
+                *m_engine,
+                wasmtime::Span<uint8_t>(static_cast<uint8_t*>(binary_data), data_size)
+            );
+            if(!deserialize_result)
+            {
+                Core::Logger::error("Failed to deserialize precompiled WASM component, rebuild it with arieo_wasmtime_precompile: {}", deserialize_result.err().message());
+                return nullptr;
+            }
+            recordLoadTime(WasmtimeMetrics::DESERIALIZE_TIME, start_time);
+            Core::Logger::info("Deserialized precompiled WASM component in {} ms",
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+            return m_module_registry.add(registry_key, Base::newT<WasmtimeModule>(deserialize_result.unwrap()));
+        }
+
+        if(m_component_cache.isEnabled())
+        {
+            std::optional<wasmtime::component::Component> cached_component = m_component_cache.load(*m_engine, content_digest, data_size);
+            if(cached_component.has_value())
+            {
+                recordLoadTime(WasmtimeMetrics::DESERIALIZE_TIME, start_time);
+                Core::Logger::info("Loaded WASM component from cache in {} ms",
+                    std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+                return m_module_registry.add(registry_key, Base::newT<WasmtimeModule>(std::move(cached_component.value())));
+            }
+        }
+
+        wasmtime::Result<wasmtime::component::Component> compile_result = wasmtime::component::Component::compile(
+            *m_engine,
+            wasmtime::Span<uint8_t>(static_cast<uint8_t*>(binary_data), data_size)
+        );
+
+        if(!compile_result)
+        {
+            Core::Logger::error("Failed to compile WASM module from binary data: " + compile_result.err().message());
+            return nullptr;
+        }
+
+        wasmtime::component::Component component = compile_result.unwrap();
+        recordLoadTime(WasmtimeMetrics::COMPILE_TIME, start_time);
+        Core::Logger::info("Compiled WASM component in {} ms",
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+
+        m_component_cache.store(component, content_digest, data_size);
+        return m_module_registry.add(registry_key, Base::newT<WasmtimeModule>(std::move(component)));
+    }
+
+    Base::Interop::RawRef<Interface::Script::IModule> WasmtimeEngine::loadModuleFromPrecompiledFile(const std::filesystem::path& file_path)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+
+        std::error_code ec;
+        std::filesystem::path absolute_path = std::filesystem::absolute(file_path, ec);
+        std::int64_t write_time = static_cast<std::int64_t>(std::filesystem::last_write_time(file_path, ec).time_since_epoch().count());
+        std::string registry_key = WasmtimeModuleRegistry::getFileKey((absolute_path.empty() ? file_path : absolute_path).string(), write_time);
+        if(WasmtimeModule* registered_module = m_module_registry.acquire(registry_key))
+        {
+            Core::Logger::info("Reusing already mapped WASM component {}", file_path.string());
+            return registered_module;
+        }
+
+        // deserialize_file maps the artifact directly, the code is never staged through a heap buffer
+        wasmtime::Result<wasmtime::component::Component> deserialize_result = wasmtime::component::Component::deserialize_file(
+            *m_engine,
+            file_path.string()
+        );
+        if(!deserialize_result)
+        {
+            Core::Logger::error("Failed to map precompiled WASM component {}, rebuild it with arieo_wasmtime_precompile: {}", file_path.string(), deserialize_result.err().message());
+            return nullptr;
+        }
+
+        recordLoadTime(WasmtimeMetrics::DESERIALIZE_TIME, start_time);
+        Core::Logger::info("Mapped precompiled WASM component {} in {} ms",
+            file_path.string(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count());
+        return m_module_registry.add(registry_key, Base::newT<WasmtimeModule>(deserialize_result.unwrap()));
+    }
+
+    WasmtimeEngine::ModuleFuture WasmtimeEngine::loadModuleFromCompiledBinaryAsync(const void* binary_data, size_t data_size)
+    {
+        std::vector<std::uint8_t> binary_copy;
+        if(binary_data != nullptr)
+        {
+            binary_copy.assign(static_cast<const std::uint8_t*>(binary_data), static_cast<const std::uint8_t*>(binary_data) + data_size);
+        }
+        return m_module_loader.submit([this, binary = std::move(binary_copy)]() mutable
+        {
+            return loadModuleFromCompiledBinary(binary.data(), binary.size());
+        });
+    }
+
+    WasmtimeEngine::ModuleFuture WasmtimeEngine::loadModuleFromPrecompiledFileAsync(const std::filesystem::path& file_path)
+    {
+        return m_module_loader.submit([this, file_path]()
+        {
+            return loadModuleFromPrecompiledFile(file_path);
+        });
+    }
+
+    void WasmtimeEngine::unloadModule(Base::Interop::RawRef<Interface::Script::IModule> module)
+    {
+        // Only the last reference frees the compiled component, other contexts may still run it
+        WasmtimeModule* wasmtime_module = module.castToInstance<WasmtimeModule>();
+        if(m_module_registry.release(wasmtime_module))
+        {
+            Core::Logger::info("Unloading Wasmtime script module");
+        }
+    }
+
+    Base::Interop::RawRef<Interface::Script::IInstance> WasmtimeEngine::createInstance(Base::Interop::RawRef<Interface::Script::IContext> context, Base::Interop::RawRef<Interface::Script::IModule> module)
+    {
+        Core::Logger::info("Creating Wasmtime script instance");
+        WasmtimeContext* wasmtime_context = context.castToInstance<WasmtimeContext>();
+        WasmtimeModule* wasmtime_module = module.castToInstance<WasmtimeModule>();
+
+        // Batched host calls are typed from the imports of the components that make them
+        std::call_once(wasmtime_module->m_host_call_batch_once, [this, wasmtime_module]()
+        {
+            m_host_call_batch.registerSignatures(wasmtime_module->m_component, *m_engine);
+        });
+
+        m_is_linker_frozen.store(true, std::memory_order_release);
+        wasmtime::Result<WasmtimeModule::InstancePre> instance_pre_result = wasmtime_module->getInstancePre(
+            *m_linker, m_linker_generation.load(std::memory_order_acquire));
+        if(!instance_pre_result)
+        {
+            Core::Logger::error("Failed to resolve imports of WASM component: {}", instance_pre_result.err().message());
+            return nullptr;
+        }
+        // Kept until instantiation returns, even if another thread relinks the module meanwhile
+        WasmtimeModule::InstancePre instance_pre = instance_pre_result.unwrap();
+
+        // Imports are already resolved, this only allocates the instance state and runs its initializers.
+        // Memories created here are charged to the context, see WasmtimeMemoryAccounting
+        wasmtime_component_instance_t instance_capi;
+        wasmtime_error_t* error = nullptr;
+        {
+            WasmtimeMetrics::ScopedTimer instantiate_timer(m_metrics, WasmtimeMetrics::INSTANTIATE_TIME);
+            WasmtimeMemoryAccounting::Scope memory_scope(wasmtime_context->m_memory_account);
+            error = wasmtime_component_instance_pre_instantiate(
+                instance_pre.get(),
+                wasmtime_context->m_store.context().capi(),
+                &instance_capi
+            );
+        }
+        if(error != nullptr)
+        {
+            // With the pooling allocator this is also how an exhausted slot budget surfaces
+            m_failed_instantiation_count++;
+            Core::Logger::error("Failed to instantiate WASM component: {}", wasmtime::Error(error).message());
+            return nullptr;
+        }
+
+        wasmtime_context->m_instance_count++;
+        if(wasmtime_context->m_log_stream != nullptr)
+        {
+            // Later log calls of the context are attributed to the newest instance in it
+            wasmtime_context->m_log_stream->setInstanceId(++m_created_instance_count);
+        }
+        std::uint64_t live_instance_count = ++m_live_instance_count;
+        std::uint64_t peak_instance_count = m_peak_instance_count;
+        while(live_instance_count > peak_instance_count && m_peak_instance_count.compare_exchange_weak(peak_instance_count, live_instance_count) == false)
+        {
+        }
+
+        return Base::newT<WasmtimeInstance>(wasmtime::component::Instance(instance_capi), wasmtime_context->m_store, *wasmtime_module, m_metrics);
+    }
+
+    WasmtimeInstancePool* WasmtimeEngine::createInstancePool(Base::Interop::RawRef<Interface::Script::IModule> module, const WasmtimeInstancePool::Config& config)
+    {
+        Core::Logger::info("Creating Wasmtime instance pool (min idle {}, max idle {})", config.min_idle_count, config.max_idle_count);
+        return Base::newT<WasmtimeInstancePool>(*this, module, config);
+    }
+
+    void WasmtimeEngine::destroyInstancePool(WasmtimeInstancePool* instance_pool)
+    {
+        WasmtimeInstancePool::Statistics statistics = instance_pool->getStatistics();
+        Core::Logger::info("Destroying Wasmtime instance pool: {} acquires, {} served from idle, {} instantiated on demand",
+            statistics.acquire_count,
+            statistics.idle_hit_count,
+            statistics.on_demand_count);
+        Base::deleteT(instance_pool);
     }
 
     void WasmtimeEngine::destroyInstance(Base::Interop::RawRef<Interface::Script::IInstance> instance)
     {
         Core::Logger::info("Destroying Wasmtime script instance");
         WasmtimeInstance* wasmtime_instance = instance.castToInstance<WasmtimeInstance>();
+        // A guest parked in this instance is unwound before its instance goes away
+        cancelAsyncCalls(wasmtime_instance->getContext(), wasmtime_instance);
         Base::deleteT(wasmtime_instance);
     }
 }
@@ -2,13 +2,33 @@
 
 #include "base/prerequisites.h"
 #include "core/core.h"
+#include "core/config/config.h"
 #include <wasmtime.hh>
 #include <wasmtime/component.hh>
 #include <unordered_map>
 #include <memory>
+#include <atomic>
+#include <optional>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+#include <mutex>
 
 #include "interface/script/script.h"
 #include "lib/wasmtime_linker/interface_wasmtime_linker.h"
+#include "../cache/wasmtime_component_cache.h"
+#include "wasmtime_engine_config.h"
+#include "../pool/wasmtime_instance_pool.h"
+#include "wasmtime_epoch_ticker.h"
+#include "wasmtime_interface_table.h"
+#include "wasmtime_host_call_batch.h"
+#include "../async/wasmtime_async_call.h"
+#include "../context/wasmtime_context.h"
+#include "../instance/wasmtime_instance.h"
+#include "../metrics/wasmtime_metrics.h"
+#include "../logging/wasmtime_guest_log.h"
+#include "../module/wasmtime_module_loader.h"
+#include "../module/wasmtime_module_registry.h"
 namespace Arieo
 {
     /**
@@ -19,10 +39,15 @@ namespace Arieo
     {
     public:
         // IScriptEngine interface
-        void initialize();
+        void initialize(const Core::ConfigNode& system_node);
         void shutdown();
 
+        // Host callbacks of linker libraries may be invoked on any script worker, see WasmtimeScriptScheduler.
+        // Startup only: the linker is frozen by the first createInstance and later calls are refused.
         void initInterfaceLinkers(const std::filesystem::path& lib_file_path) override;
+        // Makes an interface known to get-interface without a linker library, for tools driving the engine headless.
+        // Startup only like initInterfaceLinkers, interface_export_info must outlive the engine.
+        void registerInterfaceExport(Lib::WasmtimeLinker::InterfaceExportInfo* interface_export_info);
 
         Base::Interop::RawRef<Interface::Script::IContext> createContext() override;
         void destroyContext(Base::Interop::RawRef<Interface::Script::IContext> context) override; 
@@ -31,17 +56,214 @@ namespace Arieo
         Base::Interop::RawRef<Interface::Script::IModule> loadModuleFromCompiledBinary(void* binary_data, size_t data_size) override;
         void unloadModule(Base::Interop::RawRef<Interface::Script::IModule> module) override;
 
+        // Maps an artifact written by arieo_wasmtime_precompile straight from disk without JIT
+        Base::Interop::RawRef<Interface::Script::IModule> loadModuleFromPrecompiledFile(const std::filesystem::path& file_path);
+
+        // Load variants running on the module loader workers. The binary is copied, so the caller may release it
+        // as soon as the call returns. Waiting on the future is only needed where the module is first used.
+        using ModuleFuture = WasmtimeModuleLoader::Future;
+        ModuleFuture loadModuleFromCompiledBinaryAsync(const void* binary_data, size_t data_size);
+        ModuleFuture loadModuleFromPrecompiledFileAsync(const std::filesystem::path& file_path);
+        // Runs job_function on a loader worker, inline while script_engine.load_workers is 0
+        template<typename JobFunction>
+        auto submitLoaderJob(JobFunction&& job_function)
+        {
+            return m_module_loader.submitJob(std::forward<JobFunction>(job_function));
+        }
+
         Base::Interop::RawRef<Interface::Script::IInstance> createInstance(Base::Interop::RawRef<Interface::Script::IContext> context, Base::Interop::RawRef<Interface::Script::IModule> module) override;
         void destroyInstance(Base::Interop::RawRef<Interface::Script::IInstance> instance) override;
 
+        enum class ProfilingMode
+        {
+            None,
+            // JIT code symbols for perf / VTune, set engine wide
+            PerfMap,
+            JitDump,
+            VTune,
+            // Sampling profile per context, written when the context is destroyed. Wasmtime names only frames
+            // of core modules registered with the profiler and the C API cannot reach the core modules inside
+            // a component, so component frames stay unnamed. On Linux the engine also writes a perf map,
+            // run perf alongside to get guest function names.
+            Guest,
+        };
+        struct ProfilingConfig
+        {
+            ProfilingMode mode = ProfilingMode::None;
+            std::chrono::microseconds guest_interval = std::chrono::microseconds(1000);
+            std::filesystem::path output_dir = "script_profiles";
+        };
+        const ProfilingConfig& getProfilingConfig() const { return m_profiling_config; }
+
+        // Null unless script_engine.metrics.enabled is set
+        WasmtimeMetrics* getMetrics() { return m_metrics; }
+        // Empty while metrics are disabled, also refreshes the store memory gauge
+        std::vector<WasmtimeMetrics::Snapshot> collectMetrics();
+        size_t getMetricsDumpIntervalFrames() const { return m_metrics_dump_interval_frames; }
+
+        // Disabled unless script_engine.guest_log.enabled is set, guests then log through the host directly
+        const WasmtimeGuestLogConfig& getGuestLogConfig() const { return m_guest_log_pipeline.getConfig(); }
+
+        struct TickBudget
+        {
+            std::chrono::microseconds frame_budget;
+            std::chrono::microseconds epoch_period;
+            // Allowed to the wasi:cli/run entry, which runs once before the first tick. Unset leaves it unbounded.
+            std::optional<std::chrono::microseconds> entry_budget;
+        };
+        // Set when script_engine.tick_budget is defined, epoch interruption is only enabled in that case
+        const std::optional<TickBudget>& getTickBudget() const { return m_tick_budget; }
+
+        struct BudgetedCallResult
+        {
+            std::chrono::nanoseconds elapsed = std::chrono::nanoseconds(0);
+            bool is_deadline_missed = false;
+            // Not called, the context was busy with a suspended async call
+            bool is_rejected = false;
+            // Only filled while fuel metering is enabled
+            std::uint64_t fuel_consumed = 0;
+            bool is_fuel_exhausted = false;
+        };
+        // Calls a func() export with an epoch deadline derived from budget. A guest running past it traps,
+        // which leaves the instance unusable, so callers must recreate it when is_deadline_missed or
+        // is_fuel_exhausted is set. typed_function is resolved from function once per instance by the
+        // caller, function itself only keys the fuel report.
+        BudgetedCallResult callFunctionWithBudget(
+            Base::Interop::RawRef<Interface::Script::IContext> context,
+            Base::Interop::RawRef<Interface::Script::IInstance> instance,
+            void* function,
+            const WasmtimeTypedFunction<void()>& typed_function,
+            std::chrono::microseconds budget);
+        // Same for an untyped export such as wasi:cli/run, a budget of microseconds::max() sets no deadline
+        BudgetedCallResult callEntryWithBudget(
+            Base::Interop::RawRef<Interface::Script::IContext> context,
+            Base::Interop::RawRef<Interface::Script::IInstance> instance,
+            void* function,
+            std::chrono::microseconds budget);
+
+        // Starts the call on a guest fiber and runs it until it completes or a host import suspends it.
+        // Async calls, pumpAsyncCalls and destroyAsyncCall must all be used from the tick thread, as must
+        // destroying instances and contexts that have async calls. Until the call completes its context
+        // is busy: further async calls on it stay pending and other calls into it are rejected.
+        // The guest's result stays readable on the handle until it is destroyed.
+        WasmtimeAsyncCall* callFunctionAsync(Base::Interop::RawRef<Interface::Script::IInstance> instance, void* function);
+        void destroyAsyncCall(WasmtimeAsyncCall* async_call);
+        // Resumes suspended calls whose awaited condition is ready and starts calls waiting for a fiber.
+        // Called once per tick, it also starts the next fuel tick (see WasmtimeFuelConfig::Refill::PerTick).
+        void pumpAsyncCalls();
+
+        // Set by script_engine.fuel, disabled by default
+        const WasmtimeFuelConfig& getFuelConfig() const { return m_context_limits.fuel_metering; }
+
+        // Pool of ready-to-call instances of one module, each with its own context
+        WasmtimeInstancePool* createInstancePool(Base::Interop::RawRef<Interface::Script::IModule> module, const WasmtimeInstancePool::Config& config);
+        void destroyInstancePool(WasmtimeInstancePool* instance_pool);
+
         // Get the wasmtime linker for interface registration
         void* getLinker() { return m_linker; }
 
+        // Modules shared between loads of the same content, see WasmtimeModuleRegistry
+        WasmtimeModuleRegistry::Statistics getModuleRegistryStatistics() const { return m_module_registry.getStatistics(); }
+
+        // Hit/miss counters of the compiled component cache
+        WasmtimeComponentCache::Statistics getComponentCacheStatistics() const { return m_component_cache.getStatistics(); }
+
+        const WasmtimeEngineProfile& getProfile() const { return m_profile; }
+        const WasmtimeContextLimits& getContextLimits() const { return m_context_limits; }
+        bool isMemoryAccountingEnabled() const { return m_is_memory_accounting; }
+
+        struct PoolingStatistics
+        {
+            bool is_enabled = false;
+            std::uint32_t instance_slots = 0;
+            std::uint64_t live_instance_count = 0;
+            std::uint64_t peak_instance_count = 0;
+            std::uint64_t failed_instantiation_count = 0;
+        };
+        // Occupancy of the pooling allocator, live instances are counted until their context is destroyed
+        PoolingStatistics getPoolingStatistics() const;
+
     private:
+        WasmtimeEngineProfile parseEngineProfile(const Core::ConfigNode& system_node);
+        std::optional<WasmtimePoolingConfig> parsePoolingConfig(const Core::ConfigNode& system_node);
+        std::optional<TickBudget> parseTickBudget(const Core::ConfigNode& system_node);
+        void parseContextLimits(const Core::ConfigNode& system_node);
+        WasmtimeFuelConfig parseFuelConfig(const Core::ConfigNode& system_node);
+        ProfilingConfig parseProfilingConfig(const Core::ConfigNode& system_node);
+        void initMetrics(const Core::ConfigNode& system_node);
+        WasmtimeGuestLogConfig parseGuestLogConfig(const Core::ConfigNode& system_node);
+        void initArchiveFilesystem(const Core::ConfigNode& system_node);
+        void recordLoadTime(WasmtimeMetrics::MetricId metric_id, std::chrono::steady_clock::time_point start_time);
+        // Brackets call with the epoch budget and fuel meter of the budgeted calls, only instantiated in wasmtime_engine.cpp
+        template<typename CallFn>
+        BudgetedCallResult runBudgetedCall(WasmtimeContext* wasmtime_context, WasmtimeInstance* wasmtime_instance, void* function,
+            std::chrono::microseconds budget, CallFn&& call);
+        // Backs arieo:module/module-manager.get-interface
+        std::uint64_t getInterfaceHandle(wasmtime::Store::Context store_ctx, std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name);
+        void startAsyncCall(WasmtimeAsyncCall* async_call);
+        // Unwinds suspended and drops pending async calls of the context, only those of wasmtime_instance unless it is null
+        void cancelAsyncCalls(WasmtimeContext* wasmtime_context, WasmtimeInstance* wasmtime_instance);
+        void onAsyncCallProgressed(WasmtimeAsyncCall* async_call);
+        void initComponentCache(const Core::ConfigNode& system_node, std::uint64_t config_fingerprint);
+
+        WasmtimeEngineProfile m_profile;
+        std::optional<WasmtimePoolingConfig> m_pooling_config;
+        std::optional<TickBudget> m_tick_budget;
+        WasmtimeContextLimits m_context_limits;
+        ProfilingConfig m_profiling_config;
+
+        WasmtimeMetrics* m_metrics = nullptr;
+        size_t m_metrics_dump_interval_frames = 0;
+        struct HostMetricIds
+        {
+            WasmtimeMetrics::MetricId host = WasmtimeMetrics::INVALID_METRIC;
+            WasmtimeMetrics::MetricId module_manager = WasmtimeMetrics::INVALID_METRIC;
+            WasmtimeMetrics::MetricId host_batch = WasmtimeMetrics::INVALID_METRIC;
+        };
+        HostMetricIds m_host_metric_ids;
+        // Tracked only while metrics are enabled, for the store memory gauge
+        std::mutex m_live_context_mutex;
+        std::vector<WasmtimeContext*> m_live_contexts;
+        std::atomic<std::uint64_t> m_profiled_context_count = 0;
+        WasmtimeGuestLogPipeline m_guest_log_pipeline;
+        // Null unless script_engine.filesystem is set, shared by every context
+        // Shared with every context, which may outlive shutdown and still close its open files
+        std::shared_ptr<WasmtimeArchiveFilesystem> m_archive_filesystem;
+        // Names the log stream of each context and tags guest log lines with the instance that wrote them
+        std::atomic<std::uint64_t> m_created_context_count = 0;
+        std::atomic<std::uint64_t> m_created_instance_count = 0;
+        // Guest linear memories are allocated by WasmtimeMemoryAccounting and charged to their context
+        bool m_is_memory_accounting = false;
+        WasmtimeEpochTicker m_epoch_ticker;
+        // Tick number metered contexts refill against, see WasmtimeContext::beginFuelMeter
+        std::atomic<std::uint64_t> m_fuel_tick = 0;
+
+        WasmtimeModuleLoader m_module_loader;
+
+        size_t m_max_fiber_count = 4;
+        size_t m_fiber_count = 0;
+        std::vector<WasmtimeGuestFiber*> m_idle_fibers;
+        std::vector<WasmtimeAsyncCall*> m_async_calls;
         wasmtime::Engine* m_engine = nullptr;
         wasmtime::component::Linker* m_linker = nullptr;
+        // Incremented with release order once definitions were added to m_linker, see WasmtimeModule::getInstancePre
+        std::atomic<std::uint64_t> m_linker_generation = 0;
+        // Set by the first createInstance, which may run on pool workers. The linker is not synchronized,
+        // so definitions are only added before any thread instantiates from it.
+        std::atomic<bool> m_is_linker_frozen = false;
 
         std::unordered_map<std::uint64_t, Lib::WasmtimeLinker::InterfaceExportInfo*> m_interface_export_map;
+        // Flat copy of m_interface_export_map used on the get-interface path
+        WasmtimeInterfaceTable m_interface_table;
+        // Every linked interface function, replayed by arieo:application/host-batch.submit
+        WasmtimeHostCallBatch m_host_call_batch;
+
+        WasmtimeComponentCache m_component_cache;
+        WasmtimeModuleRegistry m_module_registry;
+
+        std::atomic<std::uint64_t> m_live_instance_count = 0;
+        std::atomic<std::uint64_t> m_peak_instance_count = 0;
+        std::atomic<std::uint64_t> m_failed_instantiation_count = 0;
     };
 }
 
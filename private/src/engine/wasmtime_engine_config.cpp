@@ -0,0 +1,179 @@
+#include "wasmtime_engine_config.h"
+#include "../utility/wasmtime_hash.h"
+#include <cstring>
+#include <format>
+
+namespace Arieo
+{
+    namespace WasmtimeEngineConfig
+    {
+        namespace
+        {
+            std::string_view getOptLevelName(wasmtime::OptLevel opt_level)
+            {
+                switch(opt_level)
+                {
+                case wasmtime::OptLevel::None: return "none";
+                case wasmtime::OptLevel::Speed: return "speed";
+                case wasmtime::OptLevel::SpeedAndSize: return "speed_and_size";
+                }
+                return "unknown";
+            }
+        }
+
+        std::optional<WasmtimeEngineProfile> getProfile(std::string_view profile_name)
+        {
+            WasmtimeEngineProfile profile;
+            profile.name = profile_name;
+
+            if(profile_name == "debug")
+            {
+                // Unoptimized code with DWARF so guests can be stepped through in LLDB/GDB
+                profile.opt_level = wasmtime::OptLevel::None;
+                profile.debug_info = true;
+                profile.native_unwind_info = true;
+                return profile;
+            }
+
+            if(profile_name == "release")
+            {
+                profile.opt_level = wasmtime::OptLevel::Speed;
+                profile.debug_info = false;
+                // Still required for host backtraces through guest frames, and mandatory on Windows
+                profile.native_unwind_info = true;
+                profile.relaxed_simd = true;
+                return profile;
+            }
+
+            if(profile_name == "size")
+            {
+                // Smaller code and a small virtual reservation per linear memory, at the cost of explicit bounds checks
+                profile.opt_level = wasmtime::OptLevel::SpeedAndSize;
+                profile.debug_info = false;
+                profile.native_unwind_info = true;
+                profile.memory_reservation = 64ull * 1024 * 1024;
+                profile.memory_guard_size = 64ull * 1024;
+                profile.memory_reservation_for_growth = 1ull * 1024 * 1024;
+                return profile;
+            }
+
+            return std::nullopt;
+        }
+
+        std::vector<std::string_view> getProfileNames()
+        {
+            return {"debug", "release", "size"};
+        }
+
+        wasmtime::Config createConfig(const WasmtimeEngineProfile& profile, const std::optional<WasmtimePoolingConfig>& pooling_config)
+        {
+            // Create engine configuration
+            wasmtime::Config config;
+            config.debug_info(profile.debug_info); // Equivalent to: -D debug-info=y
+            config.cranelift_opt_level(profile.opt_level); // Equivalent to: -O opt-level=N
+            config.wasm_component_model(true); // Enable component model support
+
+            // Enable native unwinding for debugger integration
+            // On Windows, this enables debugging without needing Linux-specific profiling
+            config.native_unwind_info(profile.native_unwind_info); // Enables native debugger support (LLDB/GDB)
+
+            config.parallel_compilation(profile.parallel_compilation);
+            config.wasm_simd(profile.simd);
+            config.wasm_relaxed_simd(profile.relaxed_simd);
+            config.epoch_interruption(profile.epoch_interruption);
+            config.consume_fuel(profile.consume_fuel);
+
+            config.memory_reservation(profile.memory_reservation);
+            config.memory_guard_size(profile.memory_guard_size);
+            config.memory_reservation_for_growth(profile.memory_reservation_for_growth);
+
+            if(pooling_config.has_value())
+            {
+                wasmtime::PoolAllocationConfig pool;
+                pool.total_component_instances(pooling_config->instance_slots);
+                pool.total_core_instances(pooling_config->instance_slots * pooling_config->core_instances_per_slot);
+                pool.total_memories(pooling_config->instance_slots * pooling_config->memories_per_slot);
+                pool.total_tables(pooling_config->instance_slots * pooling_config->tables_per_slot);
+                pool.total_stacks(pooling_config->stack_slots);
+                pool.max_core_instances_per_component(pooling_config->core_instances_per_slot);
+                pool.max_memories_per_component(pooling_config->memories_per_slot);
+                pool.max_tables_per_component(pooling_config->tables_per_slot);
+                pool.max_memory_size(pooling_config->max_memory_size);
+                pool.table_elements(pooling_config->table_elements);
+                pool.max_unused_warm_slots(pooling_config->max_unused_warm_slots);
+                pool.linear_memory_keep_resident(pooling_config->linear_memory_keep_resident);
+                pool.table_keep_resident(pooling_config->table_keep_resident);
+                config.pooling_allocation_strategy(pool);
+
+                // Initialize linear memory from the module image with copy-on-write mappings instead of copying data segments.
+                // Without pooling this is wasmtime's default too, except when WasmtimeMemoryAccounting installs its host
+                // memory creator: wasmtime cannot map images into host created memories and copies the segments instead.
+                config.memory_init_cow(true);
+            }
+
+            // config.cranelift_debug_verifier(false); // Disable verifier that may interfere with debugging
+            // config.macos_use_mach_ports(false); // Use standard GDB JIT interface on all platforms
+            return config;
+        }
+
+        std::string describe(const WasmtimeEngineProfile& profile)
+        {
+            return std::format(
+                "opt_level={};debug_info={};native_unwind_info={};parallel_compilation={};simd={};relaxed_simd={};epoch_interruption={};consume_fuel={};"
+                "memory_reservation={};memory_guard_size={};memory_reservation_for_growth={};component_model=1",
+                getOptLevelName(profile.opt_level),
+                profile.debug_info,
+                profile.native_unwind_info,
+                profile.parallel_compilation,
+                profile.simd,
+                profile.relaxed_simd,
+                profile.epoch_interruption,
+                profile.consume_fuel,
+                profile.memory_reservation,
+                profile.memory_guard_size,
+                profile.memory_reservation_for_growth);
+        }
+
+        std::string describe(const WasmtimePoolingConfig& pooling_config)
+        {
+            return std::format(
+                "instance_slots={};core_instances_per_slot={};memories_per_slot={};tables_per_slot={};stack_slots={};"
+                "max_memory_size={};table_elements={};max_unused_warm_slots={};linear_memory_keep_resident={};table_keep_resident={}",
+                pooling_config.instance_slots,
+                pooling_config.core_instances_per_slot,
+                pooling_config.memories_per_slot,
+                pooling_config.tables_per_slot,
+                pooling_config.stack_slots,
+                pooling_config.max_memory_size,
+                pooling_config.table_elements,
+                pooling_config.max_unused_warm_slots,
+                pooling_config.linear_memory_keep_resident,
+                pooling_config.table_keep_resident);
+        }
+
+        std::uint64_t getFingerprint(const WasmtimeEngineProfile& profile)
+        {
+            return WasmtimeHash::hashString(describe(profile));
+        }
+
+        std::optional<wasmtime::OptLevel> parseOptLevel(std::string_view opt_level)
+        {
+            if(opt_level == "none") return wasmtime::OptLevel::None;
+            if(opt_level == "speed") return wasmtime::OptLevel::Speed;
+            if(opt_level == "speed_and_size") return wasmtime::OptLevel::SpeedAndSize;
+            return std::nullopt;
+        }
+
+        bool isPrecompiledArtifact(const void* data, size_t data_size)
+        {
+            static constexpr unsigned char ELF_MAGIC[] = {0x7f, 'E', 'L', 'F'};
+            return data != nullptr
+                && data_size >= sizeof(ELF_MAGIC)
+                && std::memcmp(data, ELF_MAGIC, sizeof(ELF_MAGIC)) == 0;
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <wasmtime.hh>
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Named set of code generation and memory settings for the wasmtime engine
+     */
+    struct WasmtimeEngineProfile
+    {
+        std::string name;
+        wasmtime::OptLevel opt_level = wasmtime::OptLevel::None;
+        bool debug_info = true;
+        bool native_unwind_info = true;
+        bool parallel_compilation = true;
+        bool simd = true;
+        bool relaxed_simd = false;
+        // Inserts epoch checks into generated code, required for per-tick script budgets
+        bool epoch_interruption = false;
+        // Inserts fuel accounting into generated code, required for per-context fuel limits
+        bool consume_fuel = false;
+        std::uint64_t memory_reservation = 4ull * 1024 * 1024 * 1024;
+        std::uint64_t memory_guard_size = 32ull * 1024 * 1024;
+        std::uint64_t memory_reservation_for_growth = 2ull * 1024 * 1024 * 1024;
+    };
+
+    /**
+     * @brief Slot budget of the pooling instance allocator
+     *
+     * Every slot is reserved up front; instantiation then reuses resident, copy-on-write
+     * initialized memory instead of mapping and unmapping linear memory per instance.
+     */
+    struct WasmtimePoolingConfig
+    {
+        std::uint32_t instance_slots = 128;
+        // Core instances, memories and tables a single component may use out of its slot
+        std::uint32_t core_instances_per_slot = 16;
+        std::uint32_t memories_per_slot = 2;
+        std::uint32_t tables_per_slot = 4;
+        std::uint32_t stack_slots = 0;
+        std::uint64_t max_memory_size = 64ull * 1024 * 1024;
+        std::uint32_t table_elements = 20000;
+        std::uint32_t max_unused_warm_slots = 32;
+        std::uint64_t linear_memory_keep_resident = 1ull * 1024 * 1024;
+        std::uint64_t table_keep_resident = 64ull * 1024;
+    };
+
+    /**
+     * @brief Engine configuration shared by the script module and the offline precompile tool
+     *
+     * Precompiled components only deserialize into an engine created with the same settings,
+     * so both sides must build their wasmtime::Config through here.
+     */
+    namespace WasmtimeEngineConfig
+    {
+        constexpr const char* DEFAULT_PROFILE = "debug";
+
+        // Built-in profiles: debug, release and size
+        std::optional<WasmtimeEngineProfile> getProfile(std::string_view profile_name);
+        std::vector<std::string_view> getProfileNames();
+
+        // Pooling is a runtime allocation choice and does not change compiled artifacts
+        wasmtime::Config createConfig(const WasmtimeEngineProfile& profile, const std::optional<WasmtimePoolingConfig>& pooling_config = std::nullopt);
+
+        std::string describe(const WasmtimePoolingConfig& pooling_config);
+
+        // Human readable dump of every setting that changes generated code
+        std::string describe(const WasmtimeEngineProfile& profile);
+
+        // Hash of describe(), compiled artifacts are only reusable under the same fingerprint
+        std::uint64_t getFingerprint(const WasmtimeEngineProfile& profile);
+
+        std::optional<wasmtime::OptLevel> parseOptLevel(std::string_view opt_level);
+
+        // Precompiled artifacts produced by Component::serialize are ELF images, raw components start with the wasm magic
+        bool isPrecompiledArtifact(const void* data, size_t data_size);
+
+        constexpr const char* PRECOMPILED_EXTENSION = ".cwasm";
+    }
+}
+
+
+
+
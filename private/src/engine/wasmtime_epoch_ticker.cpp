@@ -0,0 +1,47 @@
+#include "base/prerequisites.h"
+#include "wasmtime_epoch_ticker.h"
+#include "core/logger/logger.h"
+
+namespace Arieo
+{
+    void WasmtimeEpochTicker::start(wasmtime::Engine& engine, std::chrono::microseconds period)
+    {
+        if(isRunning())
+        {
+            return;
+        }
+        m_period = period;
+        m_is_stopping = false;
+        m_thread = std::thread(&WasmtimeEpochTicker::tickerMain, this, &engine);
+        Core::Logger::info("Wasmtime epoch ticker started with a {} us period", period.count());
+    }
+
+    void WasmtimeEpochTicker::stop()
+    {
+        if(isRunning() == false)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_stop_cv.notify_all();
+        m_thread.join();
+    }
+
+    void WasmtimeEpochTicker::tickerMain(wasmtime::Engine* engine)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto next_tick = std::chrono::steady_clock::now() + m_period;
+        while(m_stop_cv.wait_until(lock, next_tick, [this] { return m_is_stopping; }) == false)
+        {
+            engine->increment_epoch();
+            next_tick += m_period;
+        }
+    }
+}
+
+
+
+
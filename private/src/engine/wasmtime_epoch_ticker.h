@@ -0,0 +1,39 @@
+#pragma once
+
+#include <wasmtime.hh>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Arieo
+{
+    /**
+     * @brief Background thread advancing the engine epoch at a fixed period
+     *
+     * Stores measure their deadlines in epoch ticks, so the period is the resolution
+     * at which an over-budget guest is interrupted.
+     */
+    class WasmtimeEpochTicker final
+    {
+    public:
+        void start(wasmtime::Engine& engine, std::chrono::microseconds period);
+        void stop();
+
+        bool isRunning() const { return m_thread.joinable(); }
+        std::chrono::microseconds getPeriod() const { return m_period; }
+    private:
+        void tickerMain(wasmtime::Engine* engine);
+
+        std::chrono::microseconds m_period = std::chrono::microseconds(0);
+        std::mutex m_mutex;
+        std::condition_variable m_stop_cv;
+        bool m_is_stopping = false;
+        std::thread m_thread;
+    };
+}
+
+
+
+
@@ -0,0 +1,361 @@
+#include "base/prerequisites.h"
+#include "wasmtime_host_call_batch.h"
+#include "core/logger/logger.h"
+
+#include <bit>
+#include <limits>
+#include <utility>
+
+namespace Arieo
+{
+    namespace
+    {
+        constexpr size_t MAX_VALUE_COUNT = 16;
+
+        template<typename T>
+        bool isInRange(std::int64_t value)
+        {
+            return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+        }
+    }
+
+    void WasmtimeHostCallBatch::registerFunction(std::string_view interface_name, std::string_view function_name, HostCallback host_callback)
+    {
+        std::string function_key = getFunctionKey(interface_name, function_name);
+        if(m_function_ids.contains(function_key))
+        {
+            Core::Logger::error("Batched host function {}#{} registered twice, keeping the first", interface_name, function_name);
+            return;
+        }
+
+        FunctionEntry& function_entry = m_functions.emplace_back();
+        function_entry.interface_name = interface_name;
+        function_entry.function_name = function_name;
+        function_entry.host_callback = host_callback;
+        m_function_ids.emplace(std::move(function_key), static_cast<std::uint32_t>(m_functions.size()));
+    }
+
+    void WasmtimeHostCallBatch::registerSignatures(const wasmtime::component::Component& component, const wasmtime::Engine& engine)
+    {
+        if(m_functions.empty())
+        {
+            return;
+        }
+
+        wasmtime_component_type_t* component_type = wasmtime_component_type(component.capi());
+        size_t import_count = wasmtime_component_type_import_count(component_type, engine.capi());
+        for(size_t i = 0; i < import_count; ++i)
+        {
+            const char* interface_name = nullptr;
+            size_t interface_name_size = 0;
+            wasmtime_component_item_t import_item;
+            if(wasmtime_component_type_import_nth(component_type, engine.capi(), i, &interface_name, &interface_name_size, &import_item) == false)
+            {
+                continue;
+            }
+
+            if(import_item.kind == WASMTIME_COMPONENT_ITEM_COMPONENT_INSTANCE)
+            {
+                const wasmtime_component_instance_type_t* instance_type = import_item.of.component_instance;
+                size_t export_count = wasmtime_component_instance_type_export_count(instance_type, engine.capi());
+                for(size_t j = 0; j < export_count; ++j)
+                {
+                    const char* function_name = nullptr;
+                    size_t function_name_size = 0;
+                    wasmtime_component_item_t export_item;
+                    if(wasmtime_component_instance_type_export_nth(instance_type, engine.capi(), j, &function_name, &function_name_size, &export_item) == false)
+                    {
+                        continue;
+                    }
+
+                    auto id_iter = m_function_ids.find(getFunctionKey(
+                        std::string_view(interface_name, interface_name_size),
+                        std::string_view(function_name, function_name_size)));
+                    if(export_item.kind == WASMTIME_COMPONENT_ITEM_COMPONENT_FUNC && id_iter != m_function_ids.end())
+                    {
+                        FunctionEntry& function_entry = m_functions[id_iter->second - 1];
+                        std::lock_guard<std::mutex> lock(m_signature_mutex);
+                        if(function_entry.signature.load(std::memory_order_relaxed) == nullptr)
+                        {
+                            std::optional<Signature> signature = parseSignature(export_item.of.component_func);
+                            if(signature.has_value())
+                            {
+                                function_entry.signature.store(&m_signatures.emplace_back(std::move(signature.value())), std::memory_order_release);
+                            }
+                        }
+                    }
+                    wasmtime_component_item_delete(&export_item);
+                }
+            }
+            wasmtime_component_item_delete(&import_item);
+        }
+        wasmtime_component_type_delete(component_type);
+    }
+
+    std::optional<WasmtimeHostCallBatch::Signature> WasmtimeHostCallBatch::parseSignature(const wasmtime_component_func_type_t* func_type)
+    {
+        auto toValueKind = [](const wasmtime_component_valtype_t& valtype) -> std::optional<ValueKind>
+        {
+            switch(valtype.kind)
+            {
+            case WASMTIME_COMPONENT_VALTYPE_BOOL: return ValueKind::Bool;
+            case WASMTIME_COMPONENT_VALTYPE_S8: return ValueKind::S8;
+            case WASMTIME_COMPONENT_VALTYPE_U8: return ValueKind::U8;
+            case WASMTIME_COMPONENT_VALTYPE_S16: return ValueKind::S16;
+            case WASMTIME_COMPONENT_VALTYPE_U16: return ValueKind::U16;
+            case WASMTIME_COMPONENT_VALTYPE_S32: return ValueKind::S32;
+            case WASMTIME_COMPONENT_VALTYPE_U32: return ValueKind::U32;
+            case WASMTIME_COMPONENT_VALTYPE_S64: return ValueKind::S64;
+            case WASMTIME_COMPONENT_VALTYPE_U64: return ValueKind::U64;
+            case WASMTIME_COMPONENT_VALTYPE_F32: return ValueKind::F32;
+            case WASMTIME_COMPONENT_VALTYPE_F64: return ValueKind::F64;
+            default: return std::nullopt;
+            }
+        };
+
+        std::vector<ValueKind> param_kinds;
+        size_t param_count = wasmtime_component_func_type_param_count(func_type);
+        if(param_count > MAX_VALUE_COUNT)
+        {
+            return std::nullopt;
+        }
+        for(size_t i = 0; i < param_count; ++i)
+        {
+            const char* param_name = nullptr;
+            size_t param_name_size = 0;
+            wasmtime_component_valtype_t param_type;
+            if(wasmtime_component_func_type_param_nth(func_type, i, &param_name, &param_name_size, &param_type) == false)
+            {
+                return std::nullopt;
+            }
+            std::optional<ValueKind> param_kind = toValueKind(param_type);
+            wasmtime_component_valtype_delete(&param_type);
+            if(param_kind.has_value() == false)
+            {
+                return std::nullopt;
+            }
+            param_kinds.push_back(param_kind.value());
+        }
+
+        std::optional<ValueKind> result_kind;
+        wasmtime_component_valtype_t result_type;
+        if(wasmtime_component_func_type_result(func_type, &result_type))
+        {
+            result_kind = toValueKind(result_type);
+            wasmtime_component_valtype_delete(&result_type);
+            if(result_kind.has_value() == false)
+            {
+                return std::nullopt;
+            }
+        }
+
+        return Signature{
+            std::move(param_kinds),
+            result_kind,
+            wasmtime::component::FuncType(wasmtime_component_func_type_clone(func_type))
+        };
+    }
+
+    std::uint32_t WasmtimeHostCallBatch::findFunctionId(std::string_view interface_name, std::string_view function_name) const
+    {
+        auto iter = m_function_ids.find(getFunctionKey(interface_name, function_name));
+        if(iter == m_function_ids.end() || m_functions[iter->second - 1].signature.load(std::memory_order_acquire) == nullptr)
+        {
+            return 0;
+        }
+        return iter->second;
+    }
+
+    bool WasmtimeHostCallBatch::lowerWord(ValueKind kind, std::uint64_t word, wasmtime::component::Val& value)
+    {
+        std::int64_t signed_word = static_cast<std::int64_t>(word);
+        switch(kind)
+        {
+        case ValueKind::Bool:
+            if(word > 1) return false;
+            value = wasmtime::component::Val(word != 0);
+            return true;
+        case ValueKind::S8:
+            if(isInRange<std::int8_t>(signed_word) == false) return false;
+            value = wasmtime::component::Val(static_cast<std::int8_t>(signed_word));
+            return true;
+        case ValueKind::U8:
+            if(word > std::numeric_limits<std::uint8_t>::max()) return false;
+            value = wasmtime::component::Val(static_cast<std::uint8_t>(word));
+            return true;
+        case ValueKind::S16:
+            if(isInRange<std::int16_t>(signed_word) == false) return false;
+            value = wasmtime::component::Val(static_cast<std::int16_t>(signed_word));
+            return true;
+        case ValueKind::U16:
+            if(word > std::numeric_limits<std::uint16_t>::max()) return false;
+            value = wasmtime::component::Val(static_cast<std::uint16_t>(word));
+            return true;
+        case ValueKind::S32:
+            if(isInRange<std::int32_t>(signed_word) == false) return false;
+            value = wasmtime::component::Val(static_cast<std::int32_t>(signed_word));
+            return true;
+        case ValueKind::U32:
+            if(word > std::numeric_limits<std::uint32_t>::max()) return false;
+            value = wasmtime::component::Val(static_cast<std::uint32_t>(word));
+            return true;
+        case ValueKind::S64:
+            value = wasmtime::component::Val(signed_word);
+            return true;
+        case ValueKind::U64:
+            value = wasmtime::component::Val(word);
+            return true;
+        case ValueKind::F32:
+            if(word > std::numeric_limits<std::uint32_t>::max()) return false;
+            value = wasmtime::component::Val(std::bit_cast<float>(static_cast<std::uint32_t>(word)));
+            return true;
+        case ValueKind::F64:
+            value = wasmtime::component::Val(std::bit_cast<double>(word));
+            return true;
+        }
+        return false;
+    }
+
+    bool WasmtimeHostCallBatch::liftWord(ValueKind kind, const wasmtime::component::Val& value, std::uint64_t& word)
+    {
+        switch(kind)
+        {
+        case ValueKind::Bool:
+            if(value.is_bool() == false) return false;
+            word = value.get_bool() ? 1 : 0;
+            return true;
+        case ValueKind::S8:
+            if(value.is_s8() == false) return false;
+            word = static_cast<std::uint64_t>(static_cast<std::int64_t>(value.get_s8()));
+            return true;
+        case ValueKind::U8:
+            if(value.is_u8() == false) return false;
+            word = value.get_u8();
+            return true;
+        case ValueKind::S16:
+            if(value.is_s16() == false) return false;
+            word = static_cast<std::uint64_t>(static_cast<std::int64_t>(value.get_s16()));
+            return true;
+        case ValueKind::U16:
+            if(value.is_u16() == false) return false;
+            word = value.get_u16();
+            return true;
+        case ValueKind::S32:
+            if(value.is_s32() == false) return false;
+            word = static_cast<std::uint64_t>(static_cast<std::int64_t>(value.get_s32()));
+            return true;
+        case ValueKind::U32:
+            if(value.is_u32() == false) return false;
+            word = value.get_u32();
+            return true;
+        case ValueKind::S64:
+            if(value.is_s64() == false) return false;
+            word = static_cast<std::uint64_t>(value.get_s64());
+            return true;
+        case ValueKind::U64:
+            if(value.is_u64() == false) return false;
+            word = value.get_u64();
+            return true;
+        case ValueKind::F32:
+            if(value.is_f32() == false) return false;
+            word = std::bit_cast<std::uint32_t>(value.get_f32());
+            return true;
+        case ValueKind::F64:
+            if(value.is_f64() == false) return false;
+            word = std::bit_cast<std::uint64_t>(value.get_f64());
+            return true;
+        }
+        return false;
+    }
+
+    WasmtimeHostCallBatch::ReplayResult WasmtimeHostCallBatch::replay(
+        wasmtime::Store::Context store_ctx,
+        std::span<const std::uint64_t> commands,
+        std::vector<std::uint64_t>& output) const
+    {
+        ReplayResult replay_result;
+
+        // Reused by every batch replayed on this thread, so steady state replay does not allocate
+        thread_local std::vector<wasmtime::component::Val> args;
+        thread_local std::vector<wasmtime::component::Val> results;
+
+        size_t offset = 0;
+        while(offset < commands.size())
+        {
+            std::uint64_t header = commands[offset++];
+            std::uint32_t function_id = static_cast<std::uint32_t>(header);
+            std::uint64_t arg_count = header >> 32;
+            const Signature* signature = function_id != 0 && function_id <= m_functions.size()
+                ? m_functions[function_id - 1].signature.load(std::memory_order_acquire)
+                : nullptr;
+            // The argument count is redundant with the signature, it catches a command stream out of step early
+            if(signature == nullptr || arg_count != signature->param_kinds.size() || commands.size() - offset < arg_count)
+            {
+                Core::Logger::error("Malformed host call batch command {} (function id {})", replay_result.executed_count, function_id);
+                replay_result.is_failed = true;
+                break;
+            }
+
+            args.resize(arg_count, wasmtime::component::Val(false));
+            bool is_args_valid = true;
+            for(size_t i = 0; i < arg_count && is_args_valid; ++i)
+            {
+                is_args_valid = lowerWord(signature->param_kinds[i], commands[offset + i], args[i]);
+            }
+            offset += arg_count;
+            if(is_args_valid == false)
+            {
+                Core::Logger::error("Argument out of range for its type in host call batch command {}", replay_result.executed_count);
+                replay_result.is_failed = true;
+                break;
+            }
+
+            // Callbacks overwrite every result slot, the placeholder only gives the span its size
+            results.assign(signature->result_kind.has_value() ? 1 : 0, wasmtime::component::Val(false));
+
+            const FunctionEntry& function_entry = m_functions[function_id - 1];
+            wasmtime::Result<std::monostate> call_result = function_entry.host_callback(
+                store_ctx,
+                signature->func_type,
+                wasmtime::Span<wasmtime::component::Val>(args.data(), args.size()),
+                wasmtime::Span<wasmtime::component::Val>(results.data(), results.size())
+            );
+            if(!call_result)
+            {
+                Core::Logger::error("Host call batch command {} ({}#{}) failed: {}",
+                    replay_result.executed_count, function_entry.interface_name, function_entry.function_name, call_result.err().message());
+                replay_result.is_failed = true;
+                break;
+            }
+
+            if(signature->result_kind.has_value())
+            {
+                std::uint64_t result_word = 0;
+                if(liftWord(signature->result_kind.value(), results[0], result_word) == false)
+                {
+                    Core::Logger::error("Host function {}#{} returned a value not matching its type", function_entry.interface_name, function_entry.function_name);
+                    replay_result.is_failed = true;
+                    break;
+                }
+                output.push_back(result_word);
+            }
+            replay_result.executed_count++;
+        }
+
+        return replay_result;
+    }
+
+    std::string WasmtimeHostCallBatch::getFunctionKey(std::string_view interface_name, std::string_view function_name)
+    {
+        std::string function_key;
+        function_key.reserve(interface_name.size() + 1 + function_name.size());
+        function_key.append(interface_name);
+        function_key.push_back('#');
+        function_key.append(function_name);
+        return function_key;
+    }
+}
+
+
+
+
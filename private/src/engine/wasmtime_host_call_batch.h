@@ -0,0 +1,110 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "lib/wasmtime_linker/interface_wasmtime_linker.h"
+#include <wasmtime.hh>
+#include <wasmtime/component.hh>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Dispatch table replaying guest recorded interface calls in a single guest to host transition
+     *
+     * Backs arieo:application/host-batch. A guest resolves function ids once, records calls into a
+     * list of 64-bit words and submits it; the results of every executed command come back in one list.
+     *
+     * Command:  header word (function id | argument count << 32), then one word per argument
+     * Output:   executed command count, then one word per result of each executed command
+     * Word:     bool as 0/1, integers zero or sign extended, f32/f64 as their bit pattern
+     *
+     * Arguments are checked against the callee's real parameter types before it is called, and the
+     * callee receives its own FuncType. Types come from the imports of loaded components, so only
+     * functions some component imports with scalar parameters and at most one scalar result can be
+     * batched, everything else must use the direct import.
+     */
+    class WasmtimeHostCallBatch final
+    {
+    public:
+        using HostCallback = decltype(Lib::WasmtimeLinker::InterfaceFunctionExportInfo::m_host_callback);
+
+        struct ReplayResult
+        {
+            std::uint32_t executed_count = 0;
+            bool is_failed = false;
+        };
+
+        // Linker registration, only while initInterfaceLinkers runs
+        void registerFunction(std::string_view interface_name, std::string_view function_name, HostCallback host_callback);
+        // Records the parameter and result types of every registered function the component imports, from any thread
+        void registerSignatures(const wasmtime::component::Component& component, const wasmtime::Engine& engine);
+
+        // 0 when the function is not registered or cannot be batched
+        std::uint32_t findFunctionId(std::string_view interface_name, std::string_view function_name) const;
+
+        // Stops at the first malformed command or failing callback, executed_count tells how far it got.
+        // output receives the result words of the executed commands.
+        ReplayResult replay(
+            wasmtime::Store::Context store_ctx,
+            std::span<const std::uint64_t> commands,
+            std::vector<std::uint64_t>& output) const;
+    private:
+        enum class ValueKind : std::uint8_t
+        {
+            Bool,
+            S8,
+            U8,
+            S16,
+            U16,
+            S32,
+            U32,
+            S64,
+            U64,
+            F32,
+            F64,
+        };
+
+        struct Signature
+        {
+            std::vector<ValueKind> param_kinds;
+            std::optional<ValueKind> result_kind;
+            wasmtime::component::FuncType func_type;
+        };
+
+        struct FunctionEntry
+        {
+            std::string interface_name;
+            std::string function_name;
+            HostCallback host_callback;
+            // Published once with release order, immutable afterwards so replay reads it without a lock
+            std::atomic<const Signature*> signature = nullptr;
+        };
+
+        // "<interface>#<function>", the full names so two functions never share an id
+        static std::string getFunctionKey(std::string_view interface_name, std::string_view function_name);
+        // Null when a parameter or the result is not a scalar
+        static std::optional<Signature> parseSignature(const wasmtime_component_func_type_t* func_type);
+        static bool lowerWord(ValueKind kind, std::uint64_t word, wasmtime::component::Val& value);
+        static bool liftWord(ValueKind kind, const wasmtime::component::Val& value, std::uint64_t& word);
+
+        // Indexed by function id - 1, a deque so entries never move once handed out
+        std::deque<FunctionEntry> m_functions;
+        std::unordered_map<std::string, std::uint32_t> m_function_ids;
+        std::mutex m_signature_mutex;
+        std::deque<Signature> m_signatures;
+    };
+}
+
+
+
+
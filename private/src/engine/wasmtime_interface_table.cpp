@@ -0,0 +1,149 @@
+#include "base/prerequisites.h"
+#include "wasmtime_interface_table.h"
+#include "../utility/wasmtime_hash.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace Arieo
+{
+    namespace
+    {
+        // splitmix64 finalizer, interface ids are not guaranteed to be well distributed in the low bits
+        std::uint64_t mixHash(std::uint64_t value)
+        {
+            value ^= value >> 30;
+            value *= 0xbf58476d1ce4e5b9ull;
+            value ^= value >> 27;
+            value *= 0x94d049bb133111ebull;
+            value ^= value >> 31;
+            return value;
+        }
+    }
+
+    void WasmtimeInterfaceTable::build(const std::unordered_map<std::uint64_t, Lib::WasmtimeLinker::InterfaceExportInfo*>& interface_export_map)
+    {
+        // Keep the load factor at or below one half so probe sequences stay short
+        size_t capacity = std::bit_ceil(std::max<size_t>(8, interface_export_map.size() * 2));
+        m_slots.assign(capacity, Slot());
+        m_mask = capacity - 1;
+
+        for(const auto& [interface_id, interface_export_info] : interface_export_map)
+        {
+            for(std::uint64_t index = mixHash(interface_id) & m_mask; ; index = (index + 1) & m_mask)
+            {
+                if(m_slots[index].interface_export_info == nullptr)
+                {
+                    m_slots[index].interface_id = interface_id;
+                    m_slots[index].interface_export_info = interface_export_info;
+                    break;
+                }
+            }
+        }
+    }
+
+    const Lib::WasmtimeLinker::InterfaceExportInfo* WasmtimeInterfaceTable::find(std::uint64_t interface_id) const
+    {
+        if(m_slots.empty())
+        {
+            return nullptr;
+        }
+
+        for(std::uint64_t index = mixHash(interface_id) & m_mask; ; index = (index + 1) & m_mask)
+        {
+            const Slot& slot = m_slots[index];
+            if(slot.interface_export_info == nullptr)
+            {
+                return nullptr;
+            }
+            if(slot.interface_id == interface_id)
+            {
+                return slot.interface_export_info;
+            }
+        }
+    }
+
+    std::uint64_t WasmtimeInterfaceHandleCache::getKeyHash(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name)
+    {
+        return mixHash(WasmtimeHash::hashString(instance_name, interface_id ^ mixHash(interface_checksum)));
+    }
+
+    bool WasmtimeInterfaceHandleCache::find(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name, std::uint64_t& instance_handle) const
+    {
+        if(m_slots.empty())
+        {
+            return false;
+        }
+
+        std::uint64_t key_hash = getKeyHash(interface_id, interface_checksum, instance_name);
+        std::uint64_t mask = m_slots.size() - 1;
+        for(std::uint64_t index = key_hash & mask; ; index = (index + 1) & mask)
+        {
+            const Slot& slot = m_slots[index];
+            if(slot.is_occupied == false)
+            {
+                return false;
+            }
+            if(slot.key_hash == key_hash
+                && slot.interface_id == interface_id
+                && slot.interface_checksum == interface_checksum
+                && slot.instance_name == instance_name)
+            {
+                instance_handle = slot.instance_handle;
+                return true;
+            }
+        }
+    }
+
+    void WasmtimeInterfaceHandleCache::insert(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name, std::uint64_t instance_handle)
+    {
+        if((m_count + 1) * 2 > m_slots.size())
+        {
+            grow();
+        }
+
+        std::uint64_t key_hash = getKeyHash(interface_id, interface_checksum, instance_name);
+        std::uint64_t mask = m_slots.size() - 1;
+        for(std::uint64_t index = key_hash & mask; ; index = (index + 1) & mask)
+        {
+            Slot& slot = m_slots[index];
+            if(slot.is_occupied == false)
+            {
+                slot.key_hash = key_hash;
+                slot.interface_id = interface_id;
+                slot.interface_checksum = interface_checksum;
+                slot.instance_name = instance_name;
+                slot.instance_handle = instance_handle;
+                slot.is_occupied = true;
+                m_count++;
+                return;
+            }
+        }
+    }
+
+    void WasmtimeInterfaceHandleCache::grow()
+    {
+        std::vector<Slot> old_slots = std::move(m_slots);
+        m_slots.assign(std::max<size_t>(16, old_slots.size() * 2), Slot());
+        std::uint64_t mask = m_slots.size() - 1;
+        for(Slot& old_slot : old_slots)
+        {
+            if(old_slot.is_occupied == false)
+            {
+                continue;
+            }
+            for(std::uint64_t index = old_slot.key_hash & mask; ; index = (index + 1) & mask)
+            {
+                if(m_slots[index].is_occupied == false)
+                {
+                    m_slots[index] = std::move(old_slot);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "lib/wasmtime_linker/interface_wasmtime_linker.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Open-addressing table of linked interfaces keyed by interface id
+     *
+     * Rebuilt whenever a linker library is registered and read-only afterwards, so lookups from
+     * get-interface are a couple of probes over one contiguous array.
+     */
+    class WasmtimeInterfaceTable final
+    {
+    public:
+        void build(const std::unordered_map<std::uint64_t, Lib::WasmtimeLinker::InterfaceExportInfo*>& interface_export_map);
+        const Lib::WasmtimeLinker::InterfaceExportInfo* find(std::uint64_t interface_id) const;
+    private:
+        struct Slot
+        {
+            std::uint64_t interface_id = 0;
+            const Lib::WasmtimeLinker::InterfaceExportInfo* interface_export_info = nullptr;
+        };
+
+        std::vector<Slot> m_slots;
+        std::uint64_t m_mask = 0;
+    };
+
+    /**
+     * @brief Per-store memo of interface handles already returned to the guest
+     *
+     * Keyed by (interface id, checksum, instance name); a hit skips ModuleManager entirely.
+     * Lookups compare the stored name against the guest string view and never allocate.
+     */
+    class WasmtimeInterfaceHandleCache final
+    {
+    public:
+        bool find(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name, std::uint64_t& instance_handle) const;
+        void insert(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name, std::uint64_t instance_handle);
+    private:
+        struct Slot
+        {
+            std::uint64_t key_hash = 0;
+            std::uint64_t interface_id = 0;
+            std::uint64_t interface_checksum = 0;
+            std::string instance_name;
+            std::uint64_t instance_handle = 0;
+            bool is_occupied = false;
+        };
+
+        static std::uint64_t getKeyHash(std::uint64_t interface_id, std::uint64_t interface_checksum, std::string_view instance_name);
+        void grow();
+
+        std::vector<Slot> m_slots;
+        size_t m_count = 0;
+    };
+}
+
+
+
+
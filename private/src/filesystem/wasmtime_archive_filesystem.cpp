@@ -0,0 +1,139 @@
+#include "base/prerequisites.h"
+#include "wasmtime_archive_filesystem.h"
+#include "core/logger/logger.h"
+
+namespace Arieo
+{
+    WasmtimeArchiveFilesystem::WasmtimeArchiveFilesystem(const Config& config)
+        : m_config(config)
+    {
+    }
+
+    WasmtimeArchiveFilesystem::~WasmtimeArchiveFilesystem()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_resident_files.empty() == false)
+        {
+            Core::Logger::error("{} archive files still open by guests at shutdown", m_resident_files.size());
+        }
+        for(auto& [archive_path, resident_file] : m_resident_files)
+        {
+            m_archive->releaseFileBuffer(resident_file.file_buffer);
+        }
+        m_resident_files.clear();
+    }
+
+    void WasmtimeArchiveFilesystem::configureWasi(wasmtime::WasiConfig& wasi) const
+    {
+        if(m_config.mode != Mode::Preopen)
+        {
+            return;
+        }
+        if(wasi.preopen_dir(m_config.host_dir.string(), m_config.guest_path, WASMTIME_WASI_DIR_PERMS_READ, WASMTIME_WASI_FILE_PERMS_READ) == false)
+        {
+            Core::Logger::error("Failed to preopen {} for guests at {}", m_config.host_dir.string(), m_config.guest_path);
+        }
+    }
+
+    std::string WasmtimeArchiveFilesystem::toArchivePath(std::string_view guest_path) const
+    {
+        if(guest_path.empty() || guest_path.front() == '/' || guest_path.front() == '\\')
+        {
+            return std::string();
+        }
+
+        std::string archive_path = m_config.archive_root;
+        size_t component_start = 0;
+        while(component_start <= guest_path.size())
+        {
+            size_t component_end = guest_path.find_first_of("/\\", component_start);
+            if(component_end == std::string_view::npos)
+            {
+                component_end = guest_path.size();
+            }
+            std::string_view component = guest_path.substr(component_start, component_end - component_start);
+            component_start = component_end + 1;
+
+            if(component.empty() || component == ".")
+            {
+                continue;
+            }
+            if(component == "..")
+            {
+                return std::string();
+            }
+            if(archive_path.empty() == false)
+            {
+                archive_path += '/';
+            }
+            archive_path += component;
+        }
+        return archive_path;
+    }
+
+    const WasmtimeArchiveFilesystem::ResidentFile* WasmtimeArchiveFilesystem::open(std::string_view guest_path)
+    {
+        std::string archive_path = toArchivePath(guest_path);
+        if(archive_path.empty())
+        {
+            Core::Logger::error("Guest path '{}' is outside of the script archive", guest_path);
+            return nullptr;
+        }
+        // Same spelling ScriptManager uses for script_entry
+        archive_path = Core::SystemUtility::FileSystem::getFormalizedPath(archive_path).string();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_resident_files.find(archive_path);
+        if(iter != m_resident_files.end())
+        {
+            iter->second.open_count++;
+            return &iter->second;
+        }
+
+        if(m_archive == nullptr)
+        {
+            Base::Interop::RawRef<Interface::Main::IMainModule> main_module = Core::ModuleManager::getInterface<Interface::Main::IMainModule>();
+            if(main_module == nullptr)
+            {
+                Core::Logger::error("Main module is not available, guest archive reads fail");
+                return nullptr;
+            }
+            m_archive = main_module->getRootArchive();
+        }
+
+        ArchiveFileBuffer file_buffer = m_archive->aquireFileBuffer(archive_path);
+        if(file_buffer == nullptr)
+        {
+            return nullptr;
+        }
+
+        ResidentFile resident_file{
+            archive_path,
+            file_buffer,
+            std::span<const std::byte>(static_cast<const std::byte*>(file_buffer->getBuffer()), file_buffer->getBufferSize()),
+            1
+        };
+        return &m_resident_files.emplace(archive_path, std::move(resident_file)).first->second;
+    }
+
+    void WasmtimeArchiveFilesystem::close(const ResidentFile* resident_file)
+    {
+        if(resident_file == nullptr)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_resident_files.find(resident_file->archive_path);
+        if(iter == m_resident_files.end() || --iter->second.open_count > 0)
+        {
+            return;
+        }
+        m_archive->releaseFileBuffer(iter->second.file_buffer);
+        m_resident_files.erase(iter);
+    }
+}
+
+
+
+
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "core/core.h"
+#include "interface/main/main_module.h"
+#include <wasmtime.hh>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace Arieo
+{
+    /**
+     * @brief Read-only guest access to the main module's root archive, set up from script_engine.filesystem
+     *
+     * Two modes, since wasmtime's WASI has no hook for a virtual filesystem:
+     *  - Preopen: WASI preopens host_dir read-only at guest_path and guests use plain WASI file APIs.
+     *    The engine does not unpack anything, host_dir must already hold the unpacked archive, staged
+     *    by the build or installer.
+     *  - Archive: guests read through arieo:application/archive-fs. Opened entries stay resident as archive
+     *    buffers shared by every context. A read is staged as component values, one per byte, before it is
+     *    lowered into the guest, so reads are capped at WasmtimeContext::MAX_GUEST_READ_SIZE.
+     */
+    class WasmtimeArchiveFilesystem final
+    {
+    public:
+        enum class Mode
+        {
+            Preopen,
+            Archive,
+        };
+
+        struct Config
+        {
+            Mode mode = Mode::Archive;
+            // Archive entry prefix guest paths are resolved under, like the "script" directory of script_entry
+            std::string archive_root;
+            // Preopen mode only
+            std::filesystem::path host_dir;
+            std::string guest_path = "/assets";
+        };
+
+        using ArchiveRef = decltype(std::declval<Base::Interop::RawRef<Interface::Main::IMainModule>&>()->getRootArchive());
+        using ArchiveFileBuffer = decltype(std::declval<ArchiveRef&>()->aquireFileBuffer(std::declval<std::string>()));
+
+        // Archive entry kept resident while any context has it open
+        struct ResidentFile
+        {
+            std::string archive_path;
+            ArchiveFileBuffer file_buffer;
+            std::span<const std::byte> bytes;
+            size_t open_count = 0;
+        };
+
+        explicit WasmtimeArchiveFilesystem(const Config& config);
+        ~WasmtimeArchiveFilesystem();
+
+        WasmtimeArchiveFilesystem(const WasmtimeArchiveFilesystem&) = delete;
+        WasmtimeArchiveFilesystem& operator=(const WasmtimeArchiveFilesystem&) = delete;
+
+        const Config& getConfig() const { return m_config; }
+
+        // Adds the read-only preopen in preopen mode, leaves wasi untouched otherwise
+        void configureWasi(wasmtime::WasiConfig& wasi) const;
+
+        // Archive mode. Relative guest paths only, null when the entry does not exist or escapes archive_root
+        const ResidentFile* open(std::string_view guest_path);
+        void close(const ResidentFile* resident_file);
+    private:
+        // Empty when guest_path is absolute or walks above archive_root
+        std::string toArchivePath(std::string_view guest_path) const;
+
+        Config m_config;
+        std::mutex m_mutex;
+        // Looked up lazily, the main module is not registered yet when the engine initializes
+        ArchiveRef m_archive = nullptr;
+        std::unordered_map<std::string, ResidentFile> m_resident_files;
+    };
+}
+
+
+
+
@@ -1,73 +1,272 @@
 #include "base/prerequisites.h"
 #include "wasmtime_instance.h"
+#include "../context/wasmtime_context.h"
 #include "core/logger/logger.h"
+
+#include <any>
+#include <format>
+
 namespace Arieo
 {
     void* WasmtimeInstance::queryInterface(const std::string& interface_name)
     {
-        // std::optional<wasmtime::component::ExportIndex> export_interface_index = m_instance.get_export_index(
-        //     m_store.context(), nullptr, interface_name.c_str());
-        wasmtime_component_export_index_t* ret = wasmtime_component_instance_get_export_index(
-            m_instance.capi(),
-            m_store.context().capi(),
-            nullptr,
-            interface_name.c_str(),
-            interface_name.size()
-        );
-        if(ret == nullptr)
+        const WasmtimeExportEntry* interface_entry = m_module.resolveExport(nullptr, interface_name);
+        if(interface_entry == nullptr)
         {
             Core::Logger::error("Failed to find interface: {}", interface_name);
             return nullptr;
         }
-        return ret;
+        return const_cast<WasmtimeExportEntry*>(interface_entry);
     }
 
     void* WasmtimeInstance::queryFunction(void* interface, const std::string& function_name)
     {
-        // std::optional<wasmtime::component::ExportIndex> export_function_index = m_instance.get_export_index(
-        //     m_store.context(), static_cast<const wasmtime_component_export_index_t*>(interface), "run");
-
-        wasmtime_component_export_index_t* function_index = wasmtime_component_instance_get_export_index(
-            m_instance.capi(),
-            m_store.context().capi(),
-            static_cast<const wasmtime_component_export_index_t*>(interface),
-            function_name.c_str(),
-            function_name.size()
+        const WasmtimeExportEntry* function_entry = m_module.resolveExport(
+            static_cast<const WasmtimeExportEntry*>(interface),
+            function_name
         );
-        if(function_index == nullptr)
+        if(function_entry == nullptr)
         {
             Core::Logger::error("Failed to find function: {}", function_name);
             return nullptr;
         }
-        return function_index;
+        return const_cast<WasmtimeExportEntry*>(function_entry);
     }
 
-    void WasmtimeInstance::callFunction(void* function)
+    void* WasmtimeInstance::findFunction(const std::string& interface_name, const std::string& function_name)
+    {
+        const WasmtimeExportEntry* interface_entry = m_module.resolveExport(nullptr, interface_name);
+        if(interface_entry == nullptr)
+        {
+            return nullptr;
+        }
+        return const_cast<WasmtimeExportEntry*>(m_module.resolveExport(interface_entry, function_name));
+    }
+
+    const wasmtime_component_func_t* WasmtimeInstance::resolveFunction(void* function)
     {
+        const WasmtimeExportEntry* function_entry = static_cast<const WasmtimeExportEntry*>(function);
+        if(function_entry == nullptr)
+        {
+            Core::Logger::error("Invalid function handle");
+            return nullptr;
+        }
+
+        if(function_entry->slot >= m_function_slots.size())
+        {
+            m_function_slots.resize(m_module.getExportSlotCount());
+        }
+
+        std::optional<wasmtime_component_func_t>& function_slot = m_function_slots[function_entry->slot];
+        if(function_slot.has_value())
+        {
+            return &function_slot.value();
+        }
+
         wasmtime_component_func_t wasmtime_function;
         if(wasmtime_component_instance_get_func(
             m_instance.capi(),
             m_store.context().capi(),
-            static_cast<const wasmtime_component_export_index_t*>(function),
+            function_entry->export_index,
             &wasmtime_function
         ) == false)
         {
-            Core::Logger::error("Failed to get run function from WASM module");
-            return;
+            Core::Logger::error("Failed to get function '{}' from WASM module", function_entry->name);
+            return nullptr;
         }
-        std::vector<wasmtime_component_val_t> results(1);
-        wasmtime_error_t *error = wasmtime_component_func_call(
-            &wasmtime_function, 
-            m_store.context().capi(), 
-            nullptr, 0,
-            results.data(), 
-            results.size()
-        );
-        
+        function_slot = wasmtime_function;
+
+        // Wasmtime rejects a call whose result buffer does not match the function type, so untyped calls pass the real count
+        m_function_result_counts.resize(m_function_slots.size(), 0);
+        wasmtime_component_func_type_t* func_type = wasmtime_component_func_type(&wasmtime_function, m_store.context().capi());
+        wasmtime_component_valtype_t result_type;
+        if(wasmtime_component_func_type_result(func_type, &result_type))
+        {
+            m_function_result_counts[function_entry->slot] = 1;
+            wasmtime_component_valtype_delete(&result_type);
+        }
+        wasmtime_component_func_type_delete(func_type);
+
+        if(m_metrics != nullptr)
+        {
+            m_function_metric_ids.resize(m_function_slots.size(), WasmtimeMetrics::INVALID_METRIC);
+            std::string metric_name = function_entry->parent != nullptr
+                ? std::format("call/{}#{}", function_entry->parent->name, function_entry->name)
+                : std::format("call/{}", function_entry->name);
+            m_function_metric_ids[function_entry->slot] = m_metrics->registerMetric(metric_name, WasmtimeMetrics::Kind::Histogram);
+        }
+        return &function_slot.value();
+    }
+
+    WasmtimeMetrics::MetricId WasmtimeInstance::getFunctionMetricId(void* function) const
+    {
+        const WasmtimeExportEntry* function_entry = static_cast<const WasmtimeExportEntry*>(function);
+        if(function_entry == nullptr || function_entry->slot >= m_function_metric_ids.size())
+        {
+            return WasmtimeMetrics::INVALID_METRIC;
+        }
+        return m_function_metric_ids[function_entry->slot];
+    }
+
+    WasmtimeContext* WasmtimeInstance::getContext()
+    {
+        return std::any_cast<WasmtimeContext*>(m_store.context().get_data());
+    }
+
+    void WasmtimeInstance::callFunction(void* function)
+    {
+        wasmtime::Result<WasmtimeCallResult> call_result = callFunctionWithResult(function);
+        if(!call_result)
+        {
+            Core::Logger::error("Error calling function in WASM module: {}", call_result.err().message());
+        }
+    }
+
+    wasmtime::Result<WasmtimeCallResult> WasmtimeInstance::callFunctionWithResult(void* function)
+    {
+        if(resolveFunction(function) == nullptr)
+        {
+            return wasmtime::Error(wasmtime_error_new("guest function was not resolved"));
+        }
+        WasmtimeContext* wasmtime_context = getContext();
+        if(wasmtime_context->isEnterable() == false)
+        {
+            return wasmtime::Error(wasmtime_error_new("script context is busy with a suspended async call"));
+        }
+
+        wasmtime_context->beginFuelMeter();
+        wasmtime::Result<WasmtimeCallResult> call_result = invokeFunction(function);
+        WasmtimeContext::FuelMeterResult fuel_result = wasmtime_context->endFuelMeter(!call_result);
+        if(fuel_result.is_metered)
+        {
+            recordFuel(function, fuel_result.fuel_consumed, fuel_result.is_exhausted);
+        }
+        return call_result;
+    }
+
+    wasmtime::Result<WasmtimeCallResult> WasmtimeInstance::invokeFunction(void* function)
+    {
+        const wasmtime_component_func_t* wasmtime_function = resolveFunction(function);
+        if(wasmtime_function == nullptr)
+        {
+            return wasmtime::Error(wasmtime_error_new("guest function was not resolved"));
+        }
+
+        // Component functions return nothing or a single value, e.g. the result of wasi:cli/run
+        size_t result_count = m_function_result_counts[static_cast<const WasmtimeExportEntry*>(function)->slot];
+        WasmtimeCallResult result;
+        wasmtime_error_t *error = nullptr;
+        {
+            WasmtimeMetrics::ScopedTimer call_timer(m_metrics, getFunctionMetricId(function));
+            error = wasmtime_component_func_call(
+                wasmtime_function, 
+                m_store.context().capi(), 
+                nullptr, 0,
+                &result.m_value, 
+                result_count
+            );
+        }
+
         if (error != nullptr) 
         {
-            Core::Logger::error("Error calling run function in WASM module: {}", wasmtime::Error(error).message());
+            if(m_metrics != nullptr)
+            {
+                m_metrics->add(WasmtimeMetrics::TRAP_COUNT);
+            }
+            return wasmtime::Error(error);
+        }
+        result.m_has_value = result_count != 0;
+        return result;
+    }
+
+    void WasmtimeInstance::recordFuel(void* function, std::uint64_t fuel_consumed, bool is_exhausted)
+    {
+        m_module.recordFuel(static_cast<const WasmtimeExportEntry*>(function), fuel_consumed, is_exhausted);
+    }
+
+    wasmtime::Result<std::vector<std::uint8_t>> WasmtimeInstance::callFunctionReturningBytes(void* function)
+    {
+        const wasmtime_component_func_t* wasmtime_function = resolveFunction(function);
+        if(wasmtime_function == nullptr)
+        {
+            return wasmtime::Error(wasmtime_error_new("guest function was not resolved"));
+        }
+        if(getContext()->isEnterable() == false)
+        {
+            return wasmtime::Error(wasmtime_error_new("script context is busy with a suspended async call"));
+        }
+
+        wasmtime_component_val_t result;
+        wasmtime_error_t* error = nullptr;
+        {
+            WasmtimeMetrics::ScopedTimer call_timer(m_metrics, getFunctionMetricId(function));
+            error = wasmtime_component_func_call(wasmtime_function, m_store.context().capi(), nullptr, 0, &result, 1);
+        }
+        if(error != nullptr)
+        {
+            if(m_metrics != nullptr)
+            {
+                m_metrics->add(WasmtimeMetrics::TRAP_COUNT);
+            }
+            return wasmtime::Error(error);
+        }
+
+        if(result.kind != WASMTIME_COMPONENT_LIST)
+        {
+            wasmtime_component_val_delete(&result);
+            return wasmtime::Error(wasmtime_error_new("guest function does not return list<u8>"));
+        }
+        std::vector<std::uint8_t> bytes;
+        bytes.reserve(result.of.list.size);
+        for(size_t i = 0; i < result.of.list.size; ++i)
+        {
+            if(result.of.list.data[i].kind != WASMTIME_COMPONENT_U8)
+            {
+                wasmtime_component_val_delete(&result);
+                return wasmtime::Error(wasmtime_error_new("guest function does not return list<u8>"));
+            }
+            bytes.push_back(result.of.list.data[i].of.u8);
+        }
+        wasmtime_component_val_delete(&result);
+        return bytes;
+    }
+
+    wasmtime::Result<std::monostate> WasmtimeInstance::callFunctionWithBytes(void* function, std::span<const std::uint8_t> bytes)
+    {
+        const wasmtime_component_func_t* wasmtime_function = resolveFunction(function);
+        if(wasmtime_function == nullptr)
+        {
+            return wasmtime::Error(wasmtime_error_new("guest function was not resolved"));
+        }
+        if(getContext()->isEnterable() == false)
+        {
+            return wasmtime::Error(wasmtime_error_new("script context is busy with a suspended async call"));
+        }
+
+        wasmtime_component_val_t arg;
+        arg.kind = WASMTIME_COMPONENT_LIST;
+        wasmtime_component_vallist_new_uninit(&arg.of.list, bytes.size());
+        for(size_t i = 0; i < bytes.size(); ++i)
+        {
+            arg.of.list.data[i].kind = WASMTIME_COMPONENT_U8;
+            arg.of.list.data[i].of.u8 = bytes[i];
+        }
+
+        wasmtime_error_t* error = nullptr;
+        {
+            WasmtimeMetrics::ScopedTimer call_timer(m_metrics, getFunctionMetricId(function));
+            error = wasmtime_component_func_call(wasmtime_function, m_store.context().capi(), &arg, 1, nullptr, 0);
+        }
+        wasmtime_component_val_delete(&arg);
+        if(error != nullptr)
+        {
+            if(m_metrics != nullptr)
+            {
+                m_metrics->add(WasmtimeMetrics::TRAP_COUNT);
+            }
+            return wasmtime::Error(error);
         }
+        return std::monostate{};
     }
 
     /*
@@ -3,9 +3,196 @@
 #include "interface/script/script.h"
 #include <wasmtime.hh>
 #include <wasmtime/component.hh>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "../module/wasmtime_module.h"
+#include "../metrics/wasmtime_metrics.h"
 
 namespace Arieo
 {
+    class WasmtimeContext;
+
+    /**
+     * @brief Lowers C++ scalars into component values and lifts them back, without heap allocation
+     */
+    template<typename T>
+    struct WasmtimeValTraits;
+
+#define ARIEO_WASMTIME_VAL_TRAITS(CPP_TYPE, VAL_KIND, VAL_FIELD) \
+    template<> \
+    struct WasmtimeValTraits<CPP_TYPE> \
+    { \
+        static void lower(wasmtime_component_val_t& val, CPP_TYPE value) \
+        { \
+            val.kind = VAL_KIND; \
+            val.of.VAL_FIELD = value; \
+        } \
+        static bool lift(const wasmtime_component_val_t& val, CPP_TYPE& value) \
+        { \
+            if(val.kind != VAL_KIND) \
+            { \
+                return false; \
+            } \
+            value = val.of.VAL_FIELD; \
+            return true; \
+        } \
+    };
+
+    ARIEO_WASMTIME_VAL_TRAITS(bool, WASMTIME_COMPONENT_BOOL, boolean)
+    ARIEO_WASMTIME_VAL_TRAITS(std::int8_t, WASMTIME_COMPONENT_S8, s8)
+    ARIEO_WASMTIME_VAL_TRAITS(std::uint8_t, WASMTIME_COMPONENT_U8, u8)
+    ARIEO_WASMTIME_VAL_TRAITS(std::int16_t, WASMTIME_COMPONENT_S16, s16)
+    ARIEO_WASMTIME_VAL_TRAITS(std::uint16_t, WASMTIME_COMPONENT_U16, u16)
+    ARIEO_WASMTIME_VAL_TRAITS(std::int32_t, WASMTIME_COMPONENT_S32, s32)
+    ARIEO_WASMTIME_VAL_TRAITS(std::uint32_t, WASMTIME_COMPONENT_U32, u32)
+    ARIEO_WASMTIME_VAL_TRAITS(std::int64_t, WASMTIME_COMPONENT_S64, s64)
+    ARIEO_WASMTIME_VAL_TRAITS(std::uint64_t, WASMTIME_COMPONENT_U64, u64)
+    ARIEO_WASMTIME_VAL_TRAITS(float, WASMTIME_COMPONENT_F32, f32)
+    ARIEO_WASMTIME_VAL_TRAITS(double, WASMTIME_COMPONENT_F64, f64)
+
+#undef ARIEO_WASMTIME_VAL_TRAITS
+
+    template<typename Signature>
+    class WasmtimeTypedFunction;
+
+    /**
+     * @brief Pre-resolved guest function with a compile-time signature
+     *
+     * Arguments and results are marshalled through stack arrays, so a call performs no lookup
+     * and no allocation. Only valid while the instance it was resolved from is alive.
+     */
+    template<typename R, typename... Args>
+    class WasmtimeTypedFunction<R(Args...)>
+    {
+    public:
+        using ReturnType = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+        WasmtimeTypedFunction() = default;
+        WasmtimeTypedFunction(const wasmtime_component_func_t& func, wasmtime_context_t* context,
+            WasmtimeMetrics* metrics = nullptr, WasmtimeMetrics::MetricId metric_id = WasmtimeMetrics::INVALID_METRIC)
+            : m_func(func), m_context(context), m_metrics(metrics), m_metric_id(metric_id)
+        {
+        }
+
+        bool isValid() const { return m_context != nullptr; }
+
+        wasmtime::Result<ReturnType> operator()(Args... args) const
+        {
+            if(isValid() == false)
+            {
+                return wasmtime::Error(wasmtime_error_new("guest function was not resolved"));
+            }
+
+            constexpr size_t RESULT_COUNT = std::is_void_v<R> ? 0 : 1;
+            // Zero sized arrays are not allowed, pad both by one element
+            std::array<wasmtime_component_val_t, sizeof...(Args) + 1> arg_vals;
+            std::array<wasmtime_component_val_t, RESULT_COUNT + 1> result_vals;
+
+            size_t arg_index = 0;
+            (WasmtimeValTraits<Args>::lower(arg_vals[arg_index++], args), ...);
+
+            wasmtime_error_t* error = nullptr;
+            {
+                WasmtimeMetrics::ScopedTimer call_timer(m_metrics, m_metric_id);
+                error = wasmtime_component_func_call(
+                    &m_func,
+                    m_context,
+                    arg_vals.data(), sizeof...(Args),
+                    result_vals.data(), RESULT_COUNT
+                );
+            }
+            if(error != nullptr)
+            {
+                if(m_metrics != nullptr)
+                {
+                    m_metrics->add(WasmtimeMetrics::TRAP_COUNT);
+                }
+                return wasmtime::Error(error);
+            }
+
+            if constexpr (std::is_void_v<R>)
+            {
+                return std::monostate{};
+            }
+            else
+            {
+                R result{};
+                if(WasmtimeValTraits<R>::lift(result_vals[0], result) == false)
+                {
+                    wasmtime_component_val_delete(&result_vals[0]);
+                    return wasmtime::Error(wasmtime_error_new("guest function result does not match the typed signature"));
+                }
+                return result;
+            }
+        }
+    private:
+        wasmtime_component_func_t m_func = {};
+        wasmtime_context_t* m_context = nullptr;
+        WasmtimeMetrics* m_metrics = nullptr;
+        WasmtimeMetrics::MetricId m_metric_id = WasmtimeMetrics::INVALID_METRIC;
+    };
+
+    /**
+     * @brief Owned value returned by an untyped guest call, empty for exports without a result
+     */
+    class WasmtimeCallResult final
+    {
+    public:
+        WasmtimeCallResult() = default;
+        WasmtimeCallResult(const WasmtimeCallResult&) = delete;
+        WasmtimeCallResult& operator=(const WasmtimeCallResult&) = delete;
+        WasmtimeCallResult(WasmtimeCallResult&& other) noexcept
+            : m_value(other.m_value), m_has_value(std::exchange(other.m_has_value, false))
+        {
+        }
+        WasmtimeCallResult& operator=(WasmtimeCallResult&& other) noexcept
+        {
+            if(this != &other)
+            {
+                reset();
+                m_value = other.m_value;
+                m_has_value = std::exchange(other.m_has_value, false);
+            }
+            return *this;
+        }
+        ~WasmtimeCallResult()
+        {
+            reset();
+        }
+
+        bool hasValue() const { return m_has_value; }
+        // Null for exports without a result, owned by this object
+        const wasmtime_component_val_t* getValue() const { return m_has_value ? &m_value : nullptr; }
+
+        // False when there is no result or it is not a T
+        template<typename T>
+        bool lift(T& value) const
+        {
+            return m_has_value && WasmtimeValTraits<T>::lift(m_value, value);
+        }
+    private:
+        friend class WasmtimeInstance;
+
+        void reset()
+        {
+            if(m_has_value)
+            {
+                wasmtime_component_val_delete(&m_value);
+                m_has_value = false;
+            }
+        }
+
+        wasmtime_component_val_t m_value = {};
+        bool m_has_value = false;
+    };
+
     /**
      * @brief Wasmtime-based script module implementation
      */
@@ -13,17 +200,64 @@ namespace Arieo
         : public Interface::Script::IInstance
     {
     public:
-        WasmtimeInstance(wasmtime::component::Instance&& instance, wasmtime::Store& store)
-            : m_instance(std::move(instance)), m_store(store)
+        // metrics is null while engine metrics are disabled
+        WasmtimeInstance(wasmtime::component::Instance&& instance, wasmtime::Store& store, WasmtimeModule& module, WasmtimeMetrics* metrics = nullptr)
+            : m_instance(std::move(instance)), m_store(store), m_module(module), m_metrics(metrics)
         {
         };
 
+        // Handles returned by queryInterface/queryFunction are WasmtimeExportEntry pointers owned by the
+        // module, they stay valid for every instance of that module until it is unloaded.
+
         void* queryInterface(const std::string& interface_name) override;
         void* queryFunction(void* interface, const std::string& function_name) override;
         void callFunction(void* function) override;
+        // callFunction handing back the guest's result or error instead of logging it
+        wasmtime::Result<WasmtimeCallResult> callFunctionWithResult(void* function);
+        // Untyped call of an export without parameters, without the busy check and fuel meter of callFunction
+        wasmtime::Result<WasmtimeCallResult> invokeFunction(void* function);
+
+        // Like queryInterface + queryFunction, for optional exports: returns null without logging when either is missing
+        void* findFunction(const std::string& interface_name, const std::string& function_name);
+
+        // Exports shaped func() -> list<u8> and func(list<u8>), used to hand guest state from one instance to another
+        wasmtime::Result<std::vector<std::uint8_t>> callFunctionReturningBytes(void* function);
+        wasmtime::Result<std::monostate> callFunctionWithBytes(void* function, std::span<const std::uint8_t> bytes);
+
+        // Context owning the store this instance lives in
+        WasmtimeContext* getContext();
+
+        // Adds a metered call of function to the module's fuel report
+        void recordFuel(void* function, std::uint64_t fuel_consumed, bool is_exhausted);
+
+        // Typed counterpart of callFunction, resolve once and call it every frame.
+        // Typed calls skip the busy check, only make them while getContext()->isEnterable().
+        template<typename Signature>
+        WasmtimeTypedFunction<Signature> getTypedFunction(void* function)
+        {
+            const wasmtime_component_func_t* func = resolveFunction(function);
+            if(func == nullptr)
+            {
+                return WasmtimeTypedFunction<Signature>();
+            }
+            return WasmtimeTypedFunction<Signature>(*func, m_store.context().capi(), m_metrics, getFunctionMetricId(function));
+        }
     private:
+        // Looks the function up on first use only, later calls hit the per-instance cache
+        const wasmtime_component_func_t* resolveFunction(void* function);
+        // Latency histogram "call/<interface>#<function>", only valid after resolveFunction succeeded
+        WasmtimeMetrics::MetricId getFunctionMetricId(void* function) const;
+
         wasmtime::component::Instance m_instance;
         wasmtime::Store& m_store;
+        WasmtimeModule& m_module;
+        // Indexed by WasmtimeExportEntry::slot
+        std::vector<std::optional<wasmtime_component_func_t>> m_function_slots;
+        WasmtimeMetrics* m_metrics = nullptr;
+        // Indexed like m_function_slots, 0 or 1 values returned by the export
+        std::vector<std::uint8_t> m_function_result_counts;
+        // Indexed like m_function_slots, only filled while metrics are enabled
+        std::vector<WasmtimeMetrics::MetricId> m_function_metric_ids;
     };
 }
 
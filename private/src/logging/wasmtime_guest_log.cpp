@@ -0,0 +1,384 @@
+#include "base/prerequisites.h"
+#include "wasmtime_guest_log.h"
+#include "core/logger/logger.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+namespace Arieo
+{
+    namespace
+    {
+        // A guest writing without newlines is forwarded in pieces of this size
+        constexpr size_t MAX_CAPTURED_LINE_SIZE = 4096;
+    }
+
+    void WasmtimeLogRateLimiter::reset(std::uint32_t rate, std::uint32_t burst)
+    {
+        m_rate = static_cast<double>(rate);
+        m_burst = static_cast<double>(burst == 0 ? rate : burst);
+        m_tokens = m_burst;
+        m_last_refill_time = std::chrono::steady_clock::now();
+    }
+
+    bool WasmtimeLogRateLimiter::tryAcquire(std::chrono::steady_clock::time_point now)
+    {
+        if(m_rate == 0.0)
+        {
+            return true;
+        }
+
+        std::chrono::duration<double> elapsed = now - m_last_refill_time;
+        m_last_refill_time = now;
+        m_tokens = std::min(m_burst, m_tokens + elapsed.count() * m_rate);
+        if(m_tokens < 1.0)
+        {
+            return false;
+        }
+        m_tokens -= 1.0;
+        return true;
+    }
+
+    WasmtimeGuestLogStream::WasmtimeGuestLogStream(WasmtimeGuestLogPipeline& pipeline, std::string context_name)
+        : m_pipeline(pipeline), m_config(pipeline.getConfig()), m_context_name(std::move(context_name))
+    {
+        size_t capacity = std::bit_ceil(std::max<size_t>(2, m_config.ring_capacity));
+        m_records.resize(capacity);
+        m_record_mask = capacity - 1;
+
+        m_log_rate_limiter.reset(m_config.rate_limit, m_config.rate_burst);
+        m_stdio_rate_limiter.reset(m_config.rate_limit, m_config.rate_burst);
+
+        if(m_config.is_capturing_stdio)
+        {
+            m_stdout_path = m_config.capture_dir / (m_context_name + ".stdout.log");
+            m_stderr_path = m_config.capture_dir / (m_context_name + ".stderr.log");
+            std::error_code ec;
+            std::filesystem::create_directories(m_config.capture_dir, ec);
+            // A file left by an earlier run would be forwarded again before WASI truncates it
+            std::filesystem::remove(m_stdout_path, ec);
+            std::filesystem::remove(m_stderr_path, ec);
+
+            m_capture_files[0].source = Source::Stdout;
+            m_capture_files[0].path = m_stdout_path;
+            m_capture_files[1].source = Source::Stderr;
+            m_capture_files[1].path = m_stderr_path;
+        }
+    }
+
+    WasmtimeGuestLogStream::~WasmtimeGuestLogStream()
+    {
+        for(CaptureFile& capture_file : m_capture_files)
+        {
+            if(capture_file.file != nullptr)
+            {
+                std::fclose(capture_file.file);
+                capture_file.file = nullptr;
+            }
+            if(capture_file.path.empty() == false)
+            {
+                // Everything in it was forwarded to the logger already
+                std::error_code ec;
+                std::filesystem::remove(capture_file.path, ec);
+            }
+        }
+    }
+
+    void WasmtimeGuestLogStream::setScriptName(std::string_view script_name)
+    {
+        std::lock_guard<std::mutex> lock(m_script_name_mutex);
+        m_script_name = script_name;
+    }
+
+    bool WasmtimeGuestLogStream::push(std::string_view message)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if(m_log_rate_limiter.tryAcquire(now) == false)
+        {
+            m_rate_limited_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        std::uint64_t write_index = m_write_index.load(std::memory_order_relaxed);
+        std::uint64_t read_index = m_read_index.load(std::memory_order_acquire);
+        if(write_index - read_index >= m_records.size())
+        {
+            if(m_config.overflow_policy == WasmtimeGuestLogConfig::OverflowPolicy::Block)
+            {
+                auto deadline = now + m_config.max_block_time;
+                m_pipeline.wake();
+                while(write_index - read_index >= m_records.size() && std::chrono::steady_clock::now() < deadline)
+                {
+                    std::this_thread::yield();
+                    read_index = m_read_index.load(std::memory_order_acquire);
+                }
+            }
+            if(write_index - read_index >= m_records.size())
+            {
+                m_overflow_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        Record& record = m_records[write_index & m_record_mask];
+        size_t size = std::min(message.size(), MAX_MESSAGE_SIZE);
+        std::memcpy(record.text, message.data(), size);
+        record.size = static_cast<std::uint16_t>(size);
+        record.is_truncated = size < message.size();
+        record.instance_id = m_instance_id;
+        m_write_index.store(write_index + 1, std::memory_order_release);
+
+        // Drain early once the ring is half full rather than waiting for the interval
+        if(write_index + 1 - read_index == m_records.size() / 2)
+        {
+            m_pipeline.wake();
+        }
+        return true;
+    }
+
+    void WasmtimeGuestLogStream::drain(bool is_final)
+    {
+        std::string script_name;
+        {
+            std::lock_guard<std::mutex> lock(m_script_name_mutex);
+            script_name = m_script_name.empty() ? m_context_name : m_script_name;
+        }
+
+        std::uint64_t read_index = m_read_index.load(std::memory_order_relaxed);
+        std::uint64_t write_index = m_write_index.load(std::memory_order_acquire);
+        while(read_index != write_index)
+        {
+            const Record& record = m_records[read_index & m_record_mask];
+            emit(Source::Log, script_name, record.instance_id, std::string_view(record.text, record.size), record.is_truncated);
+            // Released per record so a blocked guest resumes as soon as one slot is free
+            m_read_index.store(++read_index, std::memory_order_release);
+        }
+
+        for(CaptureFile& capture_file : m_capture_files)
+        {
+            drainCapture(capture_file, is_final, script_name);
+        }
+
+        std::uint64_t rate_limited_count = m_rate_limited_count.exchange(0, std::memory_order_relaxed) + std::exchange(m_stdio_rate_limited_count, 0);
+        std::uint64_t overflow_count = m_overflow_count.exchange(0, std::memory_order_relaxed);
+        if(rate_limited_count > 0 || overflow_count > 0)
+        {
+            Core::Logger::error("[WASM Guest {}] {} messages dropped by the rate limit, {} dropped on a full log ring",
+                script_name,
+                rate_limited_count,
+                overflow_count);
+        }
+    }
+
+    void WasmtimeGuestLogStream::drainCapture(CaptureFile& capture_file, bool is_final, std::string_view script_name)
+    {
+        if(capture_file.path.empty())
+        {
+            return;
+        }
+        if(capture_file.file == nullptr)
+        {
+            // Created by WASI when the context's store is set up, which may not have happened yet
+            capture_file.file = std::fopen(capture_file.path.string().c_str(), "rb");
+            if(capture_file.file == nullptr)
+            {
+                return;
+            }
+        }
+
+        auto forward = [this, &capture_file, script_name](std::string_view line)
+        {
+            if(line.empty() == false && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if(m_stdio_rate_limiter.tryAcquire(std::chrono::steady_clock::now()) == false)
+            {
+                m_stdio_rate_limited_count++;
+                return;
+            }
+            emit(capture_file.source, script_name, 0, line, false);
+        };
+
+        // The guest keeps appending, clear the end of file state left by the previous drain
+        std::clearerr(capture_file.file);
+        char buffer[4096];
+        size_t read_size = 0;
+        while((read_size = std::fread(buffer, 1, sizeof(buffer), capture_file.file)) > 0)
+        {
+            capture_file.partial_line.append(buffer, read_size);
+
+            size_t line_start = 0;
+            size_t line_end = 0;
+            while((line_end = capture_file.partial_line.find('\n', line_start)) != std::string::npos)
+            {
+                forward(std::string_view(capture_file.partial_line).substr(line_start, line_end - line_start));
+                line_start = line_end + 1;
+            }
+            capture_file.partial_line.erase(0, line_start);
+
+            if(capture_file.partial_line.size() >= MAX_CAPTURED_LINE_SIZE)
+            {
+                forward(capture_file.partial_line);
+                capture_file.partial_line.clear();
+            }
+        }
+
+        if(is_final && capture_file.partial_line.empty() == false)
+        {
+            forward(capture_file.partial_line);
+            capture_file.partial_line.clear();
+        }
+    }
+
+    void WasmtimeGuestLogStream::emit(Source source, std::string_view script_name, std::uint64_t instance_id, std::string_view message, bool is_truncated)
+    {
+        std::string_view truncated_suffix = is_truncated ? " [truncated]" : "";
+        switch(source)
+        {
+        case Source::Log:
+            Core::Logger::info("[WASM Guest {}#{}] {}{}", script_name, instance_id, message, truncated_suffix);
+            break;
+        case Source::Stdout:
+            Core::Logger::info("[WASM Guest {} stdout] {}", script_name, message);
+            break;
+        case Source::Stderr:
+            Core::Logger::error("[WASM Guest {} stderr] {}", script_name, message);
+            break;
+        }
+    }
+
+    void WasmtimeGuestLogPipeline::start(const WasmtimeGuestLogConfig& config)
+    {
+        if(isRunning())
+        {
+            return;
+        }
+        m_config = config;
+        m_is_stopping = false;
+        m_thread = std::thread(&WasmtimeGuestLogPipeline::drainMain, this);
+        Core::Logger::info("Guest log pipeline started: {} records per context, {} overflow, rate limit {}/s, stdio {}",
+            std::bit_ceil(std::max<size_t>(2, m_config.ring_capacity)),
+            m_config.overflow_policy == WasmtimeGuestLogConfig::OverflowPolicy::Block ? "block" : "drop",
+            m_config.rate_limit,
+            m_config.is_capturing_stdio ? m_config.capture_dir.string() : std::string("inherited"));
+    }
+
+    void WasmtimeGuestLogPipeline::stop()
+    {
+        if(isRunning() == false)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_wake_cv.notify_all();
+        m_thread.join();
+
+        // Streams closed after the last drain pass
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::erase_if(m_streams, [](WasmtimeGuestLogStream* stream)
+        {
+            if(stream->m_is_closed.load(std::memory_order_acquire) == false)
+            {
+                return false;
+            }
+            stream->drain(true);
+            Base::deleteT(stream);
+            return true;
+        });
+    }
+
+    WasmtimeGuestLogStream* WasmtimeGuestLogPipeline::openStream(const std::string& context_name)
+    {
+        if(isRunning() == false)
+        {
+            return nullptr;
+        }
+        WasmtimeGuestLogStream* stream = Base::newT<WasmtimeGuestLogStream>(*this, context_name);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_streams.push_back(stream);
+        return stream;
+    }
+
+    void WasmtimeGuestLogPipeline::closeStream(WasmtimeGuestLogStream* stream)
+    {
+        if(stream == nullptr)
+        {
+            return;
+        }
+        if(isRunning() == false)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                std::erase(m_streams, stream);
+            }
+            stream->drain(true);
+            Base::deleteT(stream);
+            return;
+        }
+        stream->m_is_closed.store(true, std::memory_order_release);
+        wake();
+    }
+
+    void WasmtimeGuestLogPipeline::wake()
+    {
+        m_is_wake_requested.store(true, std::memory_order_relaxed);
+        m_wake_cv.notify_one();
+    }
+
+    void WasmtimeGuestLogPipeline::drainMain()
+    {
+        std::vector<WasmtimeGuestLogStream*> streams;
+        std::vector<WasmtimeGuestLogStream*> closed_streams;
+        bool is_stopping = false;
+        while(is_stopping == false)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake_cv.wait_for(lock, m_config.drain_interval, [this]
+                {
+                    return m_is_stopping || m_is_wake_requested.load(std::memory_order_relaxed);
+                });
+                m_is_wake_requested.store(false, std::memory_order_relaxed);
+                is_stopping = m_is_stopping;
+                streams = m_streams;
+            }
+
+            // The logger is only reached from here, never while holding the mutex
+            closed_streams.clear();
+            for(WasmtimeGuestLogStream* stream : streams)
+            {
+                bool is_closed = stream->m_is_closed.load(std::memory_order_acquire);
+                stream->drain(is_closed || is_stopping);
+                if(is_closed)
+                {
+                    closed_streams.push_back(stream);
+                }
+            }
+
+            if(closed_streams.empty() == false)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    std::erase_if(m_streams, [&closed_streams](WasmtimeGuestLogStream* stream)
+                    {
+                        return std::find(closed_streams.begin(), closed_streams.end(), stream) != closed_streams.end();
+                    });
+                }
+                for(WasmtimeGuestLogStream* stream : closed_streams)
+                {
+                    Base::deleteT(stream);
+                }
+            }
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Guest log pipeline settings read from script_engine.guest_log
+     */
+    struct WasmtimeGuestLogConfig
+    {
+        enum class OverflowPolicy
+        {
+            // A full ring drops the new message, the guest never waits
+            Drop,
+            // The guest waits for the drain thread up to max_block_time, then drops
+            Block,
+        };
+
+        bool is_enabled = false;
+        // Records per context, rounded up to a power of two
+        size_t ring_capacity = 1024;
+        OverflowPolicy overflow_policy = OverflowPolicy::Drop;
+        std::chrono::microseconds max_block_time = std::chrono::microseconds(1000);
+        // Messages per second per context, 0 is unlimited. Applied separately to log calls and to stdio lines
+        std::uint32_t rate_limit = 0;
+        std::uint32_t rate_burst = 0;
+        std::chrono::milliseconds drain_interval = std::chrono::milliseconds(10);
+        // Redirects WASI stdout/stderr into files the drain thread forwards, instead of the host's own stdio.
+        // Off by default: every guest print is still a blocking file write on the thread running the guest,
+        // the rate limit only applies when the drain thread forwards the lines, and the files grow for the
+        // lifetime of the context. Guests that log heavily should use arieo:application/log, which goes
+        // through the ring.
+        bool is_capturing_stdio = false;
+        std::filesystem::path capture_dir = "script_logs";
+    };
+
+    /**
+     * @brief Token bucket, only ever touched by one thread
+     */
+    class WasmtimeLogRateLimiter final
+    {
+    public:
+        void reset(std::uint32_t rate, std::uint32_t burst);
+        bool tryAcquire(std::chrono::steady_clock::time_point now);
+    private:
+        double m_rate = 0.0;
+        double m_burst = 0.0;
+        double m_tokens = 0.0;
+        std::chrono::steady_clock::time_point m_last_refill_time;
+    };
+
+    class WasmtimeGuestLogPipeline;
+
+    /**
+     * @brief Guest log messages of one context, written by the thread running the context and read by the drain thread
+     *
+     * Records live in a fixed single-producer single-consumer ring, so logging from a guest copies the
+     * message into a slot and bumps an index. Messages longer than a slot are truncated.
+     */
+    class WasmtimeGuestLogStream final
+    {
+    public:
+        static constexpr size_t MAX_MESSAGE_SIZE = 224;
+
+        enum class Source : std::uint8_t
+        {
+            Log,
+            Stdout,
+            Stderr,
+        };
+
+        WasmtimeGuestLogStream(WasmtimeGuestLogPipeline& pipeline, std::string context_name);
+        ~WasmtimeGuestLogStream();
+
+        WasmtimeGuestLogStream(const WasmtimeGuestLogStream&) = delete;
+        WasmtimeGuestLogStream& operator=(const WasmtimeGuestLogStream&) = delete;
+
+        // Producer side, called from the thread running the context
+        bool push(std::string_view message);
+        // Tags later messages, set when an instance is created in the context
+        void setInstanceId(std::uint64_t instance_id) { m_instance_id = instance_id; }
+        // Any thread, shown in front of every message
+        void setScriptName(std::string_view script_name);
+
+        // Empty unless stdio is captured, handed to WASI when the context is created
+        const std::filesystem::path& getStdoutPath() const { return m_stdout_path; }
+        const std::filesystem::path& getStderrPath() const { return m_stderr_path; }
+    private:
+        friend class WasmtimeGuestLogPipeline;
+
+        struct Record
+        {
+            std::uint64_t instance_id = 0;
+            std::uint16_t size = 0;
+            bool is_truncated = false;
+            char text[MAX_MESSAGE_SIZE];
+        };
+
+        struct CaptureFile
+        {
+            Source source = Source::Stdout;
+            std::filesystem::path path;
+            std::FILE* file = nullptr;
+            // Bytes after the last newline, emitted once the line completes or the stream closes
+            std::string partial_line;
+        };
+
+        // Consumer side, called from the drain thread only
+        void drain(bool is_final);
+        void drainCapture(CaptureFile& capture_file, bool is_final, std::string_view script_name);
+        void emit(Source source, std::string_view script_name, std::uint64_t instance_id, std::string_view message, bool is_truncated);
+
+        WasmtimeGuestLogPipeline& m_pipeline;
+        const WasmtimeGuestLogConfig& m_config;
+        std::string m_context_name;
+        std::vector<Record> m_records;
+        size_t m_record_mask = 0;
+
+        alignas(64) std::atomic<std::uint64_t> m_write_index = 0;
+        alignas(64) std::atomic<std::uint64_t> m_read_index = 0;
+
+        // Producer only
+        alignas(64) std::uint64_t m_instance_id = 0;
+        WasmtimeLogRateLimiter m_log_rate_limiter;
+        // Producer increments, the drain thread reports and resets
+        std::atomic<std::uint64_t> m_rate_limited_count = 0;
+        std::atomic<std::uint64_t> m_overflow_count = 0;
+
+        // Consumer only
+        WasmtimeLogRateLimiter m_stdio_rate_limiter;
+        std::uint64_t m_stdio_rate_limited_count = 0;
+        std::filesystem::path m_stdout_path;
+        std::filesystem::path m_stderr_path;
+        CaptureFile m_capture_files[2];
+
+        mutable std::mutex m_script_name_mutex;
+        std::string m_script_name;
+
+        // Set by WasmtimeGuestLogPipeline::closeStream, the drain thread flushes and deletes the stream
+        std::atomic<bool> m_is_closed = false;
+    };
+
+    /**
+     * @brief Background thread forwarding guest log streams to Core::Logger
+     *
+     * Guests never reach the logger themselves, so a chatty script only costs its own thread a
+     * copy into the ring. Rate limited and dropped messages are reported as counts by the drain thread.
+     */
+    class WasmtimeGuestLogPipeline final
+    {
+    public:
+        void start(const WasmtimeGuestLogConfig& config);
+        // Flushes every stream and deletes the closed ones, streams closed later are flushed on the calling thread
+        void stop();
+
+        bool isRunning() const { return m_thread.joinable(); }
+        const WasmtimeGuestLogConfig& getConfig() const { return m_config; }
+
+        WasmtimeGuestLogStream* openStream(const std::string& context_name);
+        // Call after the context's store is dropped, the remaining records are flushed on the drain thread
+        void closeStream(WasmtimeGuestLogStream* stream);
+
+        // Wakes the drain thread before its interval, used by streams running short of space
+        void wake();
+    private:
+        void drainMain();
+
+        WasmtimeGuestLogConfig m_config;
+        std::mutex m_mutex;
+        std::condition_variable m_wake_cv;
+        bool m_is_stopping = false;
+        // Set without the mutex by producers, a missed wake only delays the drain to the next interval
+        std::atomic<bool> m_is_wake_requested = false;
+        std::vector<WasmtimeGuestLogStream*> m_streams;
+        std::thread m_thread;
+    };
+}
+
+
+
+
@@ -0,0 +1,202 @@
+#include "base/prerequisites.h"
+#include "wasmtime_metrics.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace Arieo
+{
+    namespace
+    {
+        std::atomic<std::uint64_t> s_metrics_generation = 0;
+
+        struct ThreadSlotBinding
+        {
+            std::uint64_t generation = 0;
+            void* slot = nullptr;
+        };
+        thread_local ThreadSlotBinding s_thread_slot_binding;
+
+        size_t getBucketIndex(std::uint64_t nanoseconds)
+        {
+            size_t bucket_index = nanoseconds == 0 ? 0 : static_cast<size_t>(std::bit_width(nanoseconds) - 1);
+            return std::min(bucket_index, WasmtimeMetrics::BUCKET_COUNT - 1);
+        }
+
+        // Single writer, a plain load and store avoids the locked instruction of fetch_add
+        void increment(std::atomic<std::uint64_t>& value, std::uint64_t delta)
+        {
+            value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+    }
+
+    WasmtimeMetrics::WasmtimeMetrics()
+        : m_generation(++s_metrics_generation)
+    {
+        registerMetric("compile_time", Kind::Histogram);
+        registerMetric("deserialize_time", Kind::Histogram);
+        registerMetric("instantiate_time", Kind::Histogram);
+        registerMetric("trap_count", Kind::Counter);
+        registerMetric("store_memory_bytes", Kind::Gauge);
+    }
+
+    WasmtimeMetrics::~WasmtimeMetrics()
+    {
+        for(std::unique_ptr<ThreadSlot>& thread_slot : m_thread_slots)
+        {
+            for(std::atomic<Block*>& block : thread_slot->blocks)
+            {
+                Base::deleteT(block.load());
+            }
+        }
+    }
+
+    WasmtimeMetrics::MetricId WasmtimeMetrics::registerMetric(std::string_view name, Kind kind)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_metric_ids.find(std::string(name));
+        if(iter != m_metric_ids.end())
+        {
+            return iter->second;
+        }
+        if(m_metric_infos.size() >= MAX_METRIC_COUNT)
+        {
+            return INVALID_METRIC;
+        }
+
+        MetricId metric_id = static_cast<MetricId>(m_metric_infos.size());
+        m_metric_infos.push_back(MetricInfo{std::string(name), kind});
+        m_metric_ids.emplace(std::string(name), metric_id);
+        return metric_id;
+    }
+
+    void WasmtimeMetrics::add(MetricId metric_id, std::uint64_t value)
+    {
+        Cell* cell = getCell(metric_id);
+        if(cell != nullptr)
+        {
+            increment(cell->count, value);
+        }
+    }
+
+    void WasmtimeMetrics::record(MetricId metric_id, std::chrono::nanoseconds elapsed)
+    {
+        Cell* cell = getCell(metric_id);
+        if(cell == nullptr)
+        {
+            return;
+        }
+
+        std::uint64_t nanoseconds = static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed.count()));
+        increment(cell->count, 1);
+        increment(cell->sum, nanoseconds);
+        increment(cell->buckets[getBucketIndex(nanoseconds)], 1);
+        if(nanoseconds > cell->max.load(std::memory_order_relaxed))
+        {
+            cell->max.store(nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    void WasmtimeMetrics::setGauge(MetricId metric_id, std::uint64_t value)
+    {
+        if(metric_id < MAX_METRIC_COUNT)
+        {
+            m_gauges[metric_id].store(value, std::memory_order_relaxed);
+        }
+    }
+
+    WasmtimeMetrics::Cell* WasmtimeMetrics::getCell(MetricId metric_id)
+    {
+        if(metric_id >= MAX_METRIC_COUNT)
+        {
+            return nullptr;
+        }
+
+        if(s_thread_slot_binding.generation != m_generation)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_thread_slots.push_back(std::make_unique<ThreadSlot>());
+            s_thread_slot_binding.generation = m_generation;
+            s_thread_slot_binding.slot = m_thread_slots.back().get();
+        }
+
+        ThreadSlot* thread_slot = static_cast<ThreadSlot*>(s_thread_slot_binding.slot);
+        std::atomic<Block*>& block = thread_slot->blocks[metric_id / BLOCK_SIZE];
+        Block* block_ptr = block.load(std::memory_order_acquire);
+        if(block_ptr == nullptr)
+        {
+            block_ptr = Base::newT<Block>();
+            block.store(block_ptr, std::memory_order_release);
+        }
+        return &block_ptr->cells[metric_id % BLOCK_SIZE];
+    }
+
+    std::vector<WasmtimeMetrics::Snapshot> WasmtimeMetrics::collect() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Snapshot> snapshots;
+        for(MetricId metric_id = 0; metric_id < m_metric_infos.size(); ++metric_id)
+        {
+            Snapshot snapshot;
+            snapshot.name = m_metric_infos[metric_id].name;
+            snapshot.kind = m_metric_infos[metric_id].kind;
+
+            if(snapshot.kind == Kind::Gauge)
+            {
+                snapshot.count = m_gauges[metric_id].load(std::memory_order_relaxed);
+                snapshots.push_back(std::move(snapshot));
+                continue;
+            }
+
+            std::array<std::uint64_t, BUCKET_COUNT> buckets = {};
+            for(const std::unique_ptr<ThreadSlot>& thread_slot : m_thread_slots)
+            {
+                const Block* block = thread_slot->blocks[metric_id / BLOCK_SIZE].load(std::memory_order_acquire);
+                if(block == nullptr)
+                {
+                    continue;
+                }
+                const Cell& cell = block->cells[metric_id % BLOCK_SIZE];
+                snapshot.count += cell.count.load(std::memory_order_relaxed);
+                snapshot.sum_ns += cell.sum.load(std::memory_order_relaxed);
+                snapshot.max_ns = std::max(snapshot.max_ns, cell.max.load(std::memory_order_relaxed));
+                for(size_t i = 0; i < BUCKET_COUNT; ++i)
+                {
+                    buckets[i] += cell.buckets[i].load(std::memory_order_relaxed);
+                }
+            }
+
+            if(snapshot.count == 0)
+            {
+                continue;
+            }
+
+            if(snapshot.kind == Kind::Histogram)
+            {
+                std::uint64_t p50_rank = (snapshot.count + 1) / 2;
+                std::uint64_t p99_rank = std::max<std::uint64_t>(1, snapshot.count * 99 / 100);
+                std::uint64_t seen = 0;
+                for(size_t i = 0; i < BUCKET_COUNT; ++i)
+                {
+                    seen += buckets[i];
+                    std::uint64_t bucket_upper_bound = std::uint64_t(2) << i;
+                    if(snapshot.p50_ns == 0 && seen >= p50_rank)
+                    {
+                        snapshot.p50_ns = std::min(bucket_upper_bound, snapshot.max_ns);
+                    }
+                    if(seen >= p99_rank)
+                    {
+                        snapshot.p99_ns = std::min(bucket_upper_bound, snapshot.max_ns);
+                        break;
+                    }
+                }
+            }
+            snapshots.push_back(std::move(snapshot));
+        }
+        return snapshots;
+    }
+}
+
+
+
+
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Counters, gauges and latency histograms of the script engine hot paths
+     *
+     * Every thread records into its own slot without atomic read-modify-write, collect() sums the
+     * slots. Metrics are registered by name on cold paths (module load, export resolution, linker
+     * registration) and recorded by id. Call sites hold a null WasmtimeMetrics pointer while metrics
+     * are disabled, so the disabled cost is one branch.
+     */
+    class WasmtimeMetrics final
+    {
+    public:
+        using MetricId = std::uint32_t;
+        static constexpr MetricId INVALID_METRIC = ~MetricId(0);
+
+        static constexpr size_t BLOCK_SIZE = 64;
+        static constexpr size_t MAX_BLOCK_COUNT = 16;
+        static constexpr size_t MAX_METRIC_COUNT = BLOCK_SIZE * MAX_BLOCK_COUNT;
+        // Power of two nanosecond buckets, the last one also holds everything above ~2 s
+        static constexpr size_t BUCKET_COUNT = 32;
+
+        enum class Kind
+        {
+            Counter,
+            Gauge,
+            Histogram,
+        };
+
+        // Registered first, in this order, so their ids are constants
+        enum BuiltinMetric : MetricId
+        {
+            COMPILE_TIME = 0,
+            DESERIALIZE_TIME,
+            INSTANTIATE_TIME,
+            TRAP_COUNT,
+            STORE_MEMORY_BYTES,
+            BUILTIN_METRIC_COUNT,
+        };
+
+        WasmtimeMetrics();
+        ~WasmtimeMetrics();
+
+        // Returns the existing id when name is already registered, INVALID_METRIC once the table is full
+        MetricId registerMetric(std::string_view name, Kind kind);
+
+        void add(MetricId metric_id, std::uint64_t value = 1);
+        void record(MetricId metric_id, std::chrono::nanoseconds elapsed);
+        void setGauge(MetricId metric_id, std::uint64_t value);
+
+        struct Snapshot
+        {
+            std::string name;
+            Kind kind = Kind::Counter;
+            // Counter total, gauge value or histogram sample count
+            std::uint64_t count = 0;
+            std::uint64_t sum_ns = 0;
+            std::uint64_t max_ns = 0;
+            // Upper bound of the bucket holding the percentile
+            std::uint64_t p50_ns = 0;
+            std::uint64_t p99_ns = 0;
+        };
+        // Metrics that were never recorded are skipped
+        std::vector<Snapshot> collect() const;
+
+        /**
+         * @brief Records the time until destruction into a histogram, a no-op for a null metrics pointer
+         */
+        class ScopedTimer final
+        {
+        public:
+            ScopedTimer(WasmtimeMetrics* metrics, MetricId metric_id)
+                : m_metrics(metrics), m_metric_id(metric_id)
+            {
+                if(m_metrics != nullptr)
+                {
+                    m_start_time = std::chrono::steady_clock::now();
+                }
+            }
+            ~ScopedTimer()
+            {
+                if(m_metrics != nullptr)
+                {
+                    m_metrics->record(m_metric_id, std::chrono::steady_clock::now() - m_start_time);
+                }
+            }
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        private:
+            WasmtimeMetrics* m_metrics;
+            MetricId m_metric_id;
+            std::chrono::steady_clock::time_point m_start_time;
+        };
+    private:
+        struct Cell
+        {
+            std::atomic<std::uint64_t> count = 0;
+            std::atomic<std::uint64_t> sum = 0;
+            std::atomic<std::uint64_t> max = 0;
+            std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets = {};
+        };
+        struct Block
+        {
+            std::array<Cell, BLOCK_SIZE> cells;
+        };
+        // Only the owning thread writes, blocks are allocated when the thread first touches them
+        struct ThreadSlot
+        {
+            std::array<std::atomic<Block*>, MAX_BLOCK_COUNT> blocks = {};
+        };
+        struct MetricInfo
+        {
+            std::string name;
+            Kind kind;
+        };
+
+        Cell* getCell(MetricId metric_id);
+
+        mutable std::mutex m_mutex;
+        std::vector<MetricInfo> m_metric_infos;
+        std::unordered_map<std::string, MetricId> m_metric_ids;
+        std::vector<std::unique_ptr<ThreadSlot>> m_thread_slots;
+        std::array<std::atomic<std::uint64_t>, MAX_METRIC_COUNT> m_gauges = {};
+        // Distinguishes engines created one after another on the same threads
+        std::uint64_t m_generation;
+    };
+}
+
+
+
+
@@ -1,7 +1,177 @@
 #include "base/prerequisites.h"
 #include "wasmtime_module.h"
 #include "core/logger/logger.h"
+#include "../utility/wasmtime_hash.h"
 
+#include <algorithm>
+#include <format>
+
+namespace Arieo
+{
+    WasmtimeModule::~WasmtimeModule()
+    {
+        for(WasmtimeExportEntry& export_entry : m_export_entries)
+        {
+            wasmtime_component_export_index_delete(export_entry.export_index);
+        }
+        m_export_entries.clear();
+        m_export_table.clear();
+
+        m_instance_pre.reset();
+    }
+
+    wasmtime::Result<WasmtimeModule::InstancePre> WasmtimeModule::getInstancePre(wasmtime::component::Linker& linker, std::uint64_t linker_generation)
+    {
+        std::lock_guard<std::mutex> lock(m_instance_pre_mutex);
+        if(m_instance_pre != nullptr && m_instance_pre_linker_generation == linker_generation)
+        {
+            return m_instance_pre;
+        }
+
+        if(m_instance_pre != nullptr)
+        {
+            // Instantiations still running on other threads keep the old one alive until they return
+            Core::Logger::trace("Linker changed since module was pre-linked, resolving imports again");
+            m_instance_pre.reset();
+        }
+
+        // Resolve every import against the linker once, instantiation afterwards only allocates and runs init
+        wasmtime_component_instance_pre_t* instance_pre = nullptr;
+        wasmtime_error_t* error = wasmtime_component_linker_instantiate_pre(
+            linker.capi(),
+            m_component.capi(),
+            &instance_pre
+        );
+        if(error != nullptr)
+        {
+            return wasmtime::Error(error);
+        }
+
+        m_instance_pre = InstancePre(instance_pre, [](const wasmtime_component_instance_pre_t* released_instance_pre)
+        {
+            wasmtime_component_instance_pre_delete(const_cast<wasmtime_component_instance_pre_t*>(released_instance_pre));
+        });
+        m_instance_pre_linker_generation = linker_generation;
+        return m_instance_pre;
+    }
+
+    std::uint64_t WasmtimeModule::getExportKeyHash(const WasmtimeExportEntry* parent, std::string_view name)
+    {
+        if(parent == nullptr)
+        {
+            return WasmtimeHash::hashString(name);
+        }
+        // Continue the parent hash so the key is the hash of "interface/function"
+        return WasmtimeHash::hashString(name, WasmtimeHash::hashString("/", parent->key_hash));
+    }
+
+    const WasmtimeExportEntry* WasmtimeModule::resolveExport(const WasmtimeExportEntry* parent, std::string_view name)
+    {
+        std::uint64_t key_hash = getExportKeyHash(parent, name);
+        auto find_entry = [this, key_hash, parent, name]() -> WasmtimeExportEntry*
+        {
+            auto found_entry_iter = m_export_table.find(key_hash);
+            if(found_entry_iter == m_export_table.end())
+            {
+                return nullptr;
+            }
+            for(WasmtimeExportEntry* export_entry = found_entry_iter->second; export_entry != nullptr; export_entry = export_entry->next_collision)
+            {
+                if(export_entry->parent == parent && export_entry->name == name)
+                {
+                    return export_entry;
+                }
+            }
+            return nullptr;
+        };
+
+        {
+            std::shared_lock<std::shared_mutex> lock(m_export_mutex);
+            if(WasmtimeExportEntry* export_entry = find_entry())
+            {
+                return export_entry;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_export_mutex);
+        if(WasmtimeExportEntry* export_entry = find_entry())
+        {
+            return export_entry;
+        }
+
+        // Component level export indices are valid for every instance of this component
+        wasmtime_component_export_index_t* export_index = wasmtime_component_get_export_index(
+            m_component.capi(),
+            parent != nullptr ? parent->export_index : nullptr,
+            name.data(),
+            name.size()
+        );
+        if(export_index == nullptr)
+        {
+            return nullptr;
+        }
+
+        WasmtimeExportEntry& export_entry = m_export_entries.emplace_back();
+        export_entry.key_hash = key_hash;
+        export_entry.name = name;
+        export_entry.parent = parent;
+        export_entry.export_index = export_index;
+        export_entry.slot = m_export_entries.size() - 1;
+
+        auto [table_iter, is_inserted] = m_export_table.emplace(key_hash, &export_entry);
+        if(is_inserted == false)
+        {
+            export_entry.next_collision = table_iter->second;
+            table_iter->second = &export_entry;
+        }
+        return &export_entry;
+    }
+
+    size_t WasmtimeModule::getExportSlotCount() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m_export_mutex);
+        return m_export_entries.size();
+    }
+
+    void WasmtimeModule::recordFuel(const WasmtimeExportEntry* function_entry, std::uint64_t fuel_consumed, bool is_exhausted)
+    {
+        if(function_entry == nullptr)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_fuel_mutex);
+        if(function_entry->slot >= m_fuel_costs.size())
+        {
+            m_fuel_costs.resize(function_entry->slot + 1);
+        }
+        FuelCost& fuel_cost = m_fuel_costs[function_entry->slot];
+        if(fuel_cost.function_name.empty())
+        {
+            fuel_cost.function_name = function_entry->parent != nullptr
+                ? std::format("{}#{}", function_entry->parent->name, function_entry->name)
+                : function_entry->name;
+        }
+        fuel_cost.call_count++;
+        fuel_cost.total_fuel += fuel_consumed;
+        fuel_cost.max_fuel = std::max(fuel_cost.max_fuel, fuel_consumed);
+        fuel_cost.exhausted_count += is_exhausted ? 1 : 0;
+    }
+
+    std::vector<WasmtimeModule::FuelCost> WasmtimeModule::getFuelReport() const
+    {
+        std::lock_guard<std::mutex> lock(m_fuel_mutex);
+        std::vector<FuelCost> fuel_report;
+        for(const FuelCost& fuel_cost : m_fuel_costs)
+        {
+            if(fuel_cost.call_count > 0)
+            {
+                fuel_report.push_back(fuel_cost);
+            }
+        }
+        return fuel_report;
+    }
+}
 
 
 
@@ -3,8 +3,32 @@
 #include "interface/script/script.h"
 #include <wasmtime.hh>
 #include <wasmtime/component.hh>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 namespace Arieo
 {
+    /**
+     * @brief Interned component export, shared by every instance of the module that resolved it
+     */
+    struct WasmtimeExportEntry
+    {
+        // Hash of "interface" for root exports and of "interface/function" for nested ones
+        std::uint64_t key_hash = 0;
+        std::string name;
+        const WasmtimeExportEntry* parent = nullptr;
+        wasmtime_component_export_index_t* export_index = nullptr;
+        // Dense index instances use to cache per-store state of this export
+        size_t slot = 0;
+        // Next entry whose key_hash collides with this one
+        WasmtimeExportEntry* next_collision = nullptr;
+    };
+
     /**
      * @brief Wasmtime-based script module implementation
      */
@@ -15,10 +39,52 @@ namespace Arieo
             : m_component(std::move(component))
         {
         };
+        ~WasmtimeModule();
+
+        using InstancePre = std::shared_ptr<const wasmtime_component_instance_pre_t>;
+        // Returns the component pre-linked against the linker, relinking only when the linker has changed since the last call.
+        // Hold the result for the whole instantiation, a relink on another thread only drops the module's reference.
+        wasmtime::Result<InstancePre> getInstancePre(wasmtime::component::Linker& linker, std::uint64_t linker_generation);
+
+        // Resolves an export against the component once, repeat lookups are a hash probe without allocation.
+        // Pass parent == nullptr for root exports such as interfaces.
+        const WasmtimeExportEntry* resolveExport(const WasmtimeExportEntry* parent, std::string_view name);
+        size_t getExportSlotCount() const;
+
+        static std::uint64_t getExportKeyHash(const WasmtimeExportEntry* parent, std::string_view name);
+
+        struct FuelCost
+        {
+            // "interface#function", or the export name for root functions
+            std::string function_name;
+            std::uint64_t call_count = 0;
+            std::uint64_t total_fuel = 0;
+            std::uint64_t max_fuel = 0;
+            std::uint64_t exhausted_count = 0;
+        };
+        // Accumulated over every instance of the module, from any thread
+        void recordFuel(const WasmtimeExportEntry* function_entry, std::uint64_t fuel_consumed, bool is_exhausted);
+        // Functions called at least once under fuel metering, in export resolution order
+        std::vector<FuelCost> getFuelReport() const;
     private:
         friend class WasmtimeEngine;
         friend class WasmtimeContext;
         wasmtime::component::Component m_component;
+
+        std::mutex m_instance_pre_mutex;
+        InstancePre m_instance_pre;
+        std::uint64_t m_instance_pre_linker_generation = 0;
+
+        mutable std::shared_mutex m_export_mutex;
+        std::deque<WasmtimeExportEntry> m_export_entries;
+        std::unordered_map<std::uint64_t, WasmtimeExportEntry*> m_export_table;
+
+        // Signatures of the host functions this component imports are handed to the host call batch once
+        std::once_flag m_host_call_batch_once;
+
+        mutable std::mutex m_fuel_mutex;
+        // Indexed by WasmtimeExportEntry::slot
+        std::vector<FuelCost> m_fuel_costs;
     };
 }
 
@@ -0,0 +1,76 @@
+#include "base/prerequisites.h"
+#include "wasmtime_module_loader.h"
+#include "core/logger/logger.h"
+
+namespace Arieo
+{
+    void WasmtimeModuleLoader::start(size_t worker_count)
+    {
+        if(isRunning() || worker_count == 0)
+        {
+            return;
+        }
+        m_is_stopping = false;
+        m_workers.reserve(worker_count);
+        for(size_t i = 0; i < worker_count; ++i)
+        {
+            m_workers.emplace_back(&WasmtimeModuleLoader::workerMain, this);
+        }
+        Core::Logger::info("Wasmtime module loader started with {} workers", worker_count);
+    }
+
+    void WasmtimeModuleLoader::stop()
+    {
+        if(isRunning() == false)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_queue_cv.notify_all();
+        for(std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+    }
+
+    void WasmtimeModuleLoader::enqueue(std::packaged_task<Result()>&& load_task)
+    {
+        if(isRunning() == false)
+        {
+            load_task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(load_task));
+        }
+        m_queue_cv.notify_one();
+    }
+
+    void WasmtimeModuleLoader::workerMain()
+    {
+        while(true)
+        {
+            std::packaged_task<Result()> load_task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queue_cv.wait(lock, [this] { return m_is_stopping || m_queue.empty() == false; });
+                if(m_queue.empty())
+                {
+                    return;
+                }
+                load_task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            load_task();
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "interface/script/script.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Worker threads compiling and deserializing script modules off the calling thread
+     *
+     * Each load runs start to finish on one worker, so several components compile concurrently
+     * while Cranelift additionally splits each of them across functions when the engine profile
+     * enables parallel_compilation. Loads submitted while no worker runs complete inline.
+     */
+    class WasmtimeModuleLoader final
+    {
+    public:
+        using Result = Base::Interop::RawRef<Interface::Script::IModule>;
+        // Ready once the module is loaded, holds null when loading failed
+        using Future = std::shared_future<Result>;
+
+        void start(size_t worker_count);
+        // Queued loads are finished first, their modules still belong to whoever holds the futures
+        void stop();
+
+        bool isRunning() const { return m_workers.empty() == false; }
+        size_t getWorkerCount() const { return m_workers.size(); }
+
+        template<typename LoadFunction>
+        Future submit(LoadFunction&& load_function)
+        {
+            std::packaged_task<Result()> load_task(std::forward<LoadFunction>(load_function));
+            Future future = load_task.get_future().share();
+            enqueue(std::move(load_task));
+            return future;
+        }
+
+        // Runs other work that belongs next to loads on the same workers, queued behind loads submitted earlier
+        template<typename JobFunction>
+        std::future<std::invoke_result_t<JobFunction>> submitJob(JobFunction&& job_function)
+        {
+            using JobResult = std::invoke_result_t<JobFunction>;
+            auto job_task = std::make_shared<std::packaged_task<JobResult()>>(std::forward<JobFunction>(job_function));
+            std::future<JobResult> future = job_task->get_future();
+            enqueue(std::packaged_task<Result()>([job_task]() -> Result
+            {
+                (*job_task)();
+                return nullptr;
+            }));
+            return future;
+        }
+    private:
+        void enqueue(std::packaged_task<Result()>&& load_task);
+        void workerMain();
+
+        std::mutex m_mutex;
+        std::condition_variable m_queue_cv;
+        bool m_is_stopping = false;
+        std::deque<std::packaged_task<Result()>> m_queue;
+        std::vector<std::thread> m_workers;
+    };
+}
+
+
+
+
@@ -0,0 +1,123 @@
+#include "base/prerequisites.h"
+#include "wasmtime_module_registry.h"
+#include "wasmtime_module.h"
+
+#include <format>
+
+namespace Arieo
+{
+    std::string WasmtimeModuleRegistry::getBinaryKey(const WasmtimeSha256::Digest& content_digest, size_t data_size)
+    {
+        return std::format("binary:{}:{}", WasmtimeSha256::toHexString(content_digest), data_size);
+    }
+
+    std::string WasmtimeModuleRegistry::getFileKey(const std::string& absolute_path, std::int64_t write_time)
+    {
+        return std::format("precompiled-file:{}:{}", write_time, absolute_path);
+    }
+
+    WasmtimeModule* WasmtimeModuleRegistry::acquire(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto iter = m_entries.find(key);
+        if(iter == m_entries.end())
+        {
+            return nullptr;
+        }
+        iter->second.reference_count++;
+        m_shared_load_count++;
+        return iter->second.module;
+    }
+
+    WasmtimeModule* WasmtimeModuleRegistry::add(const std::string& key, WasmtimeModule* module)
+    {
+        if(module == nullptr)
+        {
+            return nullptr;
+        }
+
+        WasmtimeModule* duplicate_module = nullptr;
+        WasmtimeModule* registered_module = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto [iter, is_inserted] = m_entries.try_emplace(key, Entry{module, 0});
+            iter->second.reference_count++;
+            registered_module = iter->second.module;
+            if(is_inserted)
+            {
+                m_module_keys.emplace(module, key);
+            }
+            else
+            {
+                m_shared_load_count++;
+                duplicate_module = module;
+            }
+        }
+
+        if(duplicate_module != nullptr)
+        {
+            Base::deleteT(duplicate_module);
+        }
+        return registered_module;
+    }
+
+    bool WasmtimeModuleRegistry::release(WasmtimeModule* module)
+    {
+        if(module == nullptr)
+        {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto key_iter = m_module_keys.find(module);
+            if(key_iter == m_module_keys.end())
+            {
+                // Already freed by clear(), or never loaded by this engine
+                return false;
+            }
+            auto entry_iter = m_entries.find(key_iter->second);
+            if(--entry_iter->second.reference_count > 0)
+            {
+                return false;
+            }
+            m_entries.erase(entry_iter);
+            m_module_keys.erase(key_iter);
+        }
+
+        Base::deleteT(module);
+        return true;
+    }
+
+    size_t WasmtimeModuleRegistry::clear()
+    {
+        std::unordered_map<std::string, Entry> entries;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            entries.swap(m_entries);
+            m_module_keys.clear();
+        }
+        for(auto& [key, entry] : entries)
+        {
+            Base::deleteT(entry.module);
+        }
+        return entries.size();
+    }
+
+    WasmtimeModuleRegistry::Statistics WasmtimeModuleRegistry::getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Statistics statistics;
+        statistics.module_count = m_entries.size();
+        for(const auto& [key, entry] : m_entries)
+        {
+            statistics.reference_count += entry.reference_count;
+        }
+        statistics.shared_load_count = m_shared_load_count;
+        return statistics;
+    }
+}
+
+
+
+
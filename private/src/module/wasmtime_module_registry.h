@@ -0,0 +1,65 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "../utility/wasmtime_sha256.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Arieo
+{
+    class WasmtimeModule;
+
+    /**
+     * @brief Loaded modules keyed by content, so every context running the same script shares one compiled component
+     *
+     * Keys spell out the full identity of what was loaded instead of hashing it down, two different
+     * binaries never share a key and so never get each other's compiled code.
+     *
+     * Each load of a registered key hands out the same WasmtimeModule and takes a reference, unloading
+     * drops one. The compiled code, its pre-linked instance and its export table are freed with the
+     * last reference.
+     */
+    class WasmtimeModuleRegistry final
+    {
+    public:
+        // Content key of a component binary, precompiled or not, from its WasmtimeSha256::hashBytes
+        static std::string getBinaryKey(const WasmtimeSha256::Digest& content_digest, size_t data_size);
+        // Key of an artifact mapped from disk, by its absolute path and write time so a rewritten artifact loads anew
+        static std::string getFileKey(const std::string& absolute_path, std::int64_t write_time);
+
+        // The registered module with one more reference, null when nothing is registered under key
+        WasmtimeModule* acquire(const std::string& key);
+        // Registers a freshly loaded module with one reference. When a concurrent load registered key first,
+        // module is deleted and the registered one is returned with one more reference instead.
+        WasmtimeModule* add(const std::string& key, WasmtimeModule* module);
+        // Drops one reference and returns true when that deleted the module, unknown modules are ignored
+        bool release(WasmtimeModule* module);
+        // Deletes every module still registered, returns how many there were. Later releases of them are ignored.
+        size_t clear();
+
+        struct Statistics
+        {
+            size_t module_count = 0;
+            size_t reference_count = 0;
+            std::uint64_t shared_load_count = 0;
+        };
+        Statistics getStatistics() const;
+    private:
+        struct Entry
+        {
+            WasmtimeModule* module = nullptr;
+            size_t reference_count = 0;
+        };
+
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, Entry> m_entries;
+        std::unordered_map<const WasmtimeModule*, std::string> m_module_keys;
+        std::uint64_t m_shared_load_count = 0;
+    };
+}
+
+
+
+
@@ -1,5 +1,7 @@
 #include "base/prerequisites.h"
 #include "core/core.h"
+#include "core/config/config.h"
+#include "core/manifest/manifest.h"
 #include "engine/wasmtime_engine.h"
 #include "interface/main/main_module.h"
 #include "script_manager.h"
@@ -19,14 +21,19 @@ ARIEO_DLLEXPORT void ModuleMain()
 
         DllLoader()
         {
-            wasmtime_engine_instance.initialize();
+            Base::Interop::SharedRef<Interface::Main::IMainModule> main_module = Core::ModuleManager::getInterface<Interface::Main::IMainModule>();
+
+            // Engine settings are read from the same system node as script_entry and linkers
+            Core::Manifest manifest;
+            std::string manifest_rv = main_module->getManifestContext();
+            manifest.loadFromString(manifest_rv.getString());
+            wasmtime_engine_instance.initialize(manifest.getSystemNode());
 
             Core::ModuleManager::registerInterface<Interface::Script::IScriptEngine>(
                 "wasmtime",
                 wasmtime_engine
             );
 
-            Base::Interop::SharedRef<Interface::Main::IMainModule> main_module = Core::ModuleManager::getInterface<Interface::Main::IMainModule>();
             main_module->registerTickable(script_manager);
         }
 
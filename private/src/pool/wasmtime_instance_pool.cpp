@@ -0,0 +1,203 @@
+#include "base/prerequisites.h"
+#include "wasmtime_instance_pool.h"
+#include "core/logger/logger.h"
+
+#include "../engine/wasmtime_engine.h"
+#include "../instance/wasmtime_instance.h"
+
+#include <algorithm>
+
+namespace Arieo
+{
+    WasmtimeInstancePool::WasmtimeInstancePool(WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module, const Config& config)
+        : m_engine(engine),
+          m_module(module),
+          m_config(config),
+          m_idle_target(config.min_idle_count),
+          m_demand_window_start(std::chrono::steady_clock::now())
+    {
+        m_config.max_idle_count = std::max(m_config.max_idle_count, m_config.min_idle_count);
+        m_worker_thread = std::thread(&WasmtimeInstancePool::workerMain, this);
+    }
+
+    WasmtimeInstancePool::~WasmtimeInstancePool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_stopping = true;
+        }
+        m_worker_cv.notify_all();
+        m_worker_thread.join();
+
+        if(m_in_use_slots.empty() == false)
+        {
+            Core::Logger::error("Destroying instance pool with {} instances still acquired", m_in_use_slots.size());
+        }
+
+        for(Slot& slot : m_idle_slots)
+        {
+            destroySlot(slot);
+        }
+        for(Slot& slot : m_released_slots)
+        {
+            destroySlot(slot);
+        }
+        for(auto& [instance, slot] : m_in_use_slots)
+        {
+            destroySlot(slot);
+        }
+    }
+
+    Base::Interop::RawRef<Interface::Script::IInstance> WasmtimeInstancePool::acquire()
+    {
+        Slot slot;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_statistics.acquire_count++;
+            m_demand_window_acquire_count++;
+            updateIdleTargetLocked(std::chrono::steady_clock::now());
+
+            if(m_idle_slots.empty() == false)
+            {
+                slot = m_idle_slots.front();
+                m_idle_slots.pop_front();
+                m_statistics.idle_hit_count++;
+            }
+            else
+            {
+                m_statistics.on_demand_count++;
+            }
+        }
+        // Let the worker top the idle list up again off the critical path
+        m_worker_cv.notify_one();
+
+        if(slot.instance == nullptr && createSlot(slot) == false)
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_in_use_slots.emplace(slot.instance.castToInstance<WasmtimeInstance>(), slot);
+        return slot.instance;
+    }
+
+    void WasmtimeInstancePool::release(Base::Interop::RawRef<Interface::Script::IInstance> instance)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto found_slot_iter = m_in_use_slots.find(instance.castToInstance<WasmtimeInstance>());
+            if(found_slot_iter == m_in_use_slots.end())
+            {
+                Core::Logger::error("Releasing an instance that was not acquired from this pool");
+                return;
+            }
+            m_released_slots.push_back(found_slot_iter->second);
+            m_in_use_slots.erase(found_slot_iter);
+        }
+        m_worker_cv.notify_one();
+    }
+
+    WasmtimeInstancePool::Statistics WasmtimeInstancePool::getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Statistics statistics = m_statistics;
+        statistics.idle_count = m_idle_slots.size();
+        statistics.in_use_count = m_in_use_slots.size();
+        statistics.idle_target = m_idle_target;
+        return statistics;
+    }
+
+    bool WasmtimeInstancePool::createSlot(Slot& slot)
+    {
+        slot.context = m_engine.createContext();
+        slot.instance = m_engine.createInstance(slot.context, m_module);
+        if(slot.instance == nullptr)
+        {
+            Core::Logger::error("Instance pool failed to instantiate module");
+            m_engine.destroyContext(slot.context);
+            slot.context = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    void WasmtimeInstancePool::destroySlot(Slot& slot)
+    {
+        if(slot.instance != nullptr)
+        {
+            m_engine.destroyInstance(slot.instance);
+            slot.instance = nullptr;
+        }
+        if(slot.context != nullptr)
+        {
+            m_engine.destroyContext(slot.context);
+            slot.context = nullptr;
+        }
+    }
+
+    void WasmtimeInstancePool::updateIdleTargetLocked(std::chrono::steady_clock::time_point now)
+    {
+        if(now - m_demand_window_start < m_config.demand_window)
+        {
+            return;
+        }
+
+        // Aim to absorb one window worth of acquires from the idle list, decay slowly when demand drops
+        size_t demand = static_cast<size_t>(m_demand_window_acquire_count);
+        size_t target = demand >= m_idle_target ? demand : (m_idle_target + demand) / 2;
+        m_idle_target = std::clamp(target, m_config.min_idle_count, m_config.max_idle_count);
+
+        m_demand_window_start = now;
+        m_demand_window_acquire_count = 0;
+    }
+
+    void WasmtimeInstancePool::workerMain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(m_is_stopping == false)
+        {
+            updateIdleTargetLocked(std::chrono::steady_clock::now());
+
+            if(m_released_slots.empty() == false)
+            {
+                // Drop the used store, its instance state cannot be rewound
+                Slot slot = m_released_slots.front();
+                m_released_slots.pop_front();
+                m_statistics.recycle_count++;
+                lock.unlock();
+                destroySlot(slot);
+                lock.lock();
+                continue;
+            }
+
+            if(m_idle_slots.size() < m_idle_target)
+            {
+                lock.unlock();
+                Slot slot;
+                bool is_created = createSlot(slot);
+                lock.lock();
+                if(is_created)
+                {
+                    m_idle_slots.push_back(slot);
+                    continue;
+                }
+                // Instantiation keeps failing (e.g. pool slots exhausted), back off until the next window
+            }
+            else if(m_idle_slots.size() > m_idle_target)
+            {
+                Slot slot = m_idle_slots.back();
+                m_idle_slots.pop_back();
+                lock.unlock();
+                destroySlot(slot);
+                lock.lock();
+                continue;
+            }
+
+            m_worker_cv.wait_for(lock, m_config.demand_window);
+        }
+    }
+}
+
+
+
+
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "interface/script/script.h"
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace Arieo
+{
+    class WasmtimeEngine;
+    class WasmtimeContext;
+    class WasmtimeInstance;
+
+    /**
+     * @brief Pool of ready-to-call instances of a single module
+     *
+     * Every pooled instance owns its own context. Wasmtime cannot rewind a store, so a released
+     * instance is reset by dropping its store and instantiating again from the pre-linked module
+     * on the pool thread; with the pooling allocator this reuses the same copy-on-write slot.
+     * acquire() only falls back to instantiating on the caller thread when no idle instance is ready.
+     */
+    class WasmtimeInstancePool final
+    {
+    public:
+        struct Config
+        {
+            // Idle instances kept ready regardless of demand
+            size_t min_idle_count = 1;
+            // Upper bound for idle instances when demand is high
+            size_t max_idle_count = 16;
+            // Window over which acquire demand is measured to grow or shrink the idle target
+            std::chrono::milliseconds demand_window = std::chrono::milliseconds(500);
+        };
+
+        struct Statistics
+        {
+            std::uint64_t acquire_count = 0;
+            std::uint64_t idle_hit_count = 0;
+            std::uint64_t on_demand_count = 0;
+            std::uint64_t recycle_count = 0;
+            size_t idle_count = 0;
+            size_t in_use_count = 0;
+            size_t idle_target = 0;
+        };
+
+        WasmtimeInstancePool(WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module, const Config& config);
+        ~WasmtimeInstancePool();
+
+        // Returns an instance in its post-init state, or nullptr if instantiation failed
+        Base::Interop::RawRef<Interface::Script::IInstance> acquire();
+        void release(Base::Interop::RawRef<Interface::Script::IInstance> instance);
+
+        Statistics getStatistics() const;
+    private:
+        struct Slot
+        {
+            Base::Interop::RawRef<Interface::Script::IContext> context = nullptr;
+            Base::Interop::RawRef<Interface::Script::IInstance> instance = nullptr;
+        };
+
+        bool createSlot(Slot& slot);
+        void destroySlot(Slot& slot);
+        void updateIdleTargetLocked(std::chrono::steady_clock::time_point now);
+        void workerMain();
+
+        WasmtimeEngine& m_engine;
+        Base::Interop::RawRef<Interface::Script::IModule> m_module;
+        Config m_config;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_worker_cv;
+        std::deque<Slot> m_idle_slots;
+        std::deque<Slot> m_released_slots;
+        std::unordered_map<WasmtimeInstance*, Slot> m_in_use_slots;
+        size_t m_idle_target = 0;
+        bool m_is_stopping = false;
+
+        std::chrono::steady_clock::time_point m_demand_window_start;
+        std::uint64_t m_demand_window_acquire_count = 0;
+
+        Statistics m_statistics;
+        std::thread m_worker_thread;
+    };
+}
+
+
+
+
@@ -0,0 +1,80 @@
+#include "base/prerequisites.h"
+#include "wasmtime_guest_profiler.h"
+#include "core/logger/logger.h"
+
+#include <fstream>
+
+namespace Arieo
+{
+    WasmtimeGuestProfiler::WasmtimeGuestProfiler(wasmtime::Engine& engine, const std::string& name, std::chrono::microseconds interval, const std::filesystem::path& output_path)
+        : m_output_path(output_path), m_last_sample_time(std::chrono::steady_clock::now())
+    {
+        wasm_name_t profile_name;
+        wasm_byte_vec_new(&profile_name, name.size(), name.data());
+
+        // No modules to register, the core modules inside a component are not reachable through the C API
+        m_profiler = wasmtime_guestprofiler_new(
+            engine.capi(),
+            &profile_name,
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count()),
+            nullptr,
+            0
+        );
+        wasm_byte_vec_delete(&profile_name);
+    }
+
+    WasmtimeGuestProfiler::~WasmtimeGuestProfiler()
+    {
+        finish();
+    }
+
+    void WasmtimeGuestProfiler::sample(const wasmtime_store_t* store)
+    {
+        if(m_profiler == nullptr)
+        {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds delta = now - m_last_sample_time;
+        m_last_sample_time = now;
+        wasmtime_guestprofiler_sample(m_profiler, store, static_cast<uint64_t>(delta.count()));
+        m_sample_count++;
+    }
+
+    void WasmtimeGuestProfiler::finish()
+    {
+        if(m_profiler == nullptr)
+        {
+            return;
+        }
+
+        // Finishing consumes the profiler
+        wasm_byte_vec_t profile_json;
+        wasmtime_error_t* error = wasmtime_guestprofiler_finish(m_profiler, &profile_json);
+        m_profiler = nullptr;
+        if(error != nullptr)
+        {
+            Core::Logger::error("Failed to finish guest profile {}: {}", m_output_path.string(), wasmtime::Error(error).message());
+            return;
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(m_output_path.parent_path(), ec);
+        std::ofstream output_file(m_output_path, std::ios::binary | std::ios::trunc);
+        output_file.write(profile_json.data, static_cast<std::streamsize>(profile_json.size));
+        if(output_file.good())
+        {
+            Core::Logger::info("Wrote guest profile with {} samples to {}", m_sample_count, m_output_path.string());
+        }
+        else
+        {
+            Core::Logger::error("Failed to write guest profile {}", m_output_path.string());
+        }
+        wasm_byte_vec_delete(&profile_json);
+    }
+}
+
+
+
+
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include <wasmtime.hh>
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+namespace Arieo
+{
+    /**
+     * @brief Sampling profiler of the guests running in one store
+     *
+     * Samples are taken from the store's epoch callback, so the sampling interval is the epoch
+     * period. The profile is written in the Firefox profiler format (https://profiler.firefox.com)
+     * when the profiler is finished, which the owning context does on destruction.
+     *
+     * Wasmtime only symbolizes frames of core modules registered with the profiler. The C API gives
+     * no access to the core modules a component is made of, so samples of component guests carry
+     * timing but no named frames. Hot guest functions are found with the perfmap or jitdump modes.
+     */
+    class WasmtimeGuestProfiler final
+    {
+    public:
+        WasmtimeGuestProfiler(wasmtime::Engine& engine, const std::string& name, std::chrono::microseconds interval, const std::filesystem::path& output_path);
+        ~WasmtimeGuestProfiler();
+
+        WasmtimeGuestProfiler(const WasmtimeGuestProfiler&) = delete;
+        WasmtimeGuestProfiler& operator=(const WasmtimeGuestProfiler&) = delete;
+
+        // Records the guest stack currently executing in store
+        void sample(const wasmtime_store_t* store);
+        // Writes the profile to the output path, later samples are ignored
+        void finish();
+    private:
+        wasmtime_guestprofiler_t* m_profiler = nullptr;
+        std::filesystem::path m_output_path;
+        std::chrono::steady_clock::time_point m_last_sample_time;
+        std::uint64_t m_sample_count = 0;
+    };
+}
+
+
+
+
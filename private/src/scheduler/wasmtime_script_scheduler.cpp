@@ -0,0 +1,167 @@
+#include "base/prerequisites.h"
+#include "wasmtime_script_scheduler.h"
+#include "core/logger/logger.h"
+
+#include <algorithm>
+
+namespace Arieo
+{
+    void WasmtimeScriptScheduler::start(size_t worker_count)
+    {
+        m_is_stopping = false;
+        if(worker_count == 0)
+        {
+            worker_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+
+        for(size_t i = 0; i < worker_count; ++i)
+        {
+            Worker* worker = Base::newT<Worker>();
+            worker->m_scheduler = this;
+            worker->m_index = i;
+            m_workers.emplace_back(worker);
+        }
+        // Start threads only once every worker exists, stealing walks the whole list
+        for(Worker* worker : m_workers)
+        {
+            worker->m_thread = std::thread(&WasmtimeScriptScheduler::workerMain, this, std::ref(*worker));
+        }
+        Core::Logger::info("Script scheduler started with {} workers", worker_count);
+    }
+
+    void WasmtimeScriptScheduler::stop()
+    {
+        if(m_workers.empty())
+        {
+            return;
+        }
+
+        waitBatch();
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            m_is_stopping = true;
+        }
+        m_wake_cv.notify_all();
+
+        for(Worker* worker : m_workers)
+        {
+            worker->m_thread.join();
+            Base::deleteT(worker);
+        }
+        m_workers.clear();
+    }
+
+    void WasmtimeScriptScheduler::submitBatch(std::vector<Job>&& jobs)
+    {
+        if(jobs.empty())
+        {
+            return;
+        }
+
+        m_pending_job_count += jobs.size();
+        for(Job& job : jobs)
+        {
+            Worker* worker = m_workers[m_next_worker];
+            m_next_worker = (m_next_worker + 1) % m_workers.size();
+            std::lock_guard<std::mutex> lock(worker->m_queue_mutex);
+            worker->m_queue.emplace_back(std::move(job));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_wake_mutex);
+            m_wake_generation++;
+        }
+        m_wake_cv.notify_all();
+    }
+
+    void WasmtimeScriptScheduler::waitBatch()
+    {
+        std::unique_lock<std::mutex> lock(m_wake_mutex);
+        m_done_cv.wait(lock, [this] { return m_pending_job_count == 0; });
+    }
+
+    std::vector<WasmtimeScriptScheduler::WorkerStatistics> WasmtimeScriptScheduler::collectWorkerStatistics()
+    {
+        std::vector<WorkerStatistics> statistics;
+        statistics.reserve(m_workers.size());
+        for(Worker* worker : m_workers)
+        {
+            WorkerStatistics worker_statistics;
+            worker_statistics.job_count = worker->m_job_count.exchange(0);
+            worker_statistics.steal_count = worker->m_steal_count.exchange(0);
+            worker_statistics.busy_time = std::chrono::nanoseconds(worker->m_busy_ns.exchange(0));
+            statistics.emplace_back(worker_statistics);
+        }
+        return statistics;
+    }
+
+    void WasmtimeScriptScheduler::workerMain(Worker& worker)
+    {
+        while(true)
+        {
+            std::uint64_t seen_generation = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_wake_mutex);
+                if(m_is_stopping)
+                {
+                    return;
+                }
+                seen_generation = m_wake_generation;
+            }
+
+            Job job;
+            if(popJob(worker, job) || stealJob(worker, job))
+            {
+                auto start_time = std::chrono::steady_clock::now();
+                job(worker);
+                worker.m_busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+                worker.m_job_count++;
+
+                if(--m_pending_job_count == 0)
+                {
+                    std::lock_guard<std::mutex> lock(m_wake_mutex);
+                    m_done_cv.notify_all();
+                }
+                continue;
+            }
+
+            // Nothing to run or steal, sleep until the next submit
+            std::unique_lock<std::mutex> lock(m_wake_mutex);
+            m_wake_cv.wait(lock, [this, seen_generation] { return m_is_stopping || m_wake_generation != seen_generation; });
+        }
+    }
+
+    bool WasmtimeScriptScheduler::popJob(Worker& worker, Job& job)
+    {
+        std::lock_guard<std::mutex> lock(worker.m_queue_mutex);
+        if(worker.m_queue.empty())
+        {
+            return false;
+        }
+        // Owner takes the most recently queued job, thieves take the oldest
+        job = std::move(worker.m_queue.back());
+        worker.m_queue.pop_back();
+        return true;
+    }
+
+    bool WasmtimeScriptScheduler::stealJob(Worker& thief, Job& job)
+    {
+        for(size_t offset = 1; offset < m_workers.size(); ++offset)
+        {
+            Worker* victim = m_workers[(thief.m_index + offset) % m_workers.size()];
+            std::lock_guard<std::mutex> lock(victim->m_queue_mutex);
+            if(victim->m_queue.empty() == false)
+            {
+                job = std::move(victim->m_queue.front());
+                victim->m_queue.pop_front();
+                thief.m_steal_count++;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+
+
+
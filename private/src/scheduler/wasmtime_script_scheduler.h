@@ -0,0 +1,93 @@
+#pragma once
+
+#include "base/prerequisites.h"
+#include "interface/script/script.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Arieo
+{
+    /**
+     * @brief Worker pool running script jobs across cores with work stealing
+     *
+     * Threading contract:
+     * - wasmtime::Engine, compiled components and the pre-linked modules are shared by all workers.
+     * - A store (IContext) and the instances created in it must only be entered by one thread at a
+     *   time. Workers own no stores, jobs bring theirs: a store may move between workers across
+     *   batches, so stateful scripts own their context and run on whichever worker picks them up.
+     * - Host functions registered in the linker, including every function exported by linker
+     *   libraries, are called on the worker thread running the guest. They must be thread-safe
+     *   and must not assume they run on the tick thread.
+     * - Async calls (WasmtimeAsyncCall) are tick thread only and must not be started from jobs.
+     */
+    class WasmtimeScriptScheduler final
+    {
+    public:
+        class Worker final
+        {
+        public:
+            size_t getIndex() const { return m_index; }
+        private:
+            friend class WasmtimeScriptScheduler;
+
+            WasmtimeScriptScheduler* m_scheduler = nullptr;
+            size_t m_index = 0;
+
+            std::mutex m_queue_mutex;
+            std::deque<std::function<void(Worker&)>> m_queue;
+
+            std::atomic<std::uint64_t> m_job_count = 0;
+            std::atomic<std::uint64_t> m_steal_count = 0;
+            std::atomic<std::uint64_t> m_busy_ns = 0;
+
+            std::thread m_thread;
+        };
+
+        using Job = std::function<void(Worker&)>;
+
+        struct WorkerStatistics
+        {
+            std::uint64_t job_count = 0;
+            std::uint64_t steal_count = 0;
+            std::chrono::nanoseconds busy_time = std::chrono::nanoseconds(0);
+        };
+
+        // worker_count of zero uses one worker per hardware thread
+        void start(size_t worker_count);
+        void stop();
+
+        size_t getWorkerCount() const { return m_workers.size(); }
+
+        // Distributes the jobs across worker queues, idle workers steal from busy ones
+        void submitBatch(std::vector<Job>&& jobs);
+        // Blocks until every submitted job has finished
+        void waitBatch();
+
+        // Counters accumulated since the previous call
+        std::vector<WorkerStatistics> collectWorkerStatistics();
+    private:
+        void workerMain(Worker& worker);
+        bool popJob(Worker& worker, Job& job);
+        bool stealJob(Worker& thief, Job& job);
+
+        std::vector<Worker*> m_workers;
+        size_t m_next_worker = 0;
+
+        std::mutex m_wake_mutex;
+        std::condition_variable m_wake_cv;
+        std::condition_variable m_done_cv;
+        std::atomic<std::uint64_t> m_pending_job_count = 0;
+        std::uint64_t m_wake_generation = 0;
+        bool m_is_stopping = false;
+    };
+}
+
+
+
+
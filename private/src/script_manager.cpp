@@ -5,7 +5,12 @@
 #include "core/manifest/manifest.h"
 
 #include "engine/wasmtime_engine.h"
+#include "engine/wasmtime_engine_config.h"
+#include "context/wasmtime_context.h"
 #include "interface/sample/sample.h"
+#include "instance/wasmtime_instance.h"
+#include "module/wasmtime_module.h"
+#include "utility/wasmtime_hash.h"
 
 namespace Arieo
 {
@@ -38,10 +43,6 @@ namespace Arieo
             // TODO: Define SCRIPT_DIR in app.manifest.yaml
             Base::StringUtility::replaceAll(script_entry, "${SCRIPT_DIR}", "script");
 
-            auto starup_script_file = main_module->getRootArchive()->aquireFileBuffer(
-                Core::SystemUtility::FileSystem::getFormalizedPath(script_entry).string()
-            );
-
             Base::Interop::RawRef<Interface::Script::IScriptEngine> script_manager = Core::ModuleManager::getInterface<Interface::Script::IScriptEngine>("wasmtime");
             if(script_manager == nullptr)
             {
@@ -49,12 +50,34 @@ namespace Arieo
                 return;
             }
 
+            // Every script compiles on the engine's loader workers, the entry is only waited for once the linkers are loaded
+            WasmtimeEngine* wasmtime_engine = script_manager.castToInstance<WasmtimeEngine>();
+            WasmtimeEngine::ModuleFuture script_module_future = loadScriptAsync(wasmtime_engine, main_module, script_entry);
+
+            // script_preload:
+            //   - ${SCRIPT_DIR}/<script>.wasm
+            if(system_node["script_preload"].IsDefined())
+            {
+                m_preload_script_engine = script_manager;
+                const auto& preload_node = system_node["script_preload"];
+                for(size_t i = 0; i < preload_node.size(); ++i)
+                {
+                    std::string preload_path = preload_node[i].as<std::string>();
+                    if(preload_path.starts_with("${SCRIPT_DIR}") == false)
+                    {
+                        Core::Logger::error("'script_preload' entry '{}' must start with ${SCRIPT_DIR}", preload_path);
+                        continue;
+                    }
+                    std::string script_path = preload_path;
+                    Base::StringUtility::replaceAll(script_path, "${SCRIPT_DIR}", "script");
+                    m_preloaded_scripts.emplace(preload_path, loadScriptAsync(wasmtime_engine, main_module, script_path));
+                }
+                Core::Logger::info("Preloading {} scripts", m_preloaded_scripts.size());
+            }
+
             Base::Interop::RawRef<Arieo::Interface::Script::IContext> script_context = script_manager->createContext();
-            Base::Interop::RawRef<Interface::Script::IModule> script_module = script_manager->loadModuleFromCompiledBinary(
-                starup_script_file->getBuffer(),
-                starup_script_file->getBufferSize()
-            );
-            main_module->getRootArchive()->releaseFileBuffer(starup_script_file);
+            m_script_name = std::filesystem::path(script_entry).stem().string();
+            script_context.castToInstance<WasmtimeContext>()->setScriptName(m_script_name);
 
             // Get the linker pointer from wasmtime engine (requires casting to access private member)
             // WasmtimeEngine* wasmtime_engine = script_manager.castToInstance<WasmtimeEngine>();
@@ -84,6 +107,14 @@ namespace Arieo
                 }
             }
 
+            Base::Interop::RawRef<Interface::Script::IModule> script_module = script_module_future.get();
+            if(script_module == nullptr)
+            {
+                Core::Logger::error("Failed to load script entry: {}", script_entry);
+                script_manager->destroyContext(script_context);
+                return;
+            }
+
             // {
             //     WasmtimeEngine* wasmtime_engine = static_cast<WasmtimeEngine*>(script_manager);
             //     wasmtime::component::LinkerInstance linker = (reinterpret_cast<wasmtime::component::Linker*>(wasmtime_engine->getLinker()))->root();
@@ -94,13 +125,122 @@ namespace Arieo
                 script_context,
                 script_module
             );
+            if(script_instance == nullptr)
+            {
+                Core::Logger::error("Failed to instantiate script entry: {}", script_entry);
+                script_manager->unloadModule(script_module);
+                script_manager->destroyContext(script_context);
+                return;
+            }
 
-            script_instance->callFunction(
-                script_instance->queryFunction(
-                    script_instance->queryInterface("wasi:cli/run@0.2.0"),
-                    "run"
-                )
+            // The entry runs under the tick budget machinery too, a guest stuck in run traps instead of stalling the host
+            void* run_function = script_instance->queryFunction(
+                script_instance->queryInterface("wasi:cli/run@0.2.0"),
+                "run"
             );
+            if(run_function != nullptr)
+            {
+                // Only bounded when entry_budget_us is set, a one-time setup may take far longer than a frame
+                std::chrono::microseconds entry_budget = wasmtime_engine->getTickBudget().has_value()
+                    ? wasmtime_engine->getTickBudget()->entry_budget.value_or(std::chrono::microseconds::max())
+                    : std::chrono::microseconds::max();
+                WasmtimeEngine::BudgetedCallResult entry_result = wasmtime_engine->callEntryWithBudget(
+                    script_context,
+                    script_instance,
+                    run_function,
+                    entry_budget
+                );
+                if(entry_result.is_deadline_missed || entry_result.is_fuel_exhausted)
+                {
+                    if(entry_result.is_deadline_missed)
+                    {
+                        Core::Logger::error("Script entry {} missed its {} us budget after {} us, raise script_engine.tick_budget.entry_budget_us if it needs longer",
+                            script_entry,
+                            entry_budget.count(),
+                            std::chrono::duration_cast<std::chrono::microseconds>(entry_result.elapsed).count());
+                    }
+                    else
+                    {
+                        Core::Logger::error("Script entry {} ran out of fuel after {} us, raise script_engine.fuel.allowance if it needs more",
+                            script_entry,
+                            std::chrono::duration_cast<std::chrono::microseconds>(entry_result.elapsed).count());
+                    }
+                    script_manager->destroyInstance(script_instance);
+                    script_manager->unloadModule(script_module);
+                    script_manager->destroyContext(script_context);
+                    return;
+                }
+            }
+
+            // Scripts exporting a tick function stay alive and are driven from onTick
+            // script_tick:
+            //   interface: <exporting interface, defaults to arieo:application/guest>
+            //   function: <func() export called every frame, defaults to tick>
+            //   instance_count: <tick slots, each in its own store. Only the first one ran wasi:cli/run>
+            //   worker_count: <scheduler workers when instance_count > 1, 0 is one per hardware thread>
+            if(system_node["script_tick"].IsDefined())
+            {
+                Core::ConfigNode tick_node = system_node["script_tick"];
+                m_tick_interface_name = tick_node["interface"].IsDefined() ? tick_node["interface"].as<std::string>() : "arieo:application/guest";
+                m_tick_function_name = tick_node["function"].IsDefined() ? tick_node["function"].as<std::string>() : "tick";
+                size_t instance_count = tick_node["instance_count"].IsDefined() ? std::max<size_t>(1, tick_node["instance_count"].as<size_t>()) : 1;
+
+                m_script_engine = script_manager;
+                m_script_module = script_module;
+
+                // The entry instance ticks as the first slot. Additional slots, and slots recreated after a trap, only run
+                // the tick export and start from the component's initial state, wasi:cli/run is not repeated for them
+                // since its side effects are meant to happen once. Scripts ticking several instances set up per-instance
+                // state lazily in the tick export.
+                m_tick_slots.resize(instance_count);
+                m_tick_slots[0].context = script_context;
+                m_tick_slots[0].instance = script_instance;
+                if(bindTickFunction(m_tick_slots[0]))
+                {
+                    for(size_t i = 1; i < instance_count; ++i)
+                    {
+                        recreateTickSlot(m_tick_slots[i]);
+                    }
+
+                    if(instance_count > 1)
+                    {
+                        size_t worker_count = tick_node["worker_count"].IsDefined() ? tick_node["worker_count"].as<size_t>() : 0;
+                        m_scheduler.start(worker_count);
+                    }
+
+                    // script_hot_reload:
+                    //   enabled: <bool>
+                    //   poll_interval_ms: <how often the entry is checked for changes, archive entries are re-read and hashed every poll>
+                    //   save_state: <export of the tick interface, func() -> list<u8>, empty disables the handoff>
+                    //   load_state: <export of the tick interface, func(state: list<u8>)>
+                    if(system_node["script_hot_reload"].IsDefined() && system_node["script_hot_reload"]["enabled"].IsDefined()
+                        && system_node["script_hot_reload"]["enabled"].as<bool>())
+                    {
+                        Core::ConfigNode hot_reload_node = system_node["script_hot_reload"];
+                        m_is_hot_reload = true;
+                        m_main_module = main_module;
+                        m_script_entry_path = script_entry;
+                        if(hot_reload_node["poll_interval_ms"].IsDefined())
+                        {
+                            m_hot_reload_poll_interval = std::chrono::milliseconds(hot_reload_node["poll_interval_ms"].as<std::int64_t>());
+                        }
+                        if(hot_reload_node["save_state"].IsDefined())
+                        {
+                            m_save_state_function_name = hot_reload_node["save_state"].as<std::string>();
+                        }
+                        if(hot_reload_node["load_state"].IsDefined())
+                        {
+                            m_load_state_function_name = hot_reload_node["load_state"].as<std::string>();
+                        }
+                        recordScriptVersion();
+                        Core::Logger::info("Script hot reload watching {} every {} ms", m_script_entry_path, m_hot_reload_poll_interval.count());
+                    }
+                    return;
+                }
+                m_tick_slots.clear();
+                m_script_engine = nullptr;
+                m_script_module = nullptr;
+            }
 
             script_manager->destroyInstance(script_instance);
             script_manager->unloadModule(script_module);
@@ -109,14 +249,523 @@ namespace Arieo
         }
     }
 
+    WasmtimeEngine::ModuleFuture ScriptManager::loadScriptAsync(WasmtimeEngine* wasmtime_engine, Base::Interop::RawRef<Interface::Main::IMainModule> main_module, const std::string& script_path)
+    {
+        // Precompiled scripts shipped next to the archive are mapped from disk, everything else is read from the archive
+        std::filesystem::path formalized_script_path = Core::SystemUtility::FileSystem::getFormalizedPath(script_path);
+        if(formalized_script_path.extension() == WasmtimeEngineConfig::PRECOMPILED_EXTENSION && std::filesystem::exists(formalized_script_path))
+        {
+            return wasmtime_engine->loadModuleFromPrecompiledFileAsync(formalized_script_path);
+        }
+
+        auto script_file = main_module->getRootArchive()->aquireFileBuffer(
+            formalized_script_path.string()
+        );
+        // The engine copies the binary, the archive buffer is released before compilation starts
+        WasmtimeEngine::ModuleFuture script_module_future = wasmtime_engine->loadModuleFromCompiledBinaryAsync(
+            script_file->getBuffer(),
+            script_file->getBufferSize()
+        );
+        main_module->getRootArchive()->releaseFileBuffer(script_file);
+        return script_module_future;
+    }
+
+    bool ScriptManager::hasScriptChanged(WasmtimeEngine* wasmtime_engine)
+    {
+        // Scripts on disk are compared by write time, archive entries by content
+        std::filesystem::path script_path = Core::SystemUtility::FileSystem::getFormalizedPath(m_script_entry_path);
+        std::error_code ec;
+        if(std::filesystem::exists(script_path, ec))
+        {
+            std::filesystem::file_time_type write_time = std::filesystem::last_write_time(script_path, ec);
+            if(ec || write_time == m_script_write_time)
+            {
+                return false;
+            }
+            m_script_write_time = write_time;
+            return true;
+        }
+
+        // The archive exposes no entry metadata, so the entry is re-read every poll. Its buffer is acquired and released
+        // here on the tick thread, only the hashing of the bytes runs on a loader worker and a change is noticed one poll later.
+        if(m_script_hash_future.valid() == false)
+        {
+            m_script_hash_buffer = m_main_module->getRootArchive()->aquireFileBuffer(script_path.string());
+            if(m_script_hash_buffer == nullptr)
+            {
+                return false;
+            }
+            const void* script_data = m_script_hash_buffer->getBuffer();
+            size_t script_size = m_script_hash_buffer->getBufferSize();
+            m_script_hash_future = wasmtime_engine->submitLoaderJob([script_data, script_size]()
+            {
+                return WasmtimeHash::hashBytes(script_data, script_size);
+            });
+            return false;
+        }
+        if(m_script_hash_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return false;
+        }
+        std::uint64_t content_hash = m_script_hash_future.get();
+        m_main_module->getRootArchive()->releaseFileBuffer(m_script_hash_buffer);
+        m_script_hash_buffer = nullptr;
+        if(content_hash == m_script_content_hash)
+        {
+            return false;
+        }
+        m_script_content_hash = content_hash;
+        return true;
+    }
+
+    void ScriptManager::recordScriptVersion()
+    {
+        std::filesystem::path script_path = Core::SystemUtility::FileSystem::getFormalizedPath(m_script_entry_path);
+        std::error_code ec;
+        if(std::filesystem::exists(script_path, ec))
+        {
+            m_script_write_time = std::filesystem::last_write_time(script_path, ec);
+            return;
+        }
+        m_script_content_hash = hashArchiveScript(m_main_module, script_path);
+    }
+
+    std::uint64_t ScriptManager::hashArchiveScript(Base::Interop::RawRef<Interface::Main::IMainModule> main_module, const std::filesystem::path& script_path)
+    {
+        auto script_file = main_module->getRootArchive()->aquireFileBuffer(script_path.string());
+        if(script_file == nullptr)
+        {
+            return 0;
+        }
+        std::uint64_t content_hash = WasmtimeHash::hashBytes(script_file->getBuffer(), script_file->getBufferSize());
+        main_module->getRootArchive()->releaseFileBuffer(script_file);
+        return content_hash;
+    }
+
+    void ScriptManager::pollHotReload(WasmtimeEngine* wasmtime_engine)
+    {
+        if(m_reload_future.valid())
+        {
+            if(m_reload_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                return;
+            }
+            Base::Interop::RawRef<Interface::Script::IModule> reloaded_module = m_reload_future.get();
+            m_reload_future = WasmtimeEngine::ModuleFuture();
+            if(reloaded_module == nullptr)
+            {
+                Core::Logger::error("Hot reload of {} failed to compile, the running version is kept", m_script_entry_path);
+                return;
+            }
+            if(reloaded_module.castToInstance<WasmtimeModule>() == m_script_module.castToInstance<WasmtimeModule>())
+            {
+                // Same content, the registry handed back the running module with an extra reference
+                m_script_engine->unloadModule(reloaded_module);
+                return;
+            }
+            swapScriptModule(reloaded_module);
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if(now < m_next_hot_reload_poll_time)
+        {
+            return;
+        }
+        m_next_hot_reload_poll_time = now + m_hot_reload_poll_interval;
+        if(hasScriptChanged(wasmtime_engine))
+        {
+            Core::Logger::info("Script {} changed, recompiling in the background", m_script_entry_path);
+            m_reload_start_time = now;
+            m_reload_future = loadScriptAsync(wasmtime_engine, m_main_module, m_script_entry_path);
+        }
+    }
+
+    void ScriptManager::swapScriptModule(Base::Interop::RawRef<Interface::Script::IModule> reloaded_module)
+    {
+        auto swap_start_time = std::chrono::steady_clock::now();
+
+        // Every slot gets its replacement before any is swapped, a failure leaves the running version untouched
+        std::vector<TickSlot> reloaded_slots(m_tick_slots.size());
+        bool is_ready = true;
+        for(TickSlot& reloaded_slot : reloaded_slots)
+        {
+            reloaded_slot.context = m_script_engine->createContext();
+            reloaded_slot.context.castToInstance<WasmtimeContext>()->setScriptName(m_script_name);
+            reloaded_slot.instance = m_script_engine->createInstance(reloaded_slot.context, reloaded_module);
+            if(reloaded_slot.instance == nullptr || bindTickFunction(reloaded_slot) == false)
+            {
+                is_ready = false;
+                break;
+            }
+        }
+        if(is_ready == false)
+        {
+            Core::Logger::error("Hot reload of {} failed to instantiate, the running version is kept", m_script_entry_path);
+            destroyTickSlots(reloaded_slots);
+            m_script_engine->unloadModule(reloaded_module);
+            return;
+        }
+
+        size_t state_handoff_count = 0;
+        for(size_t i = 0; i < m_tick_slots.size(); ++i)
+        {
+            if(transferState(m_tick_slots[i], reloaded_slots[i]))
+            {
+                state_handoff_count++;
+            }
+        }
+
+        destroyTickSlots(m_tick_slots);
+        m_script_engine->unloadModule(m_script_module);
+        m_tick_slots = std::move(reloaded_slots);
+        m_script_module = reloaded_module;
+
+        auto now = std::chrono::steady_clock::now();
+        Core::Logger::info("Hot reloaded {} in {} ms: {} ms compiling in the background, {} ms swap on the tick thread, state handed off for {} of {} slots",
+            m_script_entry_path,
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - m_reload_start_time).count(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(swap_start_time - m_reload_start_time).count(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - swap_start_time).count(),
+            state_handoff_count,
+            m_tick_slots.size());
+    }
+
+    bool ScriptManager::transferState(TickSlot& from_slot, TickSlot& to_slot)
+    {
+        if(m_save_state_function_name.empty() || from_slot.instance == nullptr)
+        {
+            return false;
+        }
+
+        WasmtimeInstance* from_instance = from_slot.instance.castToInstance<WasmtimeInstance>();
+        WasmtimeInstance* to_instance = to_slot.instance.castToInstance<WasmtimeInstance>();
+        void* save_state_function = from_instance->findFunction(m_tick_interface_name, m_save_state_function_name);
+        void* load_state_function = to_instance->findFunction(m_tick_interface_name, m_load_state_function_name);
+        if(save_state_function == nullptr || load_state_function == nullptr)
+        {
+            return false;
+        }
+
+        wasmtime::Result<std::vector<std::uint8_t>> state = from_instance->callFunctionReturningBytes(save_state_function);
+        if(!state)
+        {
+            Core::Logger::error("Script '{}' failed, the reloaded instance starts fresh: {}", m_save_state_function_name, state.err().message());
+            return false;
+        }
+        wasmtime::Result<std::monostate> load_result = to_instance->callFunctionWithBytes(load_state_function, state.unwrap());
+        if(!load_result)
+        {
+            Core::Logger::error("Script '{}' failed on the reloaded instance: {}", m_load_state_function_name, load_result.err().message());
+            return false;
+        }
+        return true;
+    }
+
+    void ScriptManager::destroyTickSlots(std::vector<TickSlot>& tick_slots)
+    {
+        for(TickSlot& tick_slot : tick_slots)
+        {
+            if(tick_slot.instance != nullptr)
+            {
+                m_script_engine->destroyInstance(tick_slot.instance);
+            }
+            if(tick_slot.context != nullptr)
+            {
+                m_script_engine->destroyContext(tick_slot.context);
+            }
+        }
+        tick_slots.clear();
+    }
+
+    Base::Interop::RawRef<Interface::Script::IModule> ScriptManager::acquirePreloadedScript(const std::string& script_path)
+    {
+        auto iter = m_preloaded_scripts.find(script_path);
+        if(iter == m_preloaded_scripts.end())
+        {
+            Core::Logger::error("Script '{}' is not listed in 'script_preload'", script_path);
+            return nullptr;
+        }
+        return iter->second.get();
+    }
+
+    bool ScriptManager::bindTickFunction(TickSlot& tick_slot)
+    {
+        tick_slot.tick_function = nullptr;
+        tick_slot.typed_tick_function = WasmtimeTypedFunction<void()>();
+        void* tick_interface = tick_slot.instance->queryInterface(m_tick_interface_name);
+        if(tick_interface == nullptr)
+        {
+            Core::Logger::error("Script tick interface '{}' not exported", m_tick_interface_name);
+            return false;
+        }
+        tick_slot.tick_function = tick_slot.instance->queryFunction(tick_interface, m_tick_function_name);
+        if(tick_slot.tick_function == nullptr)
+        {
+            Core::Logger::error("Script tick function '{}' not exported by '{}'", m_tick_function_name, m_tick_interface_name);
+            return false;
+        }
+        tick_slot.typed_tick_function = tick_slot.instance.castToInstance<WasmtimeInstance>()->getTypedFunction<void()>(tick_slot.tick_function);
+        return true;
+    }
+
+    void ScriptManager::recreateTickSlot(TickSlot& tick_slot)
+    {
+        // A trapped component instance cannot be entered again, start over from a fresh store
+        if(tick_slot.instance != nullptr)
+        {
+            m_script_engine->destroyInstance(tick_slot.instance);
+        }
+        if(tick_slot.context != nullptr)
+        {
+            m_script_engine->destroyContext(tick_slot.context);
+        }
+        tick_slot.tick_function = nullptr;
+        tick_slot.typed_tick_function = WasmtimeTypedFunction<void()>();
+
+        tick_slot.context = m_script_engine->createContext();
+        tick_slot.context.castToInstance<WasmtimeContext>()->setScriptName(m_script_name);
+        tick_slot.instance = m_script_engine->createInstance(tick_slot.context, m_script_module);
+        if(tick_slot.instance == nullptr || bindTickFunction(tick_slot) == false)
+        {
+            Core::Logger::error("Failed to create script tick instance, this slot stops ticking");
+        }
+    }
+
+    void ScriptManager::dumpMetrics(WasmtimeEngine* wasmtime_engine)
+    {
+        for(const WasmtimeMetrics::Snapshot& snapshot : wasmtime_engine->collectMetrics())
+        {
+            switch(snapshot.kind)
+            {
+            case WasmtimeMetrics::Kind::Counter:
+                Core::Logger::info("Script metric {}: {}", snapshot.name, snapshot.count);
+                break;
+            case WasmtimeMetrics::Kind::Gauge:
+                Core::Logger::info("Script metric {}: {} (gauge)", snapshot.name, snapshot.count);
+                break;
+            case WasmtimeMetrics::Kind::Histogram:
+                Core::Logger::info("Script metric {}: {} calls, avg {} ns, p50 {} ns, p99 {} ns, max {} ns",
+                    snapshot.name,
+                    snapshot.count,
+                    snapshot.sum_ns / snapshot.count,
+                    snapshot.p50_ns,
+                    snapshot.p99_ns,
+                    snapshot.max_ns);
+                break;
+            }
+        }
+    }
+
     void ScriptManager::onTick()
     {
+        if(m_script_engine == nullptr)
+        {
+            return;
+        }
+
+        WasmtimeEngine* wasmtime_engine = m_script_engine.castToInstance<WasmtimeEngine>();
+
+        // Guests suspended in host imports on earlier ticks continue here
+        wasmtime_engine->pumpAsyncCalls();
+
+        size_t metrics_dump_interval_frames = wasmtime_engine->getMetricsDumpIntervalFrames();
+        if(metrics_dump_interval_frames > 0 && ++m_metrics_frame_count >= metrics_dump_interval_frames)
+        {
+            dumpMetrics(wasmtime_engine);
+            m_metrics_frame_count = 0;
+        }
+
+        if(m_tick_slots.empty())
+        {
+            return;
+        }
+
+        // Between frames no worker touches the slots, a reloaded version is swapped in here
+        if(m_is_hot_reload)
+        {
+            pollHotReload(wasmtime_engine);
+        }
+
+        std::chrono::microseconds frame_budget = wasmtime_engine->getTickBudget().has_value()
+            ? wasmtime_engine->getTickBudget()->frame_budget
+            : std::chrono::microseconds::max();
+
+        auto tick_slot_fn = [wasmtime_engine, frame_budget](TickSlot& tick_slot)
+        {
+            tick_slot.last_result = WasmtimeEngine::BudgetedCallResult();
+            if(tick_slot.tick_function != nullptr)
+            {
+                tick_slot.last_result = wasmtime_engine->callFunctionWithBudget(
+                    tick_slot.context,
+                    tick_slot.instance,
+                    tick_slot.tick_function,
+                    tick_slot.typed_tick_function,
+                    frame_budget
+                );
+            }
+        };
+
+        auto start_time = std::chrono::steady_clock::now();
+        if(m_scheduler.getWorkerCount() > 0)
+        {
+            // Every slot owns its store, so any worker may run any slot
+            std::vector<WasmtimeScriptScheduler::Job> jobs;
+            jobs.reserve(m_tick_slots.size());
+            for(TickSlot& tick_slot : m_tick_slots)
+            {
+                jobs.emplace_back([&tick_slot, &tick_slot_fn](WasmtimeScriptScheduler::Worker&) { tick_slot_fn(tick_slot); });
+            }
+            m_scheduler.submitBatch(std::move(jobs));
+            m_scheduler.waitBatch();
+        }
+        else
+        {
+            tick_slot_fn(m_tick_slots[0]);
+        }
+        std::chrono::nanoseconds frame_wall_time = std::chrono::steady_clock::now() - start_time;
+
+        std::chrono::nanoseconds frame_script_time = std::chrono::nanoseconds(0);
+        std::uint64_t frame_fuel = 0;
+        for(TickSlot& tick_slot : m_tick_slots)
+        {
+            frame_script_time += tick_slot.last_result.elapsed;
+            frame_fuel += tick_slot.last_result.fuel_consumed;
+            if(tick_slot.last_result.is_deadline_missed)
+            {
+                m_report_deadline_miss_count++;
+                Core::Logger::error("Script tick '{}' missed its {} us budget after {} us",
+                    m_tick_function_name,
+                    frame_budget.count(),
+                    std::chrono::duration_cast<std::chrono::microseconds>(tick_slot.last_result.elapsed).count());
+                recreateTickSlot(tick_slot);
+            }
+            else if(tick_slot.last_result.is_fuel_exhausted)
+            {
+                m_report_fuel_exhausted_count++;
+                Core::Logger::error("Script tick '{}' ran out of its {} fuel allowance",
+                    m_tick_function_name,
+                    wasmtime_engine->getFuelConfig().allowance);
+                recreateTickSlot(tick_slot);
+            }
+        }
+
+        m_last_frame_script_time = frame_script_time;
+        m_report_script_time += frame_script_time;
+        m_report_wall_time += frame_wall_time;
+        m_report_max_script_time = std::max(m_report_max_script_time, frame_script_time);
+        m_report_fuel += frame_fuel;
+        m_report_max_fuel = std::max(m_report_max_fuel, frame_fuel);
+        m_report_frame_count++;
+
+        if(m_report_frame_count >= REPORT_INTERVAL_FRAMES)
+        {
+            Core::Logger::info("Script time over {} frames: avg {} us, max {} us, {} deadline misses",
+                m_report_frame_count,
+                std::chrono::duration_cast<std::chrono::microseconds>(m_report_script_time).count() / static_cast<std::int64_t>(m_report_frame_count),
+                std::chrono::duration_cast<std::chrono::microseconds>(m_report_max_script_time).count(),
+                m_report_deadline_miss_count);
+
+            if(wasmtime_engine->getFuelConfig().is_enabled)
+            {
+                // Fuel does not depend on the machine, unlike the times above
+                Core::Logger::info("Script fuel over {} frames: avg {}, max {}, {} exhausted",
+                    m_report_frame_count,
+                    m_report_fuel / m_report_frame_count,
+                    m_report_max_fuel,
+                    m_report_fuel_exhausted_count);
+                for(const WasmtimeModule::FuelCost& fuel_cost : m_script_module.castToInstance<WasmtimeModule>()->getFuelReport())
+                {
+                    Core::Logger::info("Script fuel {}: {} calls, avg {}, max {}, total {}, {} exhausted",
+                        fuel_cost.function_name,
+                        fuel_cost.call_count,
+                        fuel_cost.total_fuel / fuel_cost.call_count,
+                        fuel_cost.max_fuel,
+                        fuel_cost.total_fuel,
+                        fuel_cost.exhausted_count);
+                }
+            }
+
+            if(m_scheduler.getWorkerCount() > 0)
+            {
+                std::vector<WasmtimeScriptScheduler::WorkerStatistics> worker_statistics = m_scheduler.collectWorkerStatistics();
+                for(size_t i = 0; i < worker_statistics.size(); ++i)
+                {
+                    Core::Logger::info("Script worker {}: {} jobs, {} stolen, {}% utilization during script batches",
+                        i,
+                        worker_statistics[i].job_count,
+                        worker_statistics[i].steal_count,
+                        m_report_wall_time.count() > 0 ? worker_statistics[i].busy_time.count() * 100 / m_report_wall_time.count() : 0);
+                }
+            }
 
+            if(m_script_engine.castToInstance<WasmtimeEngine>()->isMemoryAccountingEnabled())
+            {
+                for(size_t i = 0; i < m_tick_slots.size(); ++i)
+                {
+                    WasmtimeContext::MemoryStatistics memory_statistics = m_tick_slots[i].context.castToInstance<WasmtimeContext>()->getMemoryStatistics();
+                    Core::Logger::info("Script slot {} memory: {} bytes in {} memories, peak {} bytes, limit {} bytes, {} failed grows",
+                        i,
+                        memory_statistics.current_bytes,
+                        memory_statistics.memory_count,
+                        memory_statistics.peak_bytes,
+                        memory_statistics.limit_bytes,
+                        memory_statistics.failed_grow_count);
+                }
+            }
+
+            m_report_frame_count = 0;
+            m_report_script_time = std::chrono::nanoseconds(0);
+            m_report_wall_time = std::chrono::nanoseconds(0);
+            m_report_max_script_time = std::chrono::nanoseconds(0);
+            m_report_deadline_miss_count = 0;
+            m_report_fuel = 0;
+            m_report_max_fuel = 0;
+            m_report_fuel_exhausted_count = 0;
+        }
     }
 
     void ScriptManager::onDeinitialize()
     {
+        for(auto& [script_path, script_module_future] : m_preloaded_scripts)
+        {
+            // Loads that were never waited for still finish here, their modules are unloaded either way
+            Base::Interop::RawRef<Interface::Script::IModule> script_module = script_module_future.get();
+            if(script_module != nullptr)
+            {
+                m_preload_script_engine->unloadModule(script_module);
+            }
+        }
+        m_preloaded_scripts.clear();
+        m_preload_script_engine = nullptr;
+
+        if(m_script_engine == nullptr)
+        {
+            return;
+        }
+
+        m_scheduler.stop();
+        if(m_script_hash_future.valid())
+        {
+            // The worker still reads the buffer until the hash is ready
+            m_script_hash_future.wait();
+            m_main_module->getRootArchive()->releaseFileBuffer(m_script_hash_buffer);
+            m_script_hash_buffer = nullptr;
+        }
+        if(m_reload_future.valid())
+        {
+            Base::Interop::RawRef<Interface::Script::IModule> reloaded_module = m_reload_future.get();
+            if(reloaded_module != nullptr)
+            {
+                m_script_engine->unloadModule(reloaded_module);
+            }
+            m_reload_future = WasmtimeEngine::ModuleFuture();
+        }
+        destroyTickSlots(m_tick_slots);
+        m_script_engine->unloadModule(m_script_module);
 
+        m_script_module = nullptr;
+        m_script_engine = nullptr;
     }
 }
 
@@ -5,9 +5,16 @@
 #include <wasmtime.hh>
 #include <unordered_map>
 #include <memory>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <vector>
 
 #include "interface/script/script.h"
 #include "interface/main/main_module.h"
+#include "engine/wasmtime_engine.h"
+#include "scheduler/wasmtime_script_scheduler.h"
 
 namespace Arieo
 {
@@ -21,7 +28,89 @@ namespace Arieo
         void onInitialize() override;
         void onTick() override;
         void onDeinitialize() override;
+
+        // Guest time spent in the most recent onTick
+        std::chrono::nanoseconds getLastFrameScriptTime() const { return m_last_frame_script_time; }
+
+        // Module of a 'script_preload' entry, spelled as in the manifest. Blocks only if it is still compiling,
+        // the module stays owned by the script manager.
+        Base::Interop::RawRef<Interface::Script::IModule> acquirePreloadedScript(const std::string& script_path);
     private:
+        static constexpr std::uint32_t REPORT_INTERVAL_FRAMES = 600;
+
+        // Slot 0 holds the entry instance that ran wasi:cli/run, every other slot starts from a fresh instantiation
+        struct TickSlot
+        {
+            Base::Interop::RawRef<Interface::Script::IContext> context = nullptr;
+            Base::Interop::RawRef<Interface::Script::IInstance> instance = nullptr;
+            void* tick_function = nullptr;
+            // Resolved from tick_function by bindTickFunction, called every frame without a lookup
+            WasmtimeTypedFunction<void()> typed_tick_function;
+            WasmtimeEngine::BudgetedCallResult last_result;
+        };
+
+        WasmtimeEngine::ModuleFuture loadScriptAsync(WasmtimeEngine* wasmtime_engine, Base::Interop::RawRef<Interface::Main::IMainModule> main_module, const std::string& script_path);
+        bool bindTickFunction(TickSlot& tick_slot);
+        void destroyTickSlots(std::vector<TickSlot>& tick_slots);
+
+        // Hot reload runs on the tick thread at the start of a frame. Scripts on disk are compared by write time.
+        // Archive entries have no metadata, so every poll acquires the whole entry from the archive on the tick thread
+        // and hashes it on a loader worker; the archive itself is never used off the tick thread.
+        bool hasScriptChanged(WasmtimeEngine* wasmtime_engine);
+        // Remembers the version running now, only later changes trigger a reload. Reads the script on the calling thread.
+        void recordScriptVersion();
+        // 0 when the entry is missing from the archive
+        static std::uint64_t hashArchiveScript(Base::Interop::RawRef<Interface::Main::IMainModule> main_module, const std::filesystem::path& script_path);
+        void pollHotReload(WasmtimeEngine* wasmtime_engine);
+        void swapScriptModule(Base::Interop::RawRef<Interface::Script::IModule> reloaded_module);
+        // Moves guest state through the save/load exports, false when either is missing or traps
+        bool transferState(TickSlot& from_slot, TickSlot& to_slot);
+        void recreateTickSlot(TickSlot& tick_slot);
+        void dumpMetrics(WasmtimeEngine* wasmtime_engine);
+
+        Base::Interop::RawRef<Interface::Script::IScriptEngine> m_script_engine = nullptr;
+        Base::Interop::RawRef<Interface::Script::IModule> m_script_module = nullptr;
+
+        Base::Interop::RawRef<Interface::Script::IScriptEngine> m_preload_script_engine = nullptr;
+        std::unordered_map<std::string, WasmtimeEngine::ModuleFuture> m_preloaded_scripts;
+
+        // Entry file name without extension, tags guest log lines of every slot
+        std::string m_script_name;
+        std::string m_tick_interface_name;
+        std::string m_tick_function_name;
+        std::vector<TickSlot> m_tick_slots;
+        // Only started when more than one tick slot is configured
+        WasmtimeScriptScheduler m_scheduler;
+
+        bool m_is_hot_reload = false;
+        Base::Interop::RawRef<Interface::Main::IMainModule> m_main_module = nullptr;
+        // Entry path with ${SCRIPT_DIR} resolved
+        std::string m_script_entry_path;
+        std::string m_save_state_function_name = "save-state";
+        std::string m_load_state_function_name = "load-state";
+        std::chrono::milliseconds m_hot_reload_poll_interval = std::chrono::milliseconds(500);
+        std::chrono::steady_clock::time_point m_next_hot_reload_poll_time;
+        std::filesystem::file_time_type m_script_write_time;
+        std::uint64_t m_script_content_hash = 0;
+        // Valid while an archive entry is hashed, picked up by the first poll after it is ready
+        std::future<std::uint64_t> m_script_hash_future;
+        // Entry being hashed, released on the tick thread once the hash is collected
+        WasmtimeArchiveFilesystem::ArchiveFileBuffer m_script_hash_buffer = nullptr;
+        // Valid while a changed entry is compiling
+        WasmtimeEngine::ModuleFuture m_reload_future;
+        std::chrono::steady_clock::time_point m_reload_start_time;
+
+        std::chrono::nanoseconds m_last_frame_script_time = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds m_report_script_time = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds m_report_wall_time = std::chrono::nanoseconds(0);
+        std::chrono::nanoseconds m_report_max_script_time = std::chrono::nanoseconds(0);
+        std::uint32_t m_report_frame_count = 0;
+        std::uint32_t m_report_deadline_miss_count = 0;
+        // Fuel of all tick slots per frame, only counted while script_engine.fuel is set
+        std::uint64_t m_report_fuel = 0;
+        std::uint64_t m_report_max_fuel = 0;
+        std::uint32_t m_report_fuel_exhausted_count = 0;
+        std::uint32_t m_metrics_frame_count = 0;
     };
 }
 
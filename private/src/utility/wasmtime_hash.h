@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace Arieo
+{
+    /**
+     * @brief 64-bit FNV-1a hashing used to key compiled artifacts and export lookups
+     */
+    namespace WasmtimeHash
+    {
+        constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+        constexpr std::uint64_t FNV_PRIME = 0x100000001b3ull;
+
+        inline std::uint64_t hashBytes(const void* data, size_t size, std::uint64_t seed = FNV_OFFSET_BASIS)
+        {
+            const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+            std::uint64_t hash = seed;
+            for(size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= FNV_PRIME;
+            }
+            return hash;
+        }
+
+        constexpr std::uint64_t hashString(std::string_view str, std::uint64_t seed = FNV_OFFSET_BASIS)
+        {
+            std::uint64_t hash = seed;
+            for(char c : str)
+            {
+                hash ^= static_cast<std::uint8_t>(c);
+                hash *= FNV_PRIME;
+            }
+            return hash;
+        }
+    }
+}
+
+
+
+
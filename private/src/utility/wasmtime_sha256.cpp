@@ -0,0 +1,124 @@
+#include "base/prerequisites.h"
+#include "wasmtime_sha256.h"
+
+namespace Arieo
+{
+    namespace
+    {
+        constexpr std::uint32_t SHA256_ROUND_CONSTANTS[64] =
+        {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        constexpr std::uint32_t rotateRight(std::uint32_t value, std::uint32_t count)
+        {
+            return (value >> count) | (value << (32 - count));
+        }
+
+        void processBlock(std::uint32_t state[8], const std::uint8_t* block)
+        {
+            std::uint32_t schedule[64];
+            for(size_t i = 0; i < 16; ++i)
+            {
+                schedule[i] = (std::uint32_t(block[i * 4]) << 24) | (std::uint32_t(block[i * 4 + 1]) << 16)
+                    | (std::uint32_t(block[i * 4 + 2]) << 8) | std::uint32_t(block[i * 4 + 3]);
+            }
+            for(size_t i = 16; i < 64; ++i)
+            {
+                std::uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+                std::uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+                schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+            }
+
+            std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for(size_t i = 0; i < 64; ++i)
+            {
+                std::uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+                std::uint32_t choose = (e & f) ^ (~e & g);
+                std::uint32_t temp1 = h + s1 + choose + SHA256_ROUND_CONSTANTS[i] + schedule[i];
+                std::uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+                std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+                std::uint32_t temp2 = s0 + majority;
+                h = g;
+                g = f;
+                f = e;
+                e = d + temp1;
+                d = c;
+                c = b;
+                b = a;
+                a = temp1 + temp2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    }
+
+    WasmtimeSha256::Digest WasmtimeSha256::hashBytes(const void* data, size_t size)
+    {
+        std::uint32_t state[8] =
+        {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+
+        const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+        size_t full_block_size = size - size % 64;
+        for(size_t offset = 0; offset < full_block_size; offset += 64)
+        {
+            processBlock(state, bytes + offset);
+        }
+
+        // Remaining bytes, the 0x80 terminator and the big endian bit length fill one or two final blocks
+        std::uint8_t tail[128] = {};
+        size_t tail_size = size - full_block_size;
+        for(size_t i = 0; i < tail_size; ++i)
+        {
+            tail[i] = bytes[full_block_size + i];
+        }
+        tail[tail_size] = 0x80;
+        size_t tail_block_size = tail_size < 56 ? 64 : 128;
+        std::uint64_t bit_length = std::uint64_t(size) * 8;
+        for(size_t i = 0; i < 8; ++i)
+        {
+            tail[tail_block_size - 1 - i] = static_cast<std::uint8_t>(bit_length >> (i * 8));
+        }
+        for(size_t offset = 0; offset < tail_block_size; offset += 64)
+        {
+            processBlock(state, tail + offset);
+        }
+
+        Digest digest;
+        for(size_t i = 0; i < 8; ++i)
+        {
+            digest[i * 4] = static_cast<std::uint8_t>(state[i] >> 24);
+            digest[i * 4 + 1] = static_cast<std::uint8_t>(state[i] >> 16);
+            digest[i * 4 + 2] = static_cast<std::uint8_t>(state[i] >> 8);
+            digest[i * 4 + 3] = static_cast<std::uint8_t>(state[i]);
+        }
+        return digest;
+    }
+
+    std::string WasmtimeSha256::toHexString(const Digest& digest)
+    {
+        constexpr const char* HEX_DIGITS = "0123456789abcdef";
+        std::string hex_string;
+        hex_string.reserve(digest.size() * 2);
+        for(std::uint8_t value : digest)
+        {
+            hex_string.push_back(HEX_DIGITS[value >> 4]);
+            hex_string.push_back(HEX_DIGITS[value & 0x0f]);
+        }
+        return hex_string;
+    }
+}
+
+
+
+
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace Arieo
+{
+    /**
+     * @brief SHA-256 digests identifying component binaries wherever a collision would run the wrong code
+     *
+     * WasmtimeHash stays the fast lookup hash, this is the identity of anything that is compiled,
+     * cached or shared by content.
+     */
+    namespace WasmtimeSha256
+    {
+        using Digest = std::array<std::uint8_t, 32>;
+
+        Digest hashBytes(const void* data, size_t size);
+        // Lower case, 64 characters
+        std::string toHexString(const Digest& digest);
+    }
+}
+
+
+
+
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Arieo
+{
+    /**
+     * @brief Components exercised by arieo_wasmtime_benchmark, kept in text form so the tool has no data files
+     *
+     * Linear memory lives in its own core module so the host imports can be lowered against it before the
+     * main module is instantiated. Every export lives in the arieo:bench/bench instance.
+     */
+    namespace WasmtimeBenchmarkComponents
+    {
+        constexpr const char* BENCH_INTERFACE = "arieo:bench/bench";
+        // Interface id and checksum the get-interface exports ask for, registered by the benchmark itself
+        constexpr std::uint64_t BENCH_INTERFACE_ID = 1;
+        constexpr std::uint64_t BENCH_INTERFACE_CHECKSUM = 2;
+        // Instance name of get-interface-once, get-interface-uncached asks for "uncached"
+        constexpr const char* BENCH_INSTANCE_NAME = "bench";
+
+        constexpr const char* BENCH_COMPONENT_WAT = R"WAT(
+(component
+  (import "arieo:application/host" (instance $host
+    (export "log" (func (param "msg" string)))
+  ))
+  (import "arieo:module/module-manager" (instance $module_manager
+    (export "get-interface" (func (param "interface-id" u64) (param "interface-checksum" u64) (param "instance-name" string) (result u64)))
+  ))
+
+  (core module $Memory
+    (memory (export "memory") 1)
+    (data (i32.const 16) "bench")
+    (data (i32.const 32) "uncached")
+  )
+  (core instance $memory (instantiate $Memory))
+
+  (core func $log (canon lower (func $host "log") (memory $memory "memory")))
+  (core func $get_interface (canon lower (func $module_manager "get-interface") (memory $memory "memory")))
+
+  (core module $Main
+    (import "host" "log" (func $log (param i32 i32)))
+    (import "module-manager" "get-interface" (func $get_interface (param i64 i64 i32 i32) (result i64)))
+    (global $counter (mut i32) (i32.const 0))
+
+    (func (export "noop"))
+    (func (export "add") (param i32 i32) (result i32)
+      local.get 0
+      local.get 1
+      i32.add)
+    (func (export "counter") (result i32)
+      global.get $counter
+      i32.const 1
+      i32.add
+      global.set $counter
+      global.get $counter)
+    (func (export "spin") (param $count i32) (result i32)
+      (local $acc i32)
+      (block $done
+        (loop $next
+          local.get $count
+          i32.eqz
+          br_if $done
+          local.get $acc
+          local.get $count
+          i32.xor
+          i32.const 31
+          i32.mul
+          local.set $acc
+          local.get $count
+          i32.const 1
+          i32.sub
+          local.set $count
+          br $next))
+      local.get $acc)
+    (func (export "log-once")
+      (call $log (i32.const 16) (i32.const 5)))
+    (func (export "get-interface-once") (result i64)
+      (call $get_interface (i64.const 1) (i64.const 2) (i32.const 16) (i32.const 5)))
+    (func (export "get-interface-uncached") (result i64)
+      (call $get_interface (i64.const 1) (i64.const 2) (i32.const 32) (i32.const 8)))
+  )
+  (core instance $main (instantiate $Main
+    (with "host" (instance (export "log" (func $log))))
+    (with "module-manager" (instance (export "get-interface" (func $get_interface))))
+  ))
+
+  (func $noop (canon lift (core func $main "noop")))
+  (func $add (param "a" s32) (param "b" s32) (result s32) (canon lift (core func $main "add")))
+  (func $counter (result u32) (canon lift (core func $main "counter")))
+  (func $spin (param "count" u32) (result u32) (canon lift (core func $main "spin")))
+  (func $log_once (canon lift (core func $main "log-once")))
+  (func $get_interface_once (result u64) (canon lift (core func $main "get-interface-once")))
+  (func $get_interface_uncached (result u64) (canon lift (core func $main "get-interface-uncached")))
+
+  (instance $bench
+    (export "noop" (func $noop))
+    (export "add" (func $add))
+    (export "counter" (func $counter))
+    (export "spin" (func $spin))
+    (export "log-once" (func $log_once))
+    (export "get-interface-once" (func $get_interface_once))
+    (export "get-interface-uncached" (func $get_interface_uncached))
+  )
+  (export "arieo:bench/bench" (instance $bench))
+)
+)WAT";
+    }
+}
+
+
+
+
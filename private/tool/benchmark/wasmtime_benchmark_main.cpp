@@ -0,0 +1,558 @@
+#include "base/prerequisites.h"
+#include "core/core.h"
+#include "core/config/config.h"
+#include "core/manifest/manifest.h"
+
+#include "../../src/engine/wasmtime_engine.h"
+#include "../../src/engine/wasmtime_engine_config.h"
+#include "../../src/context/wasmtime_context.h"
+#include "../../src/instance/wasmtime_instance.h"
+#include "wasmtime_benchmark_components.h"
+
+#include <wasmtime.hh>
+#include <wasmtime/component.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless benchmark of the script engine hot paths.
+// Drives WasmtimeEngine directly with the bundled components, so neither the main module nor linker
+// libraries are needed. Every result is one CSV row; compare runs with the same manifest and build type.
+// host_import/log only runs with script_engine.guest_log enabled, so it times the import and the ring push rather than logger I/O.
+// With script_engine.fuel in the manifest the fuel/* rows add fuel_per_op, which is identical on every machine
+// and is the column to gate CI on.
+// Before measuring, the untyped call path runs once against an export without and one with a result, directly
+// and as an async call, the tool exits with 1 if any of these calls fails or loses the result.
+//
+// Usage:
+//   arieo_wasmtime_benchmark [--manifest <manifest.yaml>] [--iterations <count>] [--threads <max threads>] [--output <results.csv>]
+using namespace Arieo;
+
+namespace
+{
+    struct BenchmarkResult
+    {
+        std::string name;
+        size_t iterations = 0;
+        double total_ms = 0.0;
+        double mean_ns = 0.0;
+        double p50_ns = 0.0;
+        double p99_ns = 0.0;
+        double ops_per_sec = 0.0;
+        // Only set by the fuel benchmarks
+        double fuel_per_op = 0.0;
+    };
+
+    class BenchmarkReport
+    {
+    public:
+        void add(const BenchmarkResult& result)
+        {
+            m_results.push_back(result);
+            std::cerr << result.name << ": mean " << result.mean_ns << " ns, p99 " << result.p99_ns << " ns" << std::endl;
+        }
+
+        std::string toCsv() const
+        {
+            std::ostringstream csv;
+            csv << "benchmark,iterations,total_ms,mean_ns,p50_ns,p99_ns,ops_per_sec,fuel_per_op" << std::endl;
+            for(const BenchmarkResult& result : m_results)
+            {
+                csv << result.name << "," << result.iterations << "," << result.total_ms << "," << result.mean_ns << ","
+                    << result.p50_ns << "," << result.p99_ns << "," << result.ops_per_sec << "," << result.fuel_per_op << std::endl;
+            }
+            return csv.str();
+        }
+    private:
+        std::vector<BenchmarkResult> m_results;
+    };
+
+    BenchmarkResult summarize(const std::string& name, std::vector<std::chrono::nanoseconds>& samples)
+    {
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = samples.size();
+        if(samples.empty())
+        {
+            return result;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        std::chrono::nanoseconds total(0);
+        for(std::chrono::nanoseconds sample : samples)
+        {
+            total += sample;
+        }
+        result.total_ms = std::chrono::duration<double, std::milli>(total).count();
+        result.mean_ns = static_cast<double>(total.count()) / static_cast<double>(samples.size());
+        result.p50_ns = static_cast<double>(samples[samples.size() / 2].count());
+        result.p99_ns = static_cast<double>(samples[std::min(samples.size() - 1, samples.size() * 99 / 100)].count());
+        result.ops_per_sec = result.mean_ns > 0 ? 1e9 / result.mean_ns : 0.0;
+        return result;
+    }
+
+    // Times each iteration separately, setup and teardown run outside the measured region
+    BenchmarkResult measure(const std::string& name, size_t iterations, const std::function<void()>& body)
+    {
+        std::vector<std::chrono::nanoseconds> samples;
+        samples.reserve(iterations);
+        for(size_t i = 0; i < iterations; ++i)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            body();
+            samples.push_back(std::chrono::steady_clock::now() - start_time);
+        }
+        return summarize(name, samples);
+    }
+
+    void benchmarkCompile(BenchmarkReport& report, const std::vector<uint8_t>& component_binary, size_t iterations)
+    {
+        for(std::string_view profile_name : WasmtimeEngineConfig::getProfileNames())
+        {
+            WasmtimeEngineProfile profile = WasmtimeEngineConfig::getProfile(profile_name).value();
+            wasmtime::Engine engine(WasmtimeEngineConfig::createConfig(profile));
+            report.add(measure("compile/" + profile.name, iterations, [&]()
+            {
+                wasmtime::component::Component::compile(
+                    engine,
+                    wasmtime::Span<uint8_t>(const_cast<uint8_t*>(component_binary.data()), component_binary.size())
+                ).unwrap();
+            }));
+        }
+    }
+
+    void benchmarkDeserialize(BenchmarkReport& report, const WasmtimeEngineProfile& profile, const std::vector<uint8_t>& component_binary, size_t iterations)
+    {
+        wasmtime::Engine engine(WasmtimeEngineConfig::createConfig(profile));
+        std::vector<uint8_t> serialized = wasmtime::component::Component::compile(
+            engine,
+            wasmtime::Span<uint8_t>(const_cast<uint8_t*>(component_binary.data()), component_binary.size())
+        ).unwrap().serialize().unwrap();
+
+        report.add(measure("deserialize/" + profile.name, iterations, [&]()
+        {
+            wasmtime::component::Component::deserialize(engine, wasmtime::Span<uint8_t>(serialized.data(), serialized.size())).unwrap();
+        }));
+    }
+
+    struct BenchInstance
+    {
+        Base::Interop::RawRef<Interface::Script::IContext> context = nullptr;
+        Base::Interop::RawRef<Interface::Script::IInstance> instance = nullptr;
+        void* interface = nullptr;
+    };
+
+    BenchInstance createBenchInstance(WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module)
+    {
+        BenchInstance bench_instance;
+        bench_instance.context = engine.createContext();
+        bench_instance.instance = engine.createInstance(bench_instance.context, module);
+        if(bench_instance.instance != nullptr)
+        {
+            bench_instance.interface = bench_instance.instance->queryInterface(WasmtimeBenchmarkComponents::BENCH_INTERFACE);
+        }
+        return bench_instance;
+    }
+
+    void destroyBenchInstance(WasmtimeEngine& engine, BenchInstance& bench_instance)
+    {
+        if(bench_instance.instance != nullptr)
+        {
+            engine.destroyInstance(bench_instance.instance);
+        }
+        engine.destroyContext(bench_instance.context);
+        bench_instance = BenchInstance();
+    }
+
+    template<typename Signature>
+    WasmtimeTypedFunction<Signature> getBenchFunction(BenchInstance& bench_instance, const std::string& function_name)
+    {
+        WasmtimeInstance* wasmtime_instance = bench_instance.instance.castToInstance<WasmtimeInstance>();
+        return wasmtime_instance->getTypedFunction<Signature>(wasmtime_instance->queryFunction(bench_instance.interface, function_name));
+    }
+
+    // callFunction only logs failures, so this goes through callFunctionWithResult, the call callFunction wraps
+    bool checkUntypedCalls(WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module)
+    {
+        BenchInstance bench_instance = createBenchInstance(engine, module);
+        if(bench_instance.interface == nullptr)
+        {
+            std::cerr << "Bench component did not instantiate, cannot check untyped calls" << std::endl;
+            destroyBenchInstance(engine, bench_instance);
+            return false;
+        }
+
+        bool is_passed = true;
+        WasmtimeInstance* wasmtime_instance = bench_instance.instance.castToInstance<WasmtimeInstance>();
+        void* noop_function = wasmtime_instance->queryFunction(bench_instance.interface, "noop");
+        void* counter_function = wasmtime_instance->queryFunction(bench_instance.interface, "counter");
+
+        wasmtime::Result<WasmtimeCallResult> noop_result = wasmtime_instance->callFunctionWithResult(noop_function);
+        if(!noop_result || noop_result.ok().hasValue())
+        {
+            std::cerr << "Untyped call of 'noop' failed or returned a value" << std::endl;
+            is_passed = false;
+        }
+
+        std::uint32_t counter = 0;
+        wasmtime::Result<WasmtimeCallResult> counter_result = wasmtime_instance->callFunctionWithResult(counter_function);
+        if(!counter_result || counter_result.ok().lift(counter) == false || counter != 1)
+        {
+            std::cerr << "Untyped call of 'counter' failed or lost its result" << std::endl;
+            is_passed = false;
+        }
+
+        // Nothing in the bench component suspends, so the async call completes before callFunctionAsync returns
+        WasmtimeAsyncCall* async_call = engine.callFunctionAsync(bench_instance.instance, counter_function);
+        if(async_call->isDone() == false || async_call->isFailed() || async_call->getResult().lift(counter) == false || counter != 2)
+        {
+            std::cerr << "Async call of 'counter' failed or lost its result" << std::endl;
+            is_passed = false;
+        }
+        engine.destroyAsyncCall(async_call);
+
+        destroyBenchInstance(engine, bench_instance);
+        return is_passed;
+    }
+
+    void benchmarkEngine(BenchmarkReport& report, WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module, size_t iterations)
+    {
+        std::vector<Base::Interop::RawRef<Interface::Script::IContext>> contexts(iterations, nullptr);
+        size_t context_index = 0;
+        report.add(measure("create_context", iterations, [&]()
+        {
+            contexts[context_index++] = engine.createContext();
+        }));
+
+        std::vector<Base::Interop::RawRef<Interface::Script::IInstance>> instances(iterations, nullptr);
+        size_t instance_index = 0;
+        report.add(measure("create_instance", iterations, [&]()
+        {
+            instances[instance_index] = engine.createInstance(contexts[instance_index], module);
+            instance_index++;
+        }));
+
+        for(size_t i = 0; i < iterations; ++i)
+        {
+            if(instances[i] != nullptr)
+            {
+                engine.destroyInstance(instances[i]);
+            }
+            engine.destroyContext(contexts[i]);
+        }
+
+        BenchInstance bench_instance = createBenchInstance(engine, module);
+        if(bench_instance.interface == nullptr)
+        {
+            std::cerr << "Bench component did not instantiate, skipping call benchmarks" << std::endl;
+            destroyBenchInstance(engine, bench_instance);
+            return;
+        }
+
+        Base::Interop::RawRef<Interface::Script::IInstance> instance = bench_instance.instance;
+        report.add(measure("query_interface", iterations, [&]()
+        {
+            instance->queryInterface(WasmtimeBenchmarkComponents::BENCH_INTERFACE);
+        }));
+        report.add(measure("query_function", iterations, [&]()
+        {
+            instance->queryFunction(bench_instance.interface, "counter");
+        }));
+
+        void* counter_function = instance->queryFunction(bench_instance.interface, "counter");
+        report.add(measure("call_function", iterations, [&]()
+        {
+            instance->callFunction(counter_function);
+        }));
+
+        void* noop_function = instance->queryFunction(bench_instance.interface, "noop");
+        report.add(measure("call_function/noop", iterations, [&]()
+        {
+            instance->callFunction(noop_function);
+        }));
+
+        WasmtimeTypedFunction<void()> noop = getBenchFunction<void()>(bench_instance, "noop");
+        report.add(measure("typed_call/noop", iterations, [&]()
+        {
+            noop().unwrap();
+        }));
+
+        WasmtimeTypedFunction<std::int32_t(std::int32_t, std::int32_t)> add = getBenchFunction<std::int32_t(std::int32_t, std::int32_t)>(bench_instance, "add");
+        report.add(measure("typed_call/add", iterations, [&]()
+        {
+            add(1, 2).unwrap();
+        }));
+
+        // Without the pipeline every call is a synchronous Core::Logger write, which measures the logger and not the import
+        if(engine.getGuestLogConfig().is_enabled)
+        {
+            WasmtimeTypedFunction<void()> log_once = getBenchFunction<void()>(bench_instance, "log-once");
+            report.add(measure("host_import/log", iterations, [&]()
+            {
+                log_once().unwrap();
+            }));
+        }
+        else
+        {
+            std::cerr << "script_engine.guest_log is not enabled in the manifest, skipping host_import/log" << std::endl;
+        }
+
+        // The bench interface is registered with the engine but not with ModuleManager, so a cached handle is planted
+        // for "bench". get_interface is the steady state cache hit, get_interface_lookup misses the cache and pays
+        // the interface table probe, the checksum check and ModuleManager's lookup of an unknown instance.
+        WasmtimeContext* wasmtime_context = bench_instance.context.castToInstance<WasmtimeContext>();
+        wasmtime_context->getInterfaceHandleCache().insert(
+            WasmtimeBenchmarkComponents::BENCH_INTERFACE_ID,
+            WasmtimeBenchmarkComponents::BENCH_INTERFACE_CHECKSUM,
+            WasmtimeBenchmarkComponents::BENCH_INSTANCE_NAME,
+            reinterpret_cast<std::uint64_t>(wasmtime_context));
+
+        WasmtimeTypedFunction<std::uint64_t()> get_interface_once = getBenchFunction<std::uint64_t()>(bench_instance, "get-interface-once");
+        report.add(measure("host_import/get_interface", iterations, [&]()
+        {
+            get_interface_once().unwrap();
+        }));
+
+        WasmtimeTypedFunction<std::uint64_t()> get_interface_uncached = getBenchFunction<std::uint64_t()>(bench_instance, "get-interface-uncached");
+        report.add(measure("host_import/get_interface_lookup", iterations, [&]()
+        {
+            get_interface_uncached().unwrap();
+        }));
+
+        destroyBenchInstance(engine, bench_instance);
+    }
+
+    // Metered calls through the same path as script ticks, fuel_per_op only changes when the guest code or wasmtime's fuel costs do
+    void benchmarkFuel(BenchmarkReport& report, WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module, size_t iterations)
+    {
+        if(engine.getFuelConfig().is_enabled == false)
+        {
+            return;
+        }
+
+        BenchInstance bench_instance = createBenchInstance(engine, module);
+        if(bench_instance.interface == nullptr)
+        {
+            std::cerr << "Bench component did not instantiate, skipping fuel benchmarks" << std::endl;
+            destroyBenchInstance(engine, bench_instance);
+            return;
+        }
+
+        WasmtimeContext* wasmtime_context = bench_instance.context.castToInstance<WasmtimeContext>();
+        auto measureFuel = [&](const std::string& name, const std::function<void()>& body)
+        {
+            std::uint64_t total_fuel = 0;
+            BenchmarkResult result = measure(name, iterations, [&]()
+            {
+                wasmtime_context->beginFuelMeter();
+                body();
+                // The body unwraps its call, only a successful call gets here
+                total_fuel += wasmtime_context->endFuelMeter(false).fuel_consumed;
+            });
+            result.fuel_per_op = static_cast<double>(total_fuel) / static_cast<double>(iterations);
+            report.add(result);
+        };
+
+        WasmtimeTypedFunction<void()> noop = getBenchFunction<void()>(bench_instance, "noop");
+        measureFuel("fuel/noop", [&]()
+        {
+            noop().unwrap();
+        });
+
+        WasmtimeTypedFunction<std::int32_t(std::int32_t, std::int32_t)> add = getBenchFunction<std::int32_t(std::int32_t, std::int32_t)>(bench_instance, "add");
+        measureFuel("fuel/add", [&]()
+        {
+            add(1, 2).unwrap();
+        });
+
+        constexpr std::uint32_t SPIN_COUNT = 1000;
+        WasmtimeTypedFunction<std::uint32_t(std::uint32_t)> spin = getBenchFunction<std::uint32_t(std::uint32_t)>(bench_instance, "spin");
+        measureFuel("fuel/spin", [&]()
+        {
+            spin(SPIN_COUNT).unwrap();
+        });
+
+        destroyBenchInstance(engine, bench_instance);
+    }
+
+    // Every thread owns one store and calls into it back to back, reported ops are calls across all threads
+    void benchmarkConcurrentStores(BenchmarkReport& report, WasmtimeEngine& engine, Base::Interop::RawRef<Interface::Script::IModule> module, size_t iterations, size_t max_thread_count)
+    {
+        constexpr std::uint32_t SPIN_COUNT = 1000;
+        for(size_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2)
+        {
+            std::vector<BenchInstance> bench_instances;
+            for(size_t i = 0; i < thread_count; ++i)
+            {
+                bench_instances.push_back(createBenchInstance(engine, module));
+            }
+
+            std::atomic<bool> is_started = false;
+            std::vector<std::thread> threads;
+            for(size_t i = 0; i < thread_count; ++i)
+            {
+                threads.emplace_back([&, i]()
+                {
+                    WasmtimeTypedFunction<std::uint32_t(std::uint32_t)> spin = getBenchFunction<std::uint32_t(std::uint32_t)>(bench_instances[i], "spin");
+                    while(is_started == false)
+                    {
+                        std::this_thread::yield();
+                    }
+                    for(size_t j = 0; j < iterations; ++j)
+                    {
+                        spin(SPIN_COUNT).unwrap();
+                    }
+                });
+            }
+            auto start_time = std::chrono::steady_clock::now();
+            is_started = true;
+            for(std::thread& thread : threads)
+            {
+                thread.join();
+            }
+            std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start_time;
+
+            BenchmarkResult result;
+            result.name = "concurrent_stores/" + std::to_string(thread_count);
+            result.iterations = iterations * thread_count;
+            result.total_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+            // Wall time per call as seen by one thread, flat when stores scale perfectly
+            result.mean_ns = static_cast<double>(elapsed.count()) / static_cast<double>(iterations);
+            result.p50_ns = result.mean_ns;
+            result.p99_ns = result.mean_ns;
+            result.ops_per_sec = static_cast<double>(result.iterations) / std::chrono::duration<double>(elapsed).count();
+            report.add(result);
+
+            for(BenchInstance& bench_instance : bench_instances)
+            {
+                destroyBenchInstance(engine, bench_instance);
+            }
+        }
+    }
+
+    int printUsage(const char* program_name)
+    {
+        std::cerr << "Usage: " << program_name << " [--manifest <manifest.yaml>] [--iterations <count>] [--threads <max threads>] [--output <results.csv>]" << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string manifest_path;
+    std::string output_path;
+    size_t iterations = 1000;
+    size_t max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if(arg == "--manifest" && i + 1 < argc)
+        {
+            manifest_path = argv[++i];
+        }
+        else if(arg == "--iterations" && i + 1 < argc)
+        {
+            iterations = std::max<size_t>(1, std::stoull(argv[++i]));
+        }
+        else if(arg == "--threads" && i + 1 < argc)
+        {
+            max_thread_count = std::max<size_t>(1, std::stoull(argv[++i]));
+        }
+        else if(arg == "--output" && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else
+        {
+            return printUsage(argv[0]);
+        }
+    }
+
+    Core::Logger::setDefaultLogger("wasmtime");
+
+    // Same system node the module reads, an empty manifest runs with the default profile
+    std::string manifest_content;
+    if(manifest_path.empty() == false)
+    {
+        std::ifstream manifest_file(manifest_path);
+        if(manifest_file.is_open() == false)
+        {
+            std::cerr << "Failed to open manifest: " << manifest_path << std::endl;
+            return 1;
+        }
+        manifest_content.assign((std::istreambuf_iterator<char>(manifest_file)), std::istreambuf_iterator<char>());
+    }
+    Core::Manifest manifest;
+    manifest.loadFromString(manifest_content);
+
+    wasmtime::Result<std::vector<uint8_t>> wat_result = wasmtime::wat2wasm(WasmtimeBenchmarkComponents::BENCH_COMPONENT_WAT);
+    if(!wat_result)
+    {
+        std::cerr << "Failed to assemble bench component: " << wat_result.err().message() << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> component_binary = wat_result.unwrap();
+
+    BenchmarkReport report;
+    // Compilation is slow, a hundredth of the iterations keeps the suite in the same ballpark as the call benchmarks
+    size_t compile_iterations = std::max<size_t>(1, iterations / 100);
+    benchmarkCompile(report, component_binary, compile_iterations);
+
+    WasmtimeEngine engine;
+    engine.initialize(manifest.getSystemNode());
+
+    // Answers the bench component's get-interface calls from the interface table instead of the not-found path
+    Lib::WasmtimeLinker::InterfaceExportInfo bench_interface_export_info = {};
+    bench_interface_export_info.m_interaface_id = WasmtimeBenchmarkComponents::BENCH_INTERFACE_ID;
+    bench_interface_export_info.m_interface_checksum = WasmtimeBenchmarkComponents::BENCH_INTERFACE_CHECKSUM;
+    engine.registerInterfaceExport(&bench_interface_export_info);
+    benchmarkDeserialize(report, engine.getProfile(), component_binary, std::max<size_t>(1, iterations / 10));
+
+    Base::Interop::RawRef<Interface::Script::IModule> module = engine.loadModuleFromCompiledBinary(component_binary.data(), component_binary.size());
+    if(module == nullptr)
+    {
+        std::cerr << "Failed to load bench component" << std::endl;
+        engine.shutdown();
+        return 1;
+    }
+
+    if(checkUntypedCalls(engine, module) == false)
+    {
+        engine.unloadModule(module);
+        engine.shutdown();
+        return 1;
+    }
+
+    benchmarkEngine(report, engine, module, iterations);
+    benchmarkFuel(report, engine, module, iterations);
+    benchmarkConcurrentStores(report, engine, module, iterations, max_thread_count);
+
+    engine.unloadModule(module);
+    engine.shutdown();
+
+    std::string csv = report.toCsv();
+    std::cout << csv;
+    if(output_path.empty() == false)
+    {
+        std::ofstream output_file(output_path, std::ios::trunc);
+        output_file << csv;
+        if(output_file.good() == false)
+        {
+            std::cerr << "Failed to write " << output_path << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+
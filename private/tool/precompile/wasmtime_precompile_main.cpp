@@ -0,0 +1,451 @@
+#include "../../src/engine/wasmtime_engine_config.h"
+
+#include <wasmtime.hh>
+#include <wasmtime/component.hh>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <charconv>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
+extern char** environ;
+#endif
+
+// Offline compiler for script components.
+// Writes the Component::serialize output that WasmtimeEngine::loadModuleFromPrecompiledFile maps at runtime.
+// The profile must match 'script_engine.profile' of the manifest that loads the artifact, and every key the
+// manifest sets under 'script_engine.profile_overrides' has to be passed as --override with the same value,
+// otherwise the fingerprint differs and the runtime rejects the artifact.
+//
+// --compare-profiles only reports compile time and artifact size. Generated code speed is measured by running
+// arieo_wasmtime_benchmark once per profile, with a manifest that selects it.
+//
+// --snapshot runs the given init export once through 'wasmtime wizer' and compiles the resulting image, so
+// instances start from the pre-initialized linear memory and globals instead of redoing guest setup.
+// With --snapshot-only the snapshotted component itself is written, which suits archives that ship .wasm
+// and rely on the component cache; the snapshot hashes differently, so it never aliases the original entry.
+//
+// Usage:
+//   arieo_wasmtime_precompile [--profile <debug|release|size>] [--override <key>=<value>]... [--epoch-interruption] [--consume-fuel]
+//                             [--snapshot <init-export> [--snapshot-only] [--wasmtime <path>]] <input.wasm> [output]
+//   arieo_wasmtime_precompile --compare-profiles <input.wasm>
+using namespace Arieo;
+
+namespace
+{
+    struct CompileResult
+    {
+        bool is_succeeded = false;
+        double compile_ms = 0.0;
+        std::vector<uint8_t> serialized;
+    };
+
+    CompileResult compileWithProfile(const WasmtimeEngineProfile& profile, const std::vector<uint8_t>& input_buffer, const std::filesystem::path& input_path)
+    {
+        CompileResult result;
+        wasmtime::Engine engine(WasmtimeEngineConfig::createConfig(profile));
+
+        auto start_time = std::chrono::steady_clock::now();
+        wasmtime::Result<wasmtime::component::Component> compile_result = wasmtime::component::Component::compile(
+            engine,
+            wasmtime::Span<uint8_t>(const_cast<uint8_t*>(input_buffer.data()), input_buffer.size())
+        );
+        result.compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        if(!compile_result)
+        {
+            std::cerr << "Failed to compile " << input_path.string() << " with profile '" << profile.name << "': " << compile_result.err().message() << std::endl;
+            return result;
+        }
+
+        wasmtime::Result<std::vector<uint8_t>> serialize_result = compile_result.unwrap().serialize();
+        if(!serialize_result)
+        {
+            std::cerr << "Failed to serialize " << input_path.string() << ": " << serialize_result.err().message() << std::endl;
+            return result;
+        }
+        result.serialized = serialize_result.unwrap();
+        result.is_succeeded = true;
+        return result;
+    }
+
+    // Mirrors the profile_overrides keys WasmtimeEngine::parseEngineProfile reads from the manifest
+    bool applyProfileOverride(WasmtimeEngineProfile& profile, std::string_view key, std::string_view value)
+    {
+        auto parse_bool = [value](bool& field)
+        {
+            if(value == "true" || value == "false")
+            {
+                field = value == "true";
+                return true;
+            }
+            return false;
+        };
+        auto parse_bytes = [value](std::uint64_t& field)
+        {
+            std::from_chars_result parse_result = std::from_chars(value.data(), value.data() + value.size(), field);
+            return parse_result.ec == std::errc() && parse_result.ptr == value.data() + value.size();
+        };
+
+        if(key == "opt_level")
+        {
+            std::optional<wasmtime::OptLevel> opt_level = WasmtimeEngineConfig::parseOptLevel(value);
+            if(opt_level.has_value())
+            {
+                profile.opt_level = opt_level.value();
+            }
+            return opt_level.has_value();
+        }
+        if(key == "debug_info") return parse_bool(profile.debug_info);
+        if(key == "native_unwind_info") return parse_bool(profile.native_unwind_info);
+        if(key == "parallel_compilation") return parse_bool(profile.parallel_compilation);
+        if(key == "simd") return parse_bool(profile.simd);
+        if(key == "relaxed_simd") return parse_bool(profile.relaxed_simd);
+        if(key == "epoch_interruption") return parse_bool(profile.epoch_interruption);
+        if(key == "consume_fuel") return parse_bool(profile.consume_fuel);
+        if(key == "memory_reservation") return parse_bytes(profile.memory_reservation);
+        if(key == "memory_guard_size") return parse_bytes(profile.memory_guard_size);
+        if(key == "memory_reservation_for_growth") return parse_bytes(profile.memory_reservation_for_growth);
+        return false;
+    }
+
+    // Compiles the input once per built-in profile and prints compile time and code size side by side.
+    // Runtime speed of the generated code is not measured here, see arieo_wasmtime_benchmark.
+    int compareProfiles(const std::vector<uint8_t>& input_buffer, const std::filesystem::path& input_path)
+    {
+        std::cout << "profile,compile_ms,artifact_bytes,settings" << std::endl;
+        for(std::string_view profile_name : WasmtimeEngineConfig::getProfileNames())
+        {
+            WasmtimeEngineProfile profile = WasmtimeEngineConfig::getProfile(profile_name).value();
+            CompileResult result = compileWithProfile(profile, input_buffer, input_path);
+            if(result.is_succeeded == false)
+            {
+                return 1;
+            }
+            std::cout << profile.name << "," << result.compile_ms << "," << result.serialized.size()
+                << ",\"" << WasmtimeEngineConfig::describe(profile) << "\"" << std::endl;
+        }
+        return 0;
+    }
+
+    struct SnapshotOptions
+    {
+        std::string init_export;
+        std::string wasmtime_command = "wasmtime";
+        bool is_snapshot_only = false;
+    };
+
+    using NativeString = std::filesystem::path::string_type;
+
+    // Starts the program with an argument vector and waits for it, no shell ever parses the arguments.
+    // Returns the exit code, or -1 when the process could not be started or did not exit normally.
+    int runProcess(const std::vector<NativeString>& args)
+    {
+#if defined(_WIN32)
+        // CreateProcessW takes one command line that the child splits again with the CommandLineToArgvW rules,
+        // quote every argument so quotes and backslashes survive that split unchanged
+        std::wstring command_line;
+        for(const std::wstring& arg : args)
+        {
+            if(command_line.empty() == false)
+            {
+                command_line += L' ';
+            }
+            command_line += L'"';
+            size_t backslash_count = 0;
+            for(wchar_t c : arg)
+            {
+                if(c == L'\\')
+                {
+                    ++backslash_count;
+                    continue;
+                }
+                // Backslashes are only special in front of a quote, there they have to be doubled
+                command_line.append(c == L'"' ? backslash_count * 2 + 1 : backslash_count, L'\\');
+                command_line += c;
+                backslash_count = 0;
+            }
+            command_line.append(backslash_count * 2, L'\\');
+            command_line += L'"';
+        }
+
+        STARTUPINFOW startup_info = {};
+        startup_info.cb = sizeof(startup_info);
+        PROCESS_INFORMATION process_info = {};
+        if(CreateProcessW(nullptr, command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup_info, &process_info) == FALSE)
+        {
+            return -1;
+        }
+        WaitForSingleObject(process_info.hProcess, INFINITE);
+        DWORD exit_code = 0;
+        bool is_exit_code_read = GetExitCodeProcess(process_info.hProcess, &exit_code) != FALSE;
+        CloseHandle(process_info.hThread);
+        CloseHandle(process_info.hProcess);
+        return is_exit_code_read ? static_cast<int>(exit_code) : -1;
+#else
+        std::vector<char*> argv;
+        for(const std::string& arg : args)
+        {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid = 0;
+        if(posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        {
+            return -1;
+        }
+        int status = 0;
+        while(waitpid(pid, &status, 0) == -1)
+        {
+            if(errno != EINTR)
+            {
+                return -1;
+            }
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+    }
+
+    // Capturing guest state needs instrumentation the C API does not offer, so the wizer built into the
+    // wasmtime CLI produces the image and this tool only compiles it
+    std::optional<std::vector<uint8_t>> snapshotComponent(const std::filesystem::path& input_path, const std::filesystem::path& output_path, const SnapshotOptions& options)
+    {
+        std::filesystem::path snapshot_path = output_path;
+        snapshot_path += ".snapshot.wasm";
+
+        std::vector<NativeString> args = {
+            std::filesystem::path(options.wasmtime_command).native(),
+            std::filesystem::path("wizer").native(),
+            std::filesystem::path("--init-func").native(),
+            std::filesystem::path(options.init_export).native(),
+            std::filesystem::path("-o").native(),
+            snapshot_path.native(),
+            input_path.native(),
+        };
+        auto start_time = std::chrono::steady_clock::now();
+        int exit_code = runProcess(args);
+        double snapshot_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        if(exit_code != 0)
+        {
+            std::cerr << "Snapshot of " << input_path.string() << " failed (exit code " << exit_code << "): " << options.wasmtime_command
+                << " wizer --init-func " << options.init_export << " -o " << snapshot_path.string() << " " << input_path.string() << std::endl;
+            return std::nullopt;
+        }
+
+        std::ifstream snapshot_file(snapshot_path, std::ios::binary);
+        std::vector<uint8_t> snapshot_buffer((std::istreambuf_iterator<char>(snapshot_file)), std::istreambuf_iterator<char>());
+        snapshot_file.close();
+        std::error_code ec;
+        std::filesystem::remove(snapshot_path, ec);
+        if(snapshot_buffer.empty())
+        {
+            std::cerr << "Snapshot of " << input_path.string() << " produced no output" << std::endl;
+            return std::nullopt;
+        }
+
+        std::cout << "Snapshotted " << input_path.string() << " after '" << options.init_export << "' in " << snapshot_ms << " ms" << std::endl;
+        return snapshot_buffer;
+    }
+
+    bool writeOutput(const std::filesystem::path& output_path, const std::vector<uint8_t>& buffer)
+    {
+        std::filesystem::path temp_path = output_path;
+        temp_path += ".tmp";
+        {
+            std::ofstream output_file(temp_path, std::ios::binary | std::ios::trunc);
+            output_file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            if(output_file.good() == false)
+            {
+                std::cerr << "Failed to write " << temp_path.string() << std::endl;
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_path, output_path, ec);
+        if(ec)
+        {
+            std::cerr << "Failed to write " << output_path.string() << ": " << ec.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    int printUsage(const char* program_name)
+    {
+        std::cerr << "Usage: " << program_name << " [--profile <debug|release|size>] [--override <key>=<value>]... [--epoch-interruption] [--consume-fuel]"
+            << " [--snapshot <init-export> [--snapshot-only] [--wasmtime <path>]] <input.wasm> [output" << WasmtimeEngineConfig::PRECOMPILED_EXTENSION << "]" << std::endl;
+        std::cerr << "       " << program_name << " --compare-profiles <input.wasm>" << std::endl;
+        std::cerr << "Override keys are those of script_engine.profile_overrides: opt_level, debug_info, native_unwind_info,"
+            << " parallel_compilation, simd, relaxed_simd, epoch_interruption, consume_fuel, memory_reservation,"
+            << " memory_guard_size, memory_reservation_for_growth" << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string profile_name = WasmtimeEngineConfig::DEFAULT_PROFILE;
+    bool is_compare_profiles = false;
+    bool is_epoch_interruption = false;
+    bool is_consume_fuel = false;
+    std::vector<std::pair<std::string, std::string>> profile_overrides;
+    std::optional<SnapshotOptions> snapshot_options;
+    std::vector<std::filesystem::path> positional_args;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if(arg == "--profile" && i + 1 < argc)
+        {
+            profile_name = argv[++i];
+        }
+        else if(arg == "--override" && i + 1 < argc)
+        {
+            std::string_view profile_override = argv[++i];
+            size_t separator = profile_override.find('=');
+            if(separator == std::string_view::npos)
+            {
+                return printUsage(argv[0]);
+            }
+            profile_overrides.emplace_back(profile_override.substr(0, separator), profile_override.substr(separator + 1));
+        }
+        else if(arg == "--epoch-interruption")
+        {
+            // Must match a manifest that sets script_engine.tick_budget
+            is_epoch_interruption = true;
+        }
+        else if(arg == "--consume-fuel")
+        {
+            // Must match a manifest that sets script_engine.context_limits.fuel or script_engine.fuel
+            is_consume_fuel = true;
+        }
+        else if(arg == "--snapshot" && i + 1 < argc)
+        {
+            snapshot_options = snapshot_options.value_or(SnapshotOptions());
+            snapshot_options->init_export = argv[++i];
+        }
+        else if(arg == "--snapshot-only")
+        {
+            snapshot_options = snapshot_options.value_or(SnapshotOptions());
+            snapshot_options->is_snapshot_only = true;
+        }
+        else if(arg == "--wasmtime" && i + 1 < argc)
+        {
+            snapshot_options = snapshot_options.value_or(SnapshotOptions());
+            snapshot_options->wasmtime_command = argv[++i];
+        }
+        else if(arg == "--compare-profiles")
+        {
+            is_compare_profiles = true;
+        }
+        else if(arg.starts_with("--"))
+        {
+            return printUsage(argv[0]);
+        }
+        else
+        {
+            positional_args.emplace_back(arg);
+        }
+    }
+
+    if(positional_args.empty() || positional_args.size() > (is_compare_profiles ? 1u : 2u)
+        || (snapshot_options.has_value() && snapshot_options->init_export.empty()))
+    {
+        return printUsage(argv[0]);
+    }
+
+    bool is_snapshot_only = snapshot_options.has_value() && snapshot_options->is_snapshot_only;
+    std::filesystem::path input_path = positional_args[0];
+    std::filesystem::path output_path = positional_args.size() == 2
+        ? positional_args[1]
+        : is_snapshot_only
+            ? std::filesystem::path(input_path).replace_extension(".snapshot.wasm")
+            : std::filesystem::path(input_path).replace_extension(WasmtimeEngineConfig::PRECOMPILED_EXTENSION);
+
+    std::ifstream input_file(input_path, std::ios::binary);
+    if(input_file.is_open() == false)
+    {
+        std::cerr << "Failed to open input component: " << input_path.string() << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> input_buffer((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+
+    if(WasmtimeEngineConfig::isPrecompiledArtifact(input_buffer.data(), input_buffer.size()))
+    {
+        std::cerr << "Input is already a precompiled artifact: " << input_path.string() << std::endl;
+        return 1;
+    }
+
+    if(snapshot_options.has_value())
+    {
+        std::optional<std::vector<uint8_t>> snapshot_buffer = snapshotComponent(input_path, output_path, snapshot_options.value());
+        if(snapshot_buffer.has_value() == false)
+        {
+            return 1;
+        }
+        if(is_snapshot_only)
+        {
+            if(writeOutput(output_path, snapshot_buffer.value()) == false)
+            {
+                return 1;
+            }
+            std::cout << "Wrote snapshot " << output_path.string() << " (" << input_buffer.size() << " -> " << snapshot_buffer->size() << " bytes)" << std::endl;
+            return 0;
+        }
+        input_buffer = std::move(snapshot_buffer.value());
+    }
+
+    if(is_compare_profiles)
+    {
+        return compareProfiles(input_buffer, input_path);
+    }
+
+    std::optional<WasmtimeEngineProfile> profile = WasmtimeEngineConfig::getProfile(profile_name);
+    if(profile.has_value() == false)
+    {
+        std::cerr << "Unknown profile: " << profile_name << std::endl;
+        return printUsage(argv[0]);
+    }
+    for(const auto& [key, value] : profile_overrides)
+    {
+        if(applyProfileOverride(profile.value(), key, value) == false)
+        {
+            std::cerr << "Invalid profile override: " << key << "=" << value << std::endl;
+            return printUsage(argv[0]);
+        }
+    }
+    // Like the runtime, sections that need epoch checks or fuel force them on over the overrides
+    profile->epoch_interruption = profile->epoch_interruption || is_epoch_interruption;
+    profile->consume_fuel = profile->consume_fuel || is_consume_fuel;
+
+    CompileResult result = compileWithProfile(profile.value(), input_buffer, input_path);
+    if(result.is_succeeded == false)
+    {
+        return 1;
+    }
+
+    if(writeOutput(output_path, result.serialized) == false)
+    {
+        return 1;
+    }
+
+    std::cout << "Precompiled " << input_path.string() << " -> " << output_path.string()
+        << " with profile '" << profile->name << "' in " << result.compile_ms << " ms"
+        << " (" << input_buffer.size() << " -> " << result.serialized.size() << " bytes)" << std::endl;
+    return 0;
+}
+
+
+
+